@@ -1,95 +1,208 @@
 ﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
 
 #include "API/OpenLandInstancingController.h"
-#include "API/OpenLandStaticMeshActor.h"
-#include "Kismet/GameplayStatics.h"
+#include "API/OpenLandInstancingSubsystem.h"
 #include "Kismet/KismetMathLibrary.h"
-
-TMap<FString, FOpenLandInstancingRequest> AOpenLandInstancingController::RequestsRegistry;
+#include "Utils/OpenLandMeshStats.h"
+#include "Async/ParallelFor.h"
+#include "Misc/SecureHash.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Static Mesh Instances"), STAT_OpenLandMesh_StaticMeshInstances, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Static Mesh Instance Components"), STAT_OpenLandMesh_StaticMeshInstanceComponents, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instances Added (Last Apply)"), STAT_OpenLandMesh_InstancingAdded, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instances Moved (Last Apply)"), STAT_OpenLandMesh_InstancingMoved, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instances Removed (Last Apply)"), STAT_OpenLandMesh_InstancingRemoved, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instancing Requests Pending"), STAT_OpenLandMesh_InstancingRequestsPending, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instance Actors Pending"), STAT_OpenLandMesh_InstanceActorsPending, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Static Mesh Instances Pending"), STAT_OpenLandMesh_StaticMeshInstancesPending, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Instancing Budget Used (ms)"), STAT_OpenLandMesh_InstancingBudgetUsed, STATGROUP_OpenLandMesh);
+
+TMap<FGuid, FOpenLandInstancingRequest> AOpenLandInstancingController::RequestsRegistry;
 TArray<FOpenLandInstancingRequestPayload> AOpenLandInstancingController::RequestsToUpdate;
-AOpenLandInstancingController* AOpenLandInstancingController::Singleton = nullptr;
+TMap<FGuid, int32> AOpenLandInstancingController::PendingRequestIndices;
+
+// Below this, it's cheaper to calculate instance transforms on the game thread
+static const int32 OpenLandInstancingMinParallelPoints = 256;
+// Static mesh instances are added to a component in batches of this size, until the frame budget runs out
+static const int32 OpenLandInstancingAddBatchSize = 1000;
 
 // Sets default values
 AOpenLandInstancingController::AOpenLandInstancingController()
 {
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
-	RemainingTimeToCleanUp = InstanceCleaningInterval;
-	Singleton = this;
+	// HISM components of static mesh instances are attached to this
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
 }
 
 void AOpenLandInstancingController::EnsureSpawnController(AOpenLandMeshActor* Owner)
 {
-	TArray<AActor*> ExistingControllers;
-	UGameplayStatics::GetAllActorsOfClass(Owner->GetWorld(), StaticClass(), ExistingControllers);
-	if (ExistingControllers.Num() > 0)
+	UOpenLandInstancingSubsystem* InstancingSubsystem = Owner->GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
 	{
-		return;
+		InstancingSubsystem->GetOrSpawnController();
 	}
-
-	Owner->GetWorld()->SpawnActor(StaticClass());
 }
 
 void AOpenLandInstancingController::CreateInstances(AOpenLandMeshActor* Owner, TArray<FOpenLandInstancingRequestPoint> Points)
 {
 	EnsureSpawnController(Owner);
-	
-	if (RequestsRegistry.Find(Owner->GetObjectId()) == nullptr)
-	{
-		RequestsRegistry.Add(Owner->GetObjectId(), {});
-	}
 
-	FOpenLandInstancingRequest &Registration = RequestsRegistry[Owner->GetObjectId()];
-	Registration.OwnerId = Owner->GetObjectId();
+	const FGuid OwnerId = Owner->GetObjectId();
+	FOpenLandInstancingRequest &Registration = RequestsRegistry.FindOrAdd(OwnerId);
+	Registration.OwnerId = OwnerId;
 	Registration.NewPoints = Points;
 	Registration.ComponentTransform = Owner->MeshComponent->GetComponentTransform();
 
-	RequestsToUpdate.Push({
-		Owner->GetObjectId(),
-		OSC_SET_POINTS
-	});
+	QueueRequest(OwnerId, OSC_SET_POINTS);
 }
 
 void AOpenLandInstancingController::UpdateTransforms(AOpenLandMeshActor* Owner)
 {
-	if (RequestsRegistry.Find(Owner->GetObjectId()) == nullptr)
+	const FGuid OwnerId = Owner->GetObjectId();
+	const FTransform NewTransform =  Owner->MeshComponent->GetComponentTransform();
+	FOpenLandInstancingRequest* Registration = RequestsRegistry.Find(OwnerId);
+	if (Registration == nullptr)
 	{
-		FOpenLandInstancingRequest Registration;
-		Registration.OwnerId = Owner->GetObjectId();
-		Registration.ComponentTransform = Owner->MeshComponent->GetComponentTransform();
-		RequestsRegistry.Add(Owner->GetObjectId(), Registration);
+		// This could be an owner with instances loaded from the level. They still need to follow the owner.
+		FOpenLandInstancingRequest NewRegistration;
+		NewRegistration.OwnerId = OwnerId;
+		NewRegistration.ComponentTransform = NewTransform;
+		RequestsRegistry.Add(OwnerId, NewRegistration);
+		QueueRequest(OwnerId, OSC_UPDATE_TRANSFORM);
+		return;
 	}
 
-	const FTransform NewTransform =  Owner->MeshComponent->GetComponentTransform();
-	FOpenLandInstancingRequest &Registration = RequestsRegistry[Owner->GetObjectId()];
-	if (Registration.ComponentTransform.Equals(NewTransform))
+	if (Registration->ComponentTransform.Equals(NewTransform))
 	{
 		return;
 	}
 
-	Registration.ComponentTransform = NewTransform;
-
-	RequestsToUpdate.Push({
-		Owner->GetObjectId(),
-		OSC_UPDATE_TRANSFORM
-	});
+	Registration->ComponentTransform = NewTransform;
+	QueueRequest(OwnerId, OSC_UPDATE_TRANSFORM);
 }
 
 void AOpenLandInstancingController::Unregister(AOpenLandMeshActor* Owner)
 {
-	RequestsToUpdate.Push({
-		Owner->GetObjectId(),
-		OSC_UNREGISTER
-	});
+	QueueRequest(Owner->GetObjectId(), OSC_UNREGISTER);
 }
 
-AOpenLandInstancingTransformedInfo AOpenLandInstancingController::ApplyTransformation(
-	FOpenLandInstancingRequestPoint Point, FTransform Transform)
+void AOpenLandInstancingController::QueueRequest(const FGuid& OwnerId, EOpenLandSpawningRegistrationAction Action)
 {
-	AOpenLandInstancingTransformedInfo TransformedInfo;
+	// Requests only carry the owner id. The latest data is in the RequestsRegistry.
+	// So, an owner never needs more than one pending payload.
+	const int32* PendingIndex = PendingRequestIndices.Find(OwnerId);
+	if (PendingIndex == nullptr)
+	{
+		PendingRequestIndices.Add(OwnerId, RequestsToUpdate.Push({OwnerId, static_cast<uint8>(Action)}));
+		return;
+	}
+
+	uint8& Actions = RequestsToUpdate[*PendingIndex].Actions;
+	if (Action == OSC_UNREGISTER)
+	{
+		// Nothing else matters if we are going to remove the instances
+		Actions = OSC_UNREGISTER;
+	} else if (Action == OSC_SET_POINTS && (Actions & OSC_UNREGISTER))
+	{
+		// New points replace whatever was there. So, there's nothing to remove first.
+		Actions = OSC_SET_POINTS;
+	} else
+	{
+		Actions |= Action;
+	}
+}
+
+void AOpenLandInstancingController::RequeueRequests(const TArray<FOpenLandInstancingRequestPayload>& Requests, int32 StartIndex)
+{
+	// Left over requests are older than the ones queued while we were processing. So, they go first.
+	const TArray<FOpenLandInstancingRequestPayload> NewerRequests = MoveTemp(RequestsToUpdate);
+	RequestsToUpdate.Reset();
+	PendingRequestIndices.Reset();
+
+	auto Requeue = [](const FOpenLandInstancingRequestPayload& Payload)
+	{
+		for (const EOpenLandSpawningRegistrationAction Action: {OSC_UNREGISTER, OSC_SET_POINTS, OSC_UPDATE_TRANSFORM})
+		{
+			if (Payload.Actions & Action)
+			{
+				QueueRequest(Payload.OwnerId, Action);
+			}
+		}
+	};
+
+	for (int32 Index = StartIndex; Index < Requests.Num(); Index++)
+	{
+		Requeue(Requests[Index]);
+	}
+
+	for (const FOpenLandInstancingRequestPayload& Payload: NewerRequests)
+	{
+		Requeue(Payload);
+	}
+}
+
+bool AOpenLandInstancingController::HasFrameBudget() const
+{
+	if (FrameBudgetMs <= 0)
+	{
+		return true;
+	}
+
+	return (FPlatformTime::Seconds() - FrameStartedAt) * 1000.0 < FrameBudgetMs;
+}
+
+void AOpenLandInstancingController::UpdateCameraLocation()
+{
+	const UWorld* World = GetWorld();
+	bHasCameraLocation = World->ViewLocationsRenderedLastFrame.Num() > 0;
+	CameraLocation = bHasCameraLocation ? World->ViewLocationsRenderedLastFrame[0] : FVector::ZeroVector;
+}
+
+bool AOpenLandInstancingController::FindOwnerTransform(const FGuid& OwnerId, FTransform& OwnerTransform) const
+{
+	const FOpenLandInstancingRequest* Registration = RequestsRegistry.Find(OwnerId);
+	if (Registration != nullptr)
+	{
+		OwnerTransform = Registration->ComponentTransform;
+		return true;
+	}
+
+	// Instances loaded with the level may not have a registration yet
+	const UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	const AOpenLandMeshActor* Owner = InstancingSubsystem ? InstancingSubsystem->FindOwner(OwnerId) : nullptr;
+	if (Owner == nullptr)
+	{
+		return false;
+	}
+
+	OwnerTransform = Owner->MeshComponent->GetComponentTransform();
+	return true;
+}
+
+FGuid AOpenLandInstancingController::MakeOwnerId()
+{
+	return FGuid::NewGuid();
+}
+
+FGuid AOpenLandInstancingController::OwnerIdFromString(const FString& SavedId)
+{
+	// Earlier versions used SHA-1 hex strings. So, we derive a stable id from the string.
+	FGuid OwnerId;
+	if (!FGuid::ParseExact(FMD5::HashAnsiString(*SavedId), EGuidFormats::Digits, OwnerId))
+	{
+		return FGuid();
+	}
+
+	return OwnerId;
+}
+
+FOpenLandInstancingPointTransform AOpenLandInstancingController::PrepareTransformation(const FOpenLandInstancingRequestPoint& Point)
+{
+	FOpenLandInstancingPointTransform PointTransform;
 
 	// Add the random scale
-	TransformedInfo.Scale = Point.RandomScale;
+	PointTransform.Scale = Point.RandomScale;
 
 	// Add rotation
 	const FQuat Random(FRotator::MakeFromEuler(Point.RandomRotation));
@@ -97,205 +210,547 @@ AOpenLandInstancingTransformedInfo AOpenLandInstancingController::ApplyTransform
 	
 	if (Point.bUseLocalRandomRotation)
 	{
-		TransformedInfo.Rotator = (Transform.Rotator().Quaternion() * CorrectTangents * Random).Rotator();
+		PointTransform.LocalRotation = CorrectTangents * Random;
 	} else
 	{
-		TransformedInfo.Rotator = (Transform.Rotator().Quaternion() * Random * CorrectTangents).Rotator();
+		PointTransform.LocalRotation = Random * CorrectTangents;
 	}
 
-	// Apply transformed position
-	TransformedInfo.Position = Transform.TransformPosition(Point.Position);
-	// Apply random displacement
+	PointTransform.Position = Point.Position;
+	// Local displacements are rotated with the instance
+	PointTransform.bLocalDisplacement = Point.bUseLocalRandomDisplacement;
 	if (Point.bUseLocalRandomDisplacement)
 	{
-		TransformedInfo.Position += TransformedInfo.Rotator.RotateVector(Point.RandomDisplacement);
+		PointTransform.Displacement = PointTransform.LocalRotation.RotateVector(Point.RandomDisplacement);
 	} else
 	{
-		TransformedInfo.Position += Point.RandomDisplacement;
+		PointTransform.Displacement = Point.RandomDisplacement;
 	}
 
-	return TransformedInfo;
+	PointTransform.bIsValid = true;
+	return PointTransform;
 }
 
-void AOpenLandInstancingController::SetPoints(FOpenLandInstancingRequest &Registration)
+FTransform AOpenLandInstancingController::ApplyTransformation(const FOpenLandInstancingPointTransform& PointTransform, const FTransform& Transform)
+{
+	const FQuat OwnerRotation = Transform.GetRotation();
+
+	// Apply transformed position & random displacement
+	FVector Position = Transform.TransformPosition(PointTransform.Position);
+	if (PointTransform.bLocalDisplacement)
+	{
+		Position += OwnerRotation.RotateVector(PointTransform.Displacement);
+	} else
+	{
+		Position += PointTransform.Displacement;
+	}
+
+	return FTransform(OwnerRotation * PointTransform.LocalRotation, Position, PointTransform.Scale);
+}
+
+int32 AOpenLandInstancingController::FindOrAddStaticMeshGroup(UStaticMesh* StaticMesh, bool bEnableCollisions)
 {
-	if (InstancedGroupsMap.Find(Registration.OwnerId) == nullptr)
+	const int32 ExistingIndex = StaticMeshGroups.IndexOfByPredicate([StaticMesh, bEnableCollisions](const FOpenLandInstancedStaticMeshGroup& Group)
+	{
+		return Group.StaticMesh == StaticMesh && Group.bEnableCollisions == bEnableCollisions;
+	});
+
+	if (ExistingIndex != INDEX_NONE)
 	{
-		FOpenLandInstancedActorGroup SpawnedRegistration;
-		InstancedGroupsMap.Add(Registration.OwnerId, {});
+		return ExistingIndex;
 	}
 
-	FOpenLandInstancedActorGroup &SpawnedRegistration = InstancedGroupsMap[Registration.OwnerId];
+	FOpenLandInstancedStaticMeshGroup NewGroup;
+	NewGroup.StaticMesh = StaticMesh;
+	NewGroup.bEnableCollisions = bEnableCollisions;
+	return StaticMeshGroups.Push(NewGroup);
+}
 
-	TArray<FOpenLandInstancedActorInfo> NewActors;
-	TArray<FOpenLandInstancingRequestPoint> NewPoints = Registration.NewPoints;
-	Registration.NewPoints = {};
-	
-	TMap<UClass*, TArray<FOpenLandInstancedActorInfo>> ExistingActorsByClass;
-	TMap<UStaticMesh*, TArray<FOpenLandInstancedActorInfo>> ExistingActorsByStaticMesh;
-	
-	for(FOpenLandInstancedActorInfo ExistingActor: SpawnedRegistration.SpawnedActors)
+void AOpenLandInstancingController::AddStaticMeshInstance(const FGuid& OwnerId, FOpenLandInstancedActorGroup& OwnerGroup,
+                                                          const FOpenLandInstancingRequestPoint& Point, const FTransform& OwnerTransform)
+{
+	const int32 MeshGroupIndex = FindOrAddStaticMeshGroup(Point.StaticMesh, Point.bEnableCollisions);
+	FOpenLandInstancedStaticMeshGroup& MeshGroup = StaticMeshGroups[MeshGroupIndex];
+
+	FOpenLandInstancedStaticMeshInfo InstanceInfo;
+	InstanceInfo.MeshGroupIndex = MeshGroupIndex;
+	InstanceInfo.OriginalPoint = Point;
+	InstanceInfo.PointTransform = PrepareTransformation(Point);
+	InstanceInfo.InstanceIndex = MeshGroup.InstanceTransforms.Push(ApplyTransformation(InstanceInfo.PointTransform, OwnerTransform));
+
+	FOpenLandInstancedStaticMeshOwnerRef OwnerRef;
+	OwnerRef.OwnerId = OwnerId;
+	OwnerRef.OwnerSlot = OwnerGroup.StaticMeshInstances.Push(InstanceInfo);
+	MeshGroup.InstanceOwners.Push(OwnerRef);
+}
+
+void AOpenLandInstancingController::SetStaticMeshInstanceTransform(const FOpenLandInstancedStaticMeshInfo& InstanceInfo, const FTransform& Transform)
+{
+	FOpenLandInstancedStaticMeshGroup& MeshGroup = StaticMeshGroups[InstanceInfo.MeshGroupIndex];
+	MeshGroup.InstanceTransforms[InstanceInfo.InstanceIndex] = Transform;
+	MeshGroup.MarkDirty(InstanceInfo.InstanceIndex);
+}
+
+void AOpenLandInstancingController::RemoveStaticMeshInstance(const FOpenLandInstancedStaticMeshInfo& InstanceInfo)
+{
+	FOpenLandInstancedStaticMeshGroup& MeshGroup = StaticMeshGroups[InstanceInfo.MeshGroupIndex];
+	const int32 InstanceIndex = InstanceInfo.InstanceIndex;
+	const int32 LastIndex = MeshGroup.InstanceTransforms.Num() - 1;
+
+	// We move the last instance into the removed slot. Then the component only needs to drop its tail.
+	// That works the same no matter how the component re-orders instances on removal.
+	if (InstanceIndex != LastIndex)
 	{
-		UClass* ActorClass = ExistingActor.OriginalPoint.ActorClass;
-		UStaticMesh* StaticMesh = ExistingActor.OriginalPoint.StaticMesh;
+		MeshGroup.InstanceTransforms[InstanceIndex] = MeshGroup.InstanceTransforms[LastIndex];
+		MeshGroup.InstanceOwners[InstanceIndex] = MeshGroup.InstanceOwners[LastIndex];
+		MeshGroup.MarkDirty(InstanceIndex);
 
-		if (ActorClass != nullptr)
+		const FOpenLandInstancedStaticMeshOwnerRef& MovedOwner = MeshGroup.InstanceOwners[InstanceIndex];
+		FOpenLandInstancedActorGroup* MovedOwnerGroup = InstancedGroups.Find(MovedOwner.OwnerId);
+		if (MovedOwnerGroup != nullptr)
 		{
-			if (ExistingActorsByClass.Find(ActorClass) == nullptr)
+			MovedOwnerGroup->StaticMeshInstances[MovedOwner.OwnerSlot].InstanceIndex = InstanceIndex;
+		}
+	}
+
+	MeshGroup.InstanceTransforms.Pop(false);
+	MeshGroup.InstanceOwners.Pop(false);
+}
+
+void AOpenLandInstancingController::RemoveStaticMeshInstances(FOpenLandInstancedActorGroup& OwnerGroup, const TArray<int32>& OwnerSlots)
+{
+	// Owner slots are kept up to date while we move instances around. So, we can remove them in any order.
+	TBitArray<> RemovedSlots(false, OwnerGroup.StaticMeshInstances.Num());
+	for (const int32 OwnerSlot: OwnerSlots)
+	{
+		RemoveStaticMeshInstance(OwnerGroup.StaticMeshInstances[OwnerSlot]);
+		RemovedSlots[OwnerSlot] = true;
+	}
+
+	// Compact the owner's list & point the component slots to their new place
+	TArray<FOpenLandInstancedStaticMeshInfo> RemainingInstances;
+	RemainingInstances.Reserve(OwnerGroup.StaticMeshInstances.Num() - OwnerSlots.Num());
+	for (int32 OwnerSlot = 0; OwnerSlot < OwnerGroup.StaticMeshInstances.Num(); OwnerSlot++)
+	{
+		if (RemovedSlots[OwnerSlot])
+		{
+			continue;
+		}
+
+		const FOpenLandInstancedStaticMeshInfo& Instance = OwnerGroup.StaticMeshInstances[OwnerSlot];
+		StaticMeshGroups[Instance.MeshGroupIndex].InstanceOwners[Instance.InstanceIndex].OwnerSlot = RemainingInstances.Push(Instance);
+	}
+
+	OwnerGroup.StaticMeshInstances = MoveTemp(RemainingInstances);
+}
+
+void AOpenLandInstancingController::RemoveAllStaticMeshInstances(FOpenLandInstancedActorGroup& OwnerGroup)
+{
+	TArray<int32> OwnerSlots;
+	OwnerSlots.Reserve(OwnerGroup.StaticMeshInstances.Num());
+	for (int32 OwnerSlot = 0; OwnerSlot < OwnerGroup.StaticMeshInstances.Num(); OwnerSlot++)
+	{
+		OwnerSlots.Push(OwnerSlot);
+	}
+
+	RemoveStaticMeshInstances(OwnerGroup, OwnerSlots);
+}
+
+void AOpenLandInstancingController::FlushStaticMeshGroups()
+{
+	int32 TotalInstances = 0;
+	int32 TotalComponents = 0;
+	bool bAddedAny = false;
+	NumPendingStaticMeshInstances = 0;
+
+	for (FOpenLandInstancedStaticMeshGroup& MeshGroup: StaticMeshGroups)
+	{
+		const int32 NumInstances = MeshGroup.InstanceTransforms.Num();
+		TotalInstances += NumInstances;
+
+		if (MeshGroup.Component == nullptr)
+		{
+			if (NumInstances == 0)
 			{
-				ExistingActorsByClass.Add(ActorClass, {});
+				continue;
 			}
 
-			ExistingActorsByClass[ActorClass].Push(ExistingActor);
-			continue;
+			MeshGroup.Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, NAME_None, RF_Transactional);
+			MeshGroup.Component->SetStaticMesh(MeshGroup.StaticMesh);
+			MeshGroup.Component->SetCollisionEnabled(MeshGroup.bEnableCollisions ? ECollisionEnabled::QueryAndPhysics : ECollisionEnabled::NoCollision);
+			MeshGroup.Component->SetupAttachment(RootComponent);
+			MeshGroup.Component->RegisterComponent();
+			AddInstanceComponent(MeshGroup.Component);
 		}
 
-		if (StaticMesh != nullptr)
+		TotalComponents += 1;
+		UHierarchicalInstancedStaticMeshComponent* Component = MeshGroup.Component;
+		const int32 NumComponentInstances = Component->GetInstanceCount();
+		const FTransform ComponentTransform = Component->GetComponentTransform();
+
+		// Removed instances are always at the end. See RemoveStaticMeshInstance()
+		if (NumComponentInstances > NumInstances)
 		{
-			if (ExistingActorsByStaticMesh.Find(StaticMesh) == nullptr)
+			TArray<int32> TailInstances;
+			for (int32 InstanceIndex = NumComponentInstances - 1; InstanceIndex >= NumInstances; InstanceIndex--)
 			{
-				ExistingActorsByStaticMesh.Add(StaticMesh, {});
+				TailInstances.Push(InstanceIndex);
 			}
+			Component->RemoveInstances(TailInstances);
+		}
 
-			ExistingActorsByStaticMesh[StaticMesh].Push(ExistingActor);
-			continue;
+		const int32 DirtyEndIndex = FMath::Min(MeshGroup.DirtyEndIndex, FMath::Min(NumInstances, NumComponentInstances));
+		if (MeshGroup.DirtyStartIndex < DirtyEndIndex)
+		{
+			const TArray<FTransform> DirtyTransforms(MeshGroup.InstanceTransforms.GetData() + MeshGroup.DirtyStartIndex, DirtyEndIndex - MeshGroup.DirtyStartIndex);
+			Component->BatchUpdateInstancesTransforms(MeshGroup.DirtyStartIndex, DirtyTransforms, true, true, true);
+		}
+
+		// New instances are added in batches within the frame budget. The rest wait at the tail for the next frame.
+		// Since they are always at the tail, the component indexes still match ours.
+		int32 NumAddedInstances = NumComponentInstances;
+		while (NumAddedInstances < NumInstances && (!bAddedAny || HasFrameBudget()))
+		{
+			const int32 BatchEndIndex = FMath::Min(NumInstances, NumAddedInstances + OpenLandInstancingAddBatchSize);
+			TArray<FTransform> NewTransforms;
+			NewTransforms.Reserve(BatchEndIndex - NumAddedInstances);
+			for (int32 InstanceIndex = NumAddedInstances; InstanceIndex < BatchEndIndex; InstanceIndex++)
+			{
+				NewTransforms.Push(MeshGroup.InstanceTransforms[InstanceIndex].GetRelativeTransform(ComponentTransform));
+			}
+			Component->AddInstances(NewTransforms, false);
+			NumAddedInstances = BatchEndIndex;
+			bAddedAny = true;
 		}
-		
+		NumPendingStaticMeshInstances += NumInstances - NumAddedInstances;
+
+		MeshGroup.DirtyStartIndex = MAX_int32;
+		MeshGroup.DirtyEndIndex = 0;
+	}
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_StaticMeshInstances, TotalInstances);
+	SET_DWORD_STAT(STAT_OpenLandMesh_StaticMeshInstanceComponents, TotalComponents);
+	SET_DWORD_STAT(STAT_OpenLandMesh_StaticMeshInstancesPending, NumPendingStaticMeshInstances);
+}
+
+void AOpenLandInstancingController::SetPoints(FOpenLandInstancingRequest &Registration)
+{
+	FOpenLandInstancedActorGroup &SpawnedRegistration = InstancedGroups.FindOrAdd(Registration.OwnerId);
+	FOpenLandInstancingApplyStats ApplyStats;
+
+	TArray<FOpenLandInstancingRequestPoint> NewPoints = Registration.NewPoints;
+	Registration.NewPoints = {};
+
+	// Unchanged points still need to follow the owner, if it has moved since the last placement
+	const bool bOwnerMoved = !SpawnedRegistration.bHasPlacedTransform || !SpawnedRegistration.PlacedTransform.Equals(Registration.ComponentTransform);
+
+	// Index existing instances by their point ids. Then we only touch what has changed.
+	TMap<int64, int32> ExistingActorsById;
+	for (int32 ActorIndex = 0; ActorIndex < SpawnedRegistration.SpawnedActors.Num(); ActorIndex++)
+	{
+		ExistingActorsById.Add(SpawnedRegistration.SpawnedActors[ActorIndex].OriginalPoint.PointId, ActorIndex);
 	}
 
-	auto NewPointsCloned = NewPoints;
-	while (NewPoints.Num() > 0)
+	TMap<int64, int32> ExistingInstancesById;
+	for (int32 OwnerSlot = 0; OwnerSlot < SpawnedRegistration.StaticMeshInstances.Num(); OwnerSlot++)
 	{
-		const FOpenLandInstancingRequestPoint NewPoint = NewPoints.Pop();
+		ExistingInstancesById.Add(SpawnedRegistration.StaticMeshInstances[OwnerSlot].OriginalPoint.PointId, OwnerSlot);
+	}
 
+	TBitArray<> MatchedActors(false, SpawnedRegistration.SpawnedActors.Num());
+	TBitArray<> MatchedInstances(false, SpawnedRegistration.StaticMeshInstances.Num());
+	TArray<FOpenLandInstancedActorInfo> NewActors;
+	TArray<FOpenLandInstancedActorInfo> PendingActors;
+	TArray<FOpenLandInstancingRequestPoint> UnmatchedActorPoints;
+	TMap<int32, TArray<FOpenLandInstancingRequestPoint>> UnmatchedPointsByMeshGroup;
+
+	// Pass 1: Points with the same id are kept & only moved if they have changed
+	for (const FOpenLandInstancingRequestPoint& NewPoint: NewPoints)
+	{
 		if (NewPoint.ActorClass == nullptr && NewPoint.StaticMesh == nullptr)
 		{
 			continue;
 		}
 
-		bool bHasExistingActor = ExistingActorsByClass.Find(NewPoint.ActorClass) != nullptr && ExistingActorsByClass[NewPoint.ActorClass].Num() > 0;
-		bool bHasExistingStaticMesh = ExistingActorsByStaticMesh.Find(NewPoint.StaticMesh) != nullptr && ExistingActorsByStaticMesh[NewPoint.StaticMesh].Num() > 0;
-		
-		// Try translating an existing Actor or StaticMesh to the new position
-		if (bHasExistingActor || bHasExistingStaticMesh)
+		if (NewPoint.ActorClass != nullptr)
 		{
-			FOpenLandInstancedActorInfo ExistingActor;
-			if (NewPoint.ActorClass != nullptr)
-			{
-				ExistingActor = ExistingActorsByClass[NewPoint.ActorClass].Pop();
-			} else
+			const int32* ActorIndex = ExistingActorsById.Find(NewPoint.PointId);
+			const bool bMatched = ActorIndex != nullptr && !MatchedActors[*ActorIndex] &&
+				SpawnedRegistration.SpawnedActors[*ActorIndex].Actor != nullptr &&
+				SpawnedRegistration.SpawnedActors[*ActorIndex].OriginalPoint.ActorClass == NewPoint.ActorClass;
+			if (!bMatched)
 			{
-				ExistingActor = ExistingActorsByStaticMesh[NewPoint.StaticMesh].Pop();
-			}
-			
-			if (ExistingActor.Actor == nullptr)
-			{
-				NewPoints.Push(NewPoint);
+				UnmatchedActorPoints.Push(NewPoint);
 				continue;
 			}
-			
-			ExistingActor.OriginalPoint = NewPoint;
-			
-			const AOpenLandInstancingTransformedInfo TransformedInfo = ApplyTransformation(NewPoint, Registration.ComponentTransform);
-			ExistingActor.Actor->SetActorLocationAndRotation(TransformedInfo.Position, TransformedInfo.Rotator);
-			ExistingActor.Actor->SetActorRelativeScale3D(TransformedInfo.Scale);
 
-			if (NewPoint.StaticMesh != nullptr)
+			MatchedActors[*ActorIndex] = true;
+			FOpenLandInstancedActorInfo ExistingActor = SpawnedRegistration.SpawnedActors[*ActorIndex];
+			if (!bOwnerMoved && ExistingActor.OriginalPoint.HasSameTransform(NewPoint) && ExistingActor.PointTransform.bIsValid)
 			{
-				AOpenLandStaticMeshActor* StaticMeshActor = Cast<AOpenLandStaticMeshActor>(ExistingActor.Actor);
-				if (NewPoint.bEnableCollisions)
-				{
-					StaticMeshActor->StaticMesh->SetCollisionEnabled(ECollisionEnabled::Type::QueryAndPhysics);
-				} else
-				{
-					StaticMeshActor->StaticMesh->SetCollisionEnabled(ECollisionEnabled::Type::NoCollision);
-				}
+				ApplyStats.Unchanged += 1;
+			} else
+			{
+				ExistingActor.PointTransform = PrepareTransformation(NewPoint);
+				const FTransform InstanceTransform = ApplyTransformation(ExistingActor.PointTransform, Registration.ComponentTransform);
+				ExistingActor.Actor->SetActorLocationAndRotation(InstanceTransform.GetLocation(), InstanceTransform.GetRotation());
+				ExistingActor.Actor->SetActorRelativeScale3D(InstanceTransform.GetScale3D());
+				ApplyStats.Moved += 1;
 			}
 
+			ExistingActor.OriginalPoint = NewPoint;
+			NewActors.Push(ExistingActor);
+			continue;
+		}
+
+		const int32 MeshGroupIndex = FindOrAddStaticMeshGroup(NewPoint.StaticMesh, NewPoint.bEnableCollisions);
+		const int32* OwnerSlot = ExistingInstancesById.Find(NewPoint.PointId);
+		const bool bMatched = OwnerSlot != nullptr && !MatchedInstances[*OwnerSlot] &&
+			SpawnedRegistration.StaticMeshInstances[*OwnerSlot].MeshGroupIndex == MeshGroupIndex;
+		if (!bMatched)
+		{
+			UnmatchedPointsByMeshGroup.FindOrAdd(MeshGroupIndex).Push(NewPoint);
+			continue;
+		}
+
+		MatchedInstances[*OwnerSlot] = true;
+		FOpenLandInstancedStaticMeshInfo& ExistingInstance = SpawnedRegistration.StaticMeshInstances[*OwnerSlot];
+		if (!bOwnerMoved && ExistingInstance.OriginalPoint.HasSameTransform(NewPoint) && ExistingInstance.PointTransform.bIsValid)
+		{
+			ApplyStats.Unchanged += 1;
+		} else
+		{
+			ExistingInstance.PointTransform = PrepareTransformation(NewPoint);
+			SetStaticMeshInstanceTransform(ExistingInstance, ApplyTransformation(ExistingInstance.PointTransform, Registration.ComponentTransform));
+			ApplyStats.Moved += 1;
+		}
+		ExistingInstance.OriginalPoint = NewPoint;
+	}
+
+	// Pass 2: Left over actors are moved to the new points of the same class. Moving is cheaper than spawning.
+	TMap<UClass*, TArray<FOpenLandInstancedActorInfo>> LeftOverActorsByClass;
+	for (int32 ActorIndex = 0; ActorIndex < SpawnedRegistration.SpawnedActors.Num(); ActorIndex++)
+	{
+		const FOpenLandInstancedActorInfo& ExistingActor = SpawnedRegistration.SpawnedActors[ActorIndex];
+		if (MatchedActors[ActorIndex] || ExistingActor.Actor == nullptr)
+		{
+			continue;
+		}
+
+		// Static meshes used to be spawned as actors. They don't have a class & we replace them with HISM instances.
+		LeftOverActorsByClass.FindOrAdd(ExistingActor.OriginalPoint.ActorClass).Push(ExistingActor);
+	}
+
+	for (const FOpenLandInstancingRequestPoint& NewPoint: UnmatchedActorPoints)
+	{
+		const FOpenLandInstancingPointTransform PointTransform = PrepareTransformation(NewPoint);
+		TArray<FOpenLandInstancedActorInfo>* LeftOverActors = LeftOverActorsByClass.Find(NewPoint.ActorClass);
+		if (LeftOverActors != nullptr && LeftOverActors->Num() > 0)
+		{
+			const FTransform InstanceTransform = ApplyTransformation(PointTransform, Registration.ComponentTransform);
+			FOpenLandInstancedActorInfo ExistingActor = LeftOverActors->Pop();
+			ExistingActor.OriginalPoint = NewPoint;
+			ExistingActor.PointTransform = PointTransform;
+			ExistingActor.Actor->SetActorLocationAndRotation(InstanceTransform.GetLocation(), InstanceTransform.GetRotation());
+			ExistingActor.Actor->SetActorRelativeScale3D(InstanceTransform.GetScale3D());
+
 			NewActors.Push(ExistingActor);
+			ApplyStats.Moved += 1;
 			continue;
 		}
 
-		// Create a new actor if there are no existing actors
-		const AOpenLandInstancingTransformedInfo TransformedInfo = ApplyTransformation(NewPoint, Registration.ComponentTransform);
-		
+		// Create a new actor if there are no existing actors. It's spawned later within the frame budget.
 		FOpenLandInstancedActorInfo SpawnedActorInfo;
 		SpawnedActorInfo.OriginalPoint = NewPoint;
+		SpawnedActorInfo.PointTransform = PointTransform;
+		SpawnedActorInfo.bPendingSpawn = true;
+		PendingActors.Push(SpawnedActorInfo);
+		ApplyStats.Added += 1;
+	}
 
-		if (NewPoint.ActorClass != nullptr)
+	// Nearest actors are spawned first
+	if (bHasCameraLocation)
+	{
+		const FTransform& OwnerTransform = Registration.ComponentTransform;
+		const FVector ViewLocation = CameraLocation;
+		PendingActors.Sort([&OwnerTransform, ViewLocation](const FOpenLandInstancedActorInfo& A, const FOpenLandInstancedActorInfo& B)
 		{
-			SpawnedActorInfo.Actor = GetWorld()->SpawnActor(NewPoint.ActorClass, &TransformedInfo.Position, &TransformedInfo.Rotator);
-			SpawnedActorInfo.Actor->SetActorRelativeScale3D(TransformedInfo.Scale);
+			return FVector::DistSquared(OwnerTransform.TransformPosition(A.PointTransform.Position), ViewLocation) <
+				FVector::DistSquared(OwnerTransform.TransformPosition(B.PointTransform.Position), ViewLocation);
+		});
+	}
 
-			// Register child mesh actors. This will be useful later when cleaning
-			AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(SpawnedActorInfo.Actor);
+	SpawnedRegistration.NextPendingSpawn = NewActors.Num();
+	SpawnedRegistration.NumPendingSpawns = PendingActors.Num();
+	NewActors.Append(PendingActors);
+	if (PendingActors.Num() > 0)
+	{
+		OwnersWithPendingSpawns.Add(Registration.OwnerId);
+	}
+
+	// Delete remaining old instances
+	for(const auto& LeftOverActors: LeftOverActorsByClass)
+	{
+		for (const FOpenLandInstancedActorInfo& ExistingActor: LeftOverActors.Value)
+		{
+			AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(ExistingActor.Actor);
 			if (MeshActor != nullptr)
 			{
-				ChildMeshActors.Add(MeshActor->GetObjectId(), MeshActor);
+				ChildMeshes.Remove(MeshActor->GetObjectId());
 			}
-#if WITH_EDITOR
-			SpawnedActorInfo.Actor->SetFolderPath("OpenLandMeshInstances");
-#endif			
-		} else
+			ExistingActor.Actor->Destroy(true);
+			ApplyStats.Removed += 1;
+		}
+	}
+
+	SpawnedRegistration.SpawnedActors = NewActors;
+
+	// Same for static mesh instances. Left over instances are moved to the new points of the same group.
+	TArray<int32> OwnerSlotsToRemove;
+	for (int32 OwnerSlot = 0; OwnerSlot < SpawnedRegistration.StaticMeshInstances.Num(); OwnerSlot++)
+	{
+		if (MatchedInstances[OwnerSlot])
 		{
-			SpawnedActorInfo.Actor = GetWorld()->SpawnActor(AOpenLandStaticMeshActor::StaticClass(), &TransformedInfo.Position, &TransformedInfo.Rotator);
-			SpawnedActorInfo.Actor->SetActorRelativeScale3D(TransformedInfo.Scale);
-#if WITH_EDITOR
-			SpawnedActorInfo.Actor->SetFolderPath("OpenLandMeshInstances");
-#endif
-			AOpenLandStaticMeshActor* StaticMeshActor = Cast<AOpenLandStaticMeshActor>(SpawnedActorInfo.Actor);
-			StaticMeshActor->StaticMesh->SetStaticMesh(NewPoint.StaticMesh);
-			if (NewPoint.bEnableCollisions)
-			{
-				StaticMeshActor->StaticMesh->SetCollisionEnabled(ECollisionEnabled::Type::QueryAndPhysics);
-			} else
-			{
-				StaticMeshActor->StaticMesh->SetCollisionEnabled(ECollisionEnabled::Type::NoCollision);
-			}
+			continue;
 		}
-		
-		NewActors.Push(SpawnedActorInfo);
+
+		FOpenLandInstancedStaticMeshInfo& ExistingInstance = SpawnedRegistration.StaticMeshInstances[OwnerSlot];
+		TArray<FOpenLandInstancingRequestPoint>* GroupPoints = UnmatchedPointsByMeshGroup.Find(ExistingInstance.MeshGroupIndex);
+		if (GroupPoints == nullptr || GroupPoints->Num() == 0)
+		{
+			OwnerSlotsToRemove.Push(OwnerSlot);
+			continue;
+		}
+
+		ExistingInstance.OriginalPoint = GroupPoints->Pop();
+		ExistingInstance.PointTransform = PrepareTransformation(ExistingInstance.OriginalPoint);
+		SetStaticMeshInstanceTransform(ExistingInstance, ApplyTransformation(ExistingInstance.PointTransform, Registration.ComponentTransform));
+		ApplyStats.Moved += 1;
 	}
 
-	// Delete remaining old instances
-	for(const auto ExistingActors: ExistingActorsByClass)
+	// Remove what's left & then add instances for the remaining points
+	if (OwnerSlotsToRemove.Num() > 0)
 	{
-		for (const FOpenLandInstancedActorInfo ExistingActor: ExistingActors.Value)
+		RemoveStaticMeshInstances(SpawnedRegistration, OwnerSlotsToRemove);
+		ApplyStats.Removed += OwnerSlotsToRemove.Num();
+	}
+
+	for (const auto& GroupPoints: UnmatchedPointsByMeshGroup)
+	{
+		for (const FOpenLandInstancingRequestPoint& NewPoint: GroupPoints.Value)
 		{
-			if (ExistingActor.Actor != nullptr)
-			{
-				AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(ExistingActor.Actor);
-				if (MeshActor != nullptr)
-				{
-					ChildMeshActors.Remove(MeshActor->GetObjectId());
-				}
-				ExistingActor.Actor->Destroy(true);
-			}
+			AddStaticMeshInstance(Registration.OwnerId, SpawnedRegistration, NewPoint, Registration.ComponentTransform);
+			ApplyStats.Added += 1;
 		}
 	}
 
-	for(const auto ExistingActors: ExistingActorsByStaticMesh)
+	SpawnedRegistration.PlacedTransform = Registration.ComponentTransform;
+	SpawnedRegistration.bHasPlacedTransform = true;
+
+	LastApplyStats = ApplyStats;
+	SET_DWORD_STAT(STAT_OpenLandMesh_InstancingAdded, ApplyStats.Added);
+	SET_DWORD_STAT(STAT_OpenLandMesh_InstancingMoved, ApplyStats.Moved);
+	SET_DWORD_STAT(STAT_OpenLandMesh_InstancingRemoved, ApplyStats.Removed);
+	UE_LOG(LogTemp, Verbose, TEXT("Instancing Applied: Added: %d, Moved: %d, Removed: %d, Unchanged: %d"), ApplyStats.Added, ApplyStats.Moved, ApplyStats.Removed, ApplyStats.Unchanged)
+}
+
+void AOpenLandInstancingController::SpawnInstanceActor(FOpenLandInstancedActorInfo& ActorInfo, const FTransform& OwnerTransform)
+{
+	ActorInfo.bPendingSpawn = false;
+	if (ActorInfo.OriginalPoint.ActorClass == nullptr)
+	{
+		return;
+	}
+
+	const FTransform InstanceTransform = ApplyTransformation(ActorInfo.PointTransform, OwnerTransform);
+	const FVector SpawnLocation = InstanceTransform.GetLocation();
+	const FRotator SpawnRotation = InstanceTransform.Rotator();
+	ActorInfo.Actor = GetWorld()->SpawnActor(ActorInfo.OriginalPoint.ActorClass, &SpawnLocation, &SpawnRotation);
+	if (ActorInfo.Actor == nullptr)
+	{
+		return;
+	}
+	ActorInfo.Actor->SetActorRelativeScale3D(InstanceTransform.GetScale3D());
+
+	// Register child mesh actors. This will be useful later when cleaning
+	AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(ActorInfo.Actor);
+	if (MeshActor != nullptr)
+	{
+		ChildMeshes.Add(MeshActor->GetObjectId(), MeshActor);
+	}
+#if WITH_EDITOR
+	ActorInfo.Actor->SetFolderPath("OpenLandMeshInstances");
+#endif
+}
+
+void AOpenLandInstancingController::SpawnPendingActors()
+{
+	// Nearest owners first
+	TArray<TPair<float, FGuid>> Owners;
+	for (const FGuid& OwnerId: OwnersWithPendingSpawns)
+	{
+		FTransform OwnerTransform;
+		const bool bHasTransform = FindOwnerTransform(OwnerId, OwnerTransform);
+		const float DistanceSquared = bHasTransform && bHasCameraLocation ? FVector::DistSquared(OwnerTransform.GetLocation(), CameraLocation) : 0.0f;
+		Owners.Push({DistanceSquared, OwnerId});
+	}
+	Owners.Sort([](const TPair<float, FGuid>& A, const TPair<float, FGuid>& B)
+	{
+		return A.Key < B.Key;
+	});
+
+	bool bSpawnedAny = false;
+	for (const TPair<float, FGuid>& Owner: Owners)
 	{
-		for (const FOpenLandInstancedActorInfo ExistingActor: ExistingActors.Value)
+		FOpenLandInstancedActorGroup* OwnerGroup = InstancedGroups.Find(Owner.Value);
+		if (OwnerGroup == nullptr || OwnerGroup->NumPendingSpawns <= 0)
+		{
+			OwnersWithPendingSpawns.Remove(Owner.Value);
+			continue;
+		}
+
+		FTransform OwnerTransform;
+		if (!FindOwnerTransform(Owner.Value, OwnerTransform))
+		{
+			// We'll try again once the owner is registered
+			continue;
+		}
+
+		TArray<FOpenLandInstancedActorInfo>& SpawnedActors = OwnerGroup->SpawnedActors;
+		for (; OwnerGroup->NextPendingSpawn < SpawnedActors.Num(); OwnerGroup->NextPendingSpawn++)
 		{
-			if (ExistingActor.Actor != nullptr)
+			FOpenLandInstancedActorInfo& ActorInfo = SpawnedActors[OwnerGroup->NextPendingSpawn];
+			if (!ActorInfo.bPendingSpawn)
+			{
+				continue;
+			}
+
+			// We always spawn at least one actor per frame. Otherwise we'll never finish.
+			if (bSpawnedAny && !HasFrameBudget())
 			{
-				ExistingActor.Actor->Destroy(true);
+				return;
 			}
+
+			SpawnInstanceActor(ActorInfo, OwnerTransform);
+			OwnerGroup->NumPendingSpawns -= 1;
+			bSpawnedAny = true;
 		}
+
+		OwnerGroup->NumPendingSpawns = 0;
+		OwnersWithPendingSpawns.Remove(Owner.Value);
 	}
-	
-	SpawnedRegistration.SpawnedActors = NewActors;
 }
 
-void AOpenLandInstancingController::RemovePoints(FString OwnerId)
+void AOpenLandInstancingController::RemovePoints(const FGuid& OwnerId)
 {
-	if (InstancedGroupsMap.Find(OwnerId) == nullptr)
+	FOpenLandInstancedActorGroup* SpawnedRegistrationPtr = InstancedGroups.Find(OwnerId);
+	if (SpawnedRegistrationPtr == nullptr)
 	{
 		return;
 	}
 
-	FOpenLandInstancedActorGroup &SpawnedRegistration = InstancedGroupsMap[OwnerId];
+	FOpenLandInstancedActorGroup &SpawnedRegistration = *SpawnedRegistrationPtr;
+	RemoveAllStaticMeshInstances(SpawnedRegistration);
 
 	// Delete existing instances
 	for (const FOpenLandInstancedActorInfo SpawnedActorInfo: SpawnedRegistration.SpawnedActors)
@@ -305,37 +760,80 @@ void AOpenLandInstancingController::RemovePoints(FString OwnerId)
 			AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(SpawnedActorInfo.Actor);
 			if (MeshActor != nullptr)
 			{
-				ChildMeshActors.Remove(MeshActor->GetObjectId());
+				ChildMeshes.Remove(MeshActor->GetObjectId());
 			}
 			SpawnedActorInfo.Actor->Destroy(true);
 		}
 	}
 
-	InstancedGroupsMap.Remove(OwnerId);
+	InstancedGroups.Remove(OwnerId);
 	// TODO: This can be problematic, but easy to implement
 	RequestsRegistry.Remove(OwnerId);
 }
 
 void AOpenLandInstancingController::UpdatePointTransform(FOpenLandInstancingRequest& Registration)
 {
-	if (InstancedGroupsMap.Find(Registration.OwnerId) == nullptr)
+	FOpenLandInstancedActorGroup* SpawnedRegistrationPtr = InstancedGroups.Find(Registration.OwnerId);
+	if (SpawnedRegistrationPtr == nullptr)
 	{
 		return;
 	}
 
-	FOpenLandInstancedActorGroup &SpawnedRegistration = InstancedGroupsMap[Registration.OwnerId];
-	for (const FOpenLandInstancedActorInfo SpawnedActorInfo: SpawnedRegistration.SpawnedActors)
+	FOpenLandInstancedActorGroup &SpawnedRegistration = *SpawnedRegistrationPtr;
+	const FTransform OwnerTransform = Registration.ComponentTransform;
+	if (SpawnedRegistration.bHasPlacedTransform && SpawnedRegistration.PlacedTransform.Equals(OwnerTransform))
+	{
+		return;
+	}
+
+	// Transforms are calculated in parallel into a single buffer. Then we apply them on the game thread.
+	// Static mesh instances go to the components as a batch with FlushStaticMeshGroups()
+	TArray<FOpenLandInstancedStaticMeshInfo>& StaticMeshInstances = SpawnedRegistration.StaticMeshInstances;
+	TArray<FTransform> InstanceTransforms;
+	InstanceTransforms.SetNumUninitialized(StaticMeshInstances.Num());
+	ParallelFor(StaticMeshInstances.Num(), [&StaticMeshInstances, &InstanceTransforms, &OwnerTransform](int32 Index)
+	{
+		FOpenLandInstancedStaticMeshInfo& InstanceInfo = StaticMeshInstances[Index];
+		// Instances saved by earlier versions don't have this
+		if (!InstanceInfo.PointTransform.bIsValid)
+		{
+			InstanceInfo.PointTransform = PrepareTransformation(InstanceInfo.OriginalPoint);
+		}
+		InstanceTransforms[Index] = ApplyTransformation(InstanceInfo.PointTransform, OwnerTransform);
+	}, StaticMeshInstances.Num() < OpenLandInstancingMinParallelPoints);
+
+	for (int32 Index = 0; Index < StaticMeshInstances.Num(); Index++)
+	{
+		SetStaticMeshInstanceTransform(StaticMeshInstances[Index], InstanceTransforms[Index]);
+	}
+
+	TArray<FOpenLandInstancedActorInfo>& SpawnedActors = SpawnedRegistration.SpawnedActors;
+	TArray<FTransform> ActorTransforms;
+	ActorTransforms.SetNumUninitialized(SpawnedActors.Num());
+	ParallelFor(SpawnedActors.Num(), [&SpawnedActors, &ActorTransforms, &OwnerTransform](int32 Index)
+	{
+		FOpenLandInstancedActorInfo& SpawnedActorInfo = SpawnedActors[Index];
+		if (!SpawnedActorInfo.PointTransform.bIsValid)
+		{
+			SpawnedActorInfo.PointTransform = PrepareTransformation(SpawnedActorInfo.OriginalPoint);
+		}
+		ActorTransforms[Index] = ApplyTransformation(SpawnedActorInfo.PointTransform, OwnerTransform);
+	}, SpawnedActors.Num() < OpenLandInstancingMinParallelPoints);
+
+	for (int32 Index = 0; Index < SpawnedActors.Num(); Index++)
 	{
-		if (SpawnedActorInfo.Actor == nullptr)
+		AActor* Actor = SpawnedActors[Index].Actor;
+		if (Actor == nullptr)
 		{
 			continue;
 		}
-		
-		const AOpenLandInstancingTransformedInfo TransformedInfo = ApplyTransformation(SpawnedActorInfo.OriginalPoint, Registration.ComponentTransform);
-		SpawnedActorInfo.Actor->SetActorLocationAndRotation(TransformedInfo.Position, TransformedInfo.Rotator);
-		SpawnedActorInfo.Actor->SetActorRelativeScale3D(TransformedInfo.Scale);
+
+		Actor->SetActorLocationAndRotation(ActorTransforms[Index].GetLocation(), ActorTransforms[Index].GetRotation());
+		Actor->SetActorRelativeScale3D(ActorTransforms[Index].GetScale3D());
 	}
 
+	SpawnedRegistration.PlacedTransform = OwnerTransform;
+	SpawnedRegistration.bHasPlacedTransform = true;
 }
 
 // Called when the game starts or when spawned
@@ -345,45 +843,175 @@ void AOpenLandInstancingController::BeginPlay()
 	
 }
 
+void AOpenLandInstancingController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
+	{
+		InstancingSubsystem->UnregisterController(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AOpenLandInstancingController::PostRegisterAllComponents()
+{
+	Super::PostRegisterAllComponents();
+
+	// This runs for loaded & spawned controllers, in both editor & game worlds
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
+	{
+		InstancingSubsystem->RegisterController(this);
+	}
+}
+
+void AOpenLandInstancingController::Destroyed()
+{
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
+	{
+		InstancingSubsystem->UnregisterController(this);
+	}
+
+	Super::Destroyed();
+}
+
+void AOpenLandInstancingController::PostLoad()
+{
+	Super::PostLoad();
+
+	for (auto& Pair: InstancedGroupsMap_DEPRECATED)
+	{
+		const FGuid OwnerId = OwnerIdFromString(Pair.Key);
+		for (const FOpenLandInstancedStaticMeshInfo& InstanceInfo: Pair.Value.StaticMeshInstances)
+		{
+			if (StaticMeshGroups.IsValidIndex(InstanceInfo.MeshGroupIndex) &&
+				StaticMeshGroups[InstanceInfo.MeshGroupIndex].InstanceOwners.IsValidIndex(InstanceInfo.InstanceIndex))
+			{
+				StaticMeshGroups[InstanceInfo.MeshGroupIndex].InstanceOwners[InstanceInfo.InstanceIndex].OwnerId = OwnerId;
+			}
+		}
+		InstancedGroups.Add(OwnerId, MoveTemp(Pair.Value));
+	}
+	InstancedGroupsMap_DEPRECATED.Empty();
+
+	for (const auto& Pair: ChildMeshActors_DEPRECATED)
+	{
+		ChildMeshes.Add(OwnerIdFromString(Pair.Key), Pair.Value);
+	}
+	ChildMeshActors_DEPRECATED.Empty();
+
+	// Actors which were still pending when the level was saved
+	for (auto& Pair: InstancedGroups)
+	{
+		Pair.Value.NumPendingSpawns = 0;
+		for (const FOpenLandInstancedActorInfo& ActorInfo: Pair.Value.SpawnedActors)
+		{
+			Pair.Value.NumPendingSpawns += ActorInfo.bPendingSpawn ? 1 : 0;
+		}
+
+		if (Pair.Value.NumPendingSpawns > 0)
+		{
+			OwnersWithPendingSpawns.Add(Pair.Key);
+		}
+	}
+}
+
 // Called every frame
 void AOpenLandInstancingController::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+	FrameStartedAt = FPlatformTime::Seconds();
+	UpdateCameraLocation();
 
-	RemainingTimeToCleanUp -= DeltaTime;
-	if (GetWorld()->IsEditorWorld() && RemainingTimeToCleanUp <= 0)
+	// Owners deleted in the editor don't need their instances anymore
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
 	{
-		CleanUnlinkedInstances();
-		RemainingTimeToCleanUp = InstanceCleaningInterval;
+		for (const FGuid& OwnerId: InstancingSubsystem->ConsumeRemovedOwnerIds())
+		{
+			const FOpenLandInstancedActorGroup* GroupInfo = InstancedGroups.Find(OwnerId);
+			if (GroupInfo != nullptr && GroupInfo->bAllowCleaning)
+			{
+				RemovePoints(OwnerId);
+			}
+		}
 	}
 
-	auto RequestsToUpdateCloned = RequestsToUpdate;
-	RequestsToUpdate = {};
-	
-	for (const FOpenLandInstancingRequestPayload UpdatePayload: RequestsToUpdateCloned)
+	TArray<FOpenLandInstancingRequestPayload> PendingRequests = MoveTemp(RequestsToUpdate);
+	RequestsToUpdate.Reset();
+	PendingRequestIndices.Reset();
+
+	// Nearest owners first
+	if (bHasCameraLocation)
 	{
-		FString OwnerId = UpdatePayload.OwnerId;
-		if (RequestsRegistry.Find(OwnerId) == nullptr)
+		for (FOpenLandInstancingRequestPayload& UpdatePayload: PendingRequests)
 		{
-			continue;
+			FTransform OwnerTransform;
+			UpdatePayload.DistanceSquared = FindOwnerTransform(UpdatePayload.OwnerId, OwnerTransform) ? FVector::DistSquared(OwnerTransform.GetLocation(), CameraLocation) : 0.0f;
 		}
-		
-		FOpenLandInstancingRequest &Registration = RequestsRegistry[OwnerId];
-
-		switch (UpdatePayload.Action)
+		PendingRequests.Sort([](const FOpenLandInstancingRequestPayload& A, const FOpenLandInstancingRequestPayload& B)
 		{
-			case OSC_SET_POINTS:
-				SetPoints(Registration);
-				break;
-			case OSC_UNREGISTER:
-				RemovePoints(UpdatePayload.OwnerId);
-				break;
-			case OSC_UPDATE_TRANSFORM:
-				UpdatePointTransform(Registration);
-				break;
-			default:
-				break;
-		}
+			return A.DistanceSquared < B.DistanceSquared;
+		});
+	}
+
+	// We always process at least one request per frame. Otherwise we'll never finish.
+	int32 NumProcessedRequests = 0;
+	while (NumProcessedRequests < PendingRequests.Num() && (NumProcessedRequests == 0 || HasFrameBudget()))
+	{
+		ProcessRequest(PendingRequests[NumProcessedRequests]);
+		NumProcessedRequests++;
+	}
+
+	if (NumProcessedRequests < PendingRequests.Num())
+	{
+		RequeueRequests(PendingRequests, NumProcessedRequests);
+	}
+
+	SpawnPendingActors();
+
+	// All the instance changes of this frame go to the components together
+	FlushStaticMeshGroups();
+
+	int32 NumPendingActors = 0;
+	for (const FGuid& OwnerId: OwnersWithPendingSpawns)
+	{
+		const FOpenLandInstancedActorGroup* OwnerGroup = InstancedGroups.Find(OwnerId);
+		NumPendingActors += OwnerGroup ? OwnerGroup->NumPendingSpawns : 0;
+	}
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_InstancingRequestsPending, RequestsToUpdate.Num());
+	SET_DWORD_STAT(STAT_OpenLandMesh_InstanceActorsPending, NumPendingActors);
+	SET_FLOAT_STAT(STAT_OpenLandMesh_InstancingBudgetUsed, (FPlatformTime::Seconds() - FrameStartedAt) * 1000.0);
+}
+
+void AOpenLandInstancingController::ProcessRequest(const FOpenLandInstancingRequestPayload& UpdatePayload)
+{
+	if (UpdatePayload.Actions & OSC_UNREGISTER)
+	{
+		RemovePoints(UpdatePayload.OwnerId);
+		return;
+	}
+
+	FOpenLandInstancingRequest* RegistrationPtr = RequestsRegistry.Find(UpdatePayload.OwnerId);
+	if (RegistrationPtr == nullptr)
+	{
+		return;
+	}
+	
+	FOpenLandInstancingRequest &Registration = *RegistrationPtr;
+
+	if (UpdatePayload.Actions & OSC_SET_POINTS)
+	{
+		SetPoints(Registration);
+	}
+
+	// This does nothing if SetPoints already placed the instances with the latest transform
+	if (UpdatePayload.Actions & OSC_UPDATE_TRANSFORM)
+	{
+		UpdatePointTransform(Registration);
 	}
 }
 
@@ -400,22 +1028,19 @@ bool AOpenLandInstancingController::ShouldTickIfViewportsOnly() const
 
 void AOpenLandInstancingController::CleanUnlinkedInstances()
 {
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AOpenLandMeshActor::StaticClass(), FoundActors);
-
-	TSet<FString> ExistingMeshActorIds;
-	for (const AActor* Actor: FoundActors)
+	const UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem == nullptr)
 	{
-		const AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(Actor);
-		ExistingMeshActorIds.Add(MeshActor->GetObjectId());
+		return;
 	}
 
-	TArray<FString> ItemsToRemove;
-	for (const auto Pair: InstancedGroupsMap)
+	TArray<FGuid> ItemsToRemove;
+	for (auto& Pair: InstancedGroups)
 	{
 		const FOpenLandInstancedActorGroup GroupInfo = Pair.Value;
-		if (GroupInfo.bAllowCleaning && ExistingMeshActorIds.Find(Pair.Key) == nullptr)
+		if (GroupInfo.bAllowCleaning && !InstancingSubsystem->IsOwnerRegistered(Pair.Key))
 		{
+			RemoveAllStaticMeshInstances(Pair.Value);
 			for(const auto ActorInfo: GroupInfo.SpawnedActors)
 			{
 				if (ActorInfo.Actor != nullptr)
@@ -428,15 +1053,15 @@ void AOpenLandInstancingController::CleanUnlinkedInstances()
 		}
 	}
 
-	for (const FString Key: ItemsToRemove)
+	for (const FGuid& Key: ItemsToRemove)
 	{
-		InstancedGroupsMap.Remove(Key);
+		InstancedGroups.Remove(Key);
 	}
 }
 
 void AOpenLandInstancingController::RemoveAllInstances()
 {
-	for (const auto Pair: InstancedGroupsMap)
+	for (const auto Pair: InstancedGroups)
 	{
 		for(const auto ActorInfo: Pair.Value.SpawnedActors)
 		{
@@ -447,72 +1072,103 @@ void AOpenLandInstancingController::RemoveAllInstances()
 		}
 	}
 
-	InstancedGroupsMap.Empty();
+	InstancedGroups.Empty();
+
+	for (FOpenLandInstancedStaticMeshGroup& MeshGroup: StaticMeshGroups)
+	{
+		if (MeshGroup.Component != nullptr)
+		{
+			MeshGroup.Component->DestroyComponent();
+		}
+	}
+	StaticMeshGroups.Empty();
 }
 
 void AOpenLandInstancingController::DontRunInstancingAfterBuildMesh()
 {
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AOpenLandMeshActor::StaticClass(), FoundActors);
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem == nullptr)
+	{
+		return;
+	}
 
-	for (AActor* Actor: FoundActors)
+	for (AOpenLandMeshActor* MeshActor: InstancingSubsystem->GetOwners())
 	{
-		AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(Actor);
 		MeshActor->bRunInstancingAfterBuildMesh = false;
 	}
 }
 
 void AOpenLandInstancingController::RunInstancingAfterBuildMesh()
 {
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), AOpenLandMeshActor::StaticClass(), FoundActors);
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem == nullptr)
+	{
+		return;
+	}
 
-	for (AActor* Actor: FoundActors)
+	for (AOpenLandMeshActor* MeshActor: InstancingSubsystem->GetOwners())
 	{
-		AOpenLandMeshActor* MeshActor = Cast<AOpenLandMeshActor>(Actor);
 		MeshActor->bRunInstancingAfterBuildMesh = true;
 	}
 }
 
 void AOpenLandInstancingController::RemoveChildMeshActors()
 {
-	TArray<FString> IdsToDelete;
-	for (const auto Pair: ChildMeshActors)
+	TArray<FGuid> IdsToDelete;
+	for (const auto Pair: ChildMeshes)
 	{
 		AOpenLandMeshActor* MeshActor = Pair.Value;
-		if (InstancedGroupsMap.Find(MeshActor->GetObjectId()) != nullptr)
+		FOpenLandInstancedActorGroup* ChildGroup = InstancedGroups.Find(MeshActor->GetObjectId());
+		if (ChildGroup != nullptr)
 		{
-			InstancedGroupsMap[MeshActor->GetObjectId()].bAllowCleaning = false;
+			ChildGroup->bAllowCleaning = false;
 		}
 
 		IdsToDelete.Push(MeshActor->GetObjectId());
 		MeshActor->Destroy(true);
 	}
 
-	for (FString Id: IdsToDelete)
+	for (const FGuid& Id: IdsToDelete)
 	{
-		ChildMeshActors.Remove(Id);
+		ChildMeshes.Remove(Id);
 	}
 }
 
 TArray<AActor*> AOpenLandInstancingController::GetInstancesForOwner(AOpenLandMeshActor* OwnerMesh)
 {
-	if (Singleton == nullptr)
+	const UOpenLandInstancingSubsystem* InstancingSubsystem = OwnerMesh->GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem == nullptr || InstancingSubsystem->GetController() == nullptr)
 	{
 		return {};
 	}
 
-	if (Singleton->InstancedGroupsMap.Find(OwnerMesh->GetObjectId()) == nullptr)
+	const FOpenLandInstancedActorGroup* OwnerGroup = InstancingSubsystem->GetController()->InstancedGroups.Find(OwnerMesh->GetObjectId());
+	if (OwnerGroup == nullptr)
 	{
 		return {};
 	}
 
 	TArray<AActor*> Instances;
-	for (const FOpenLandInstancedActorInfo ActorInfo: Singleton->InstancedGroupsMap[OwnerMesh->GetObjectId()].SpawnedActors)
+	for (const FOpenLandInstancedActorInfo& ActorInfo: OwnerGroup->SpawnedActors)
 	{
-		Instances.Push(ActorInfo.Actor);
+		if (ActorInfo.Actor != nullptr)
+		{
+			Instances.Push(ActorInfo.Actor);
+		}
 	}
 
 	return Instances;
 }
 
+int32 AOpenLandInstancingController::GetNumPendingInstances() const
+{
+	int32 NumPendingInstances = NumPendingStaticMeshInstances;
+	for (const FGuid& OwnerId: OwnersWithPendingSpawns)
+	{
+		const FOpenLandInstancedActorGroup* OwnerGroup = InstancedGroups.Find(OwnerId);
+		NumPendingInstances += OwnerGroup ? OwnerGroup->NumPendingSpawns : 0;
+	}
+
+	return NumPendingInstances;
+}
+
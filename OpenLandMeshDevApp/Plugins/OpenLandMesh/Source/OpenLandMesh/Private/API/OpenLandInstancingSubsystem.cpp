@@ -0,0 +1,90 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "API/OpenLandInstancingSubsystem.h"
+#include "API/OpenLandInstancingController.h"
+#include "API/OpenLandMeshActor.h"
+
+void UOpenLandInstancingSubsystem::Deinitialize()
+{
+	Controller = nullptr;
+	Owners.Empty();
+	RemovedOwnerIds.Empty();
+	Super::Deinitialize();
+}
+
+void UOpenLandInstancingSubsystem::RegisterController(AOpenLandInstancingController* NewController)
+{
+	// We only use one controller per world. Others (if any) are left alone.
+	if (Controller != nullptr && Controller != NewController && !Controller->IsPendingKill())
+	{
+		return;
+	}
+
+	Controller = NewController;
+}
+
+void UOpenLandInstancingSubsystem::UnregisterController(AOpenLandInstancingController* OldController)
+{
+	if (Controller == OldController)
+	{
+		Controller = nullptr;
+	}
+}
+
+AOpenLandInstancingController* UOpenLandInstancingSubsystem::GetOrSpawnController()
+{
+	if (Controller == nullptr || Controller->IsPendingKill())
+	{
+		RegisterController(GetWorld()->SpawnActor<AOpenLandInstancingController>());
+	}
+
+	return Controller;
+}
+
+void UOpenLandInstancingSubsystem::RegisterOwner(AOpenLandMeshActor* Owner)
+{
+	// An undo could bring back an owner we were about to clean
+	RemovedOwnerIds.Remove(Owner->GetObjectId());
+	Owners.Add(Owner->GetObjectId(), Owner);
+}
+
+void UOpenLandInstancingSubsystem::UnregisterOwner(AOpenLandMeshActor* Owner, bool bRemoveInstances)
+{
+	if (Owners.Remove(Owner->GetObjectId()) > 0 && bRemoveInstances)
+	{
+		RemovedOwnerIds.AddUnique(Owner->GetObjectId());
+	}
+}
+
+AOpenLandMeshActor* UOpenLandInstancingSubsystem::FindOwner(const FGuid& OwnerId) const
+{
+	const TWeakObjectPtr<AOpenLandMeshActor>* Owner = Owners.Find(OwnerId);
+	if (Owner == nullptr)
+	{
+		return nullptr;
+	}
+
+	return Owner->Get();
+}
+
+TArray<AOpenLandMeshActor*> UOpenLandInstancingSubsystem::GetOwners() const
+{
+	TArray<AOpenLandMeshActor*> OwnerActors;
+	OwnerActors.Reserve(Owners.Num());
+	for (const auto& Pair: Owners)
+	{
+		if (Pair.Value.IsValid())
+		{
+			OwnerActors.Push(Pair.Value.Get());
+		}
+	}
+
+	return OwnerActors;
+}
+
+TArray<FGuid> UOpenLandInstancingSubsystem::ConsumeRemovedOwnerIds()
+{
+	TArray<FGuid> OwnerIds = MoveTemp(RemovedOwnerIds);
+	RemovedOwnerIds.Reset();
+	return OwnerIds;
+}
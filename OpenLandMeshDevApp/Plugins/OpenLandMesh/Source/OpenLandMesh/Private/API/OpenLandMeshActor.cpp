@@ -3,12 +3,14 @@
 #include "API/OpenLandMeshActor.h"
 #include <random>
 
-#include "API/OpenLandMeshHash.h"
+#include "API/OpenLandMeshAnimationSubsystem.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Utils/OpenLandPointsBuilder.h"
 #include "API/OpenLandInstancingController.h"
+#include "API/OpenLandInstancingSubsystem.h"
 #include "Utils/OpenLandPointUtils.h"
 #include "Utils/TrackTime.h"
+#include "Compute/OpenLandThreading.h"
 
 // Sets default values
 AOpenLandMeshActor::AOpenLandMeshActor()
@@ -19,10 +21,10 @@ AOpenLandMeshActor::AOpenLandMeshActor()
 	MeshComponent = CreateDefaultSubobject<UOpenLandMeshComponent>(TEXT("MeshComponent"));
 
 	MeshComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
+	// Instances only need to follow us when we actually move
+	MeshComponent->TransformUpdated.AddUObject(this, &AOpenLandMeshActor::OnMeshTransformUpdated);
 
-	UOpenLandMeshHash* HashGen = NewObject<UOpenLandMeshHash>();
-	HashGen->AddFloat(FMath::Rand());
-	ObjectId = HashGen->Generate();
+	ObjectGuid = AOpenLandInstancingController::MakeOwnerId();
 }
 
 AOpenLandMeshActor::~AOpenLandMeshActor()
@@ -46,6 +48,55 @@ void AOpenLandMeshActor::BeginPlay()
 		if (bDisableGPUVertexModifiersOnAnimate)
 			PolygonMesh->RegisterGpuVertexModifier({});
 	}
+
+	// Animation frames are handed out by the subsystem within a frame budget.
+	// We register all actors since bAnimate can be changed at runtime.
+	UOpenLandMeshAnimationSubsystem* AnimationSubsystem = GetWorld()->GetSubsystem<UOpenLandMeshAnimationSubsystem>();
+	if (AnimationSubsystem)
+	{
+		AnimationSubsystem->RegisterActor(this);
+	}
+}
+
+void AOpenLandMeshActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UOpenLandMeshAnimationSubsystem* AnimationSubsystem = GetWorld()->GetSubsystem<UOpenLandMeshAnimationSubsystem>();
+	if (AnimationSubsystem)
+	{
+		AnimationSubsystem->UnregisterActor(this);
+	}
+
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
+	{
+		InstancingSubsystem->UnregisterOwner(this, false);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AOpenLandMeshActor::PostRegisterAllComponents()
+{
+	Super::PostRegisterAllComponents();
+
+	// This runs for loaded & spawned actors, and again when a delete is undone in the editor
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
+	{
+		InstancingSubsystem->RegisterOwner(this);
+	}
+}
+
+void AOpenLandMeshActor::Destroyed()
+{
+	// When deleted in the editor, instances go away with us. In games, we keep them as before.
+	UOpenLandInstancingSubsystem* InstancingSubsystem = GetWorld()->GetSubsystem<UOpenLandInstancingSubsystem>();
+	if (InstancingSubsystem)
+	{
+		InstancingSubsystem->UnregisterOwner(this, !GetWorld()->IsGameWorld());
+	}
+
+	Super::Destroyed();
 }
 
 UOpenLandMeshPolygonMeshProxy* AOpenLandMeshActor::GetPolygonMesh_Implementation()
@@ -62,6 +113,27 @@ void AOpenLandMeshActor::OnAfterAnimations_Implementation()
 {
 }
 
+FOpenLandPolygonMeshModifyOptions AOpenLandMeshActor::MakeAsyncModifyOptions(float LastFrameTime) const
+{
+	FOpenLandPolygonMeshModifyOptions ModifyOptions = {};
+	ModifyOptions.RealTimeSeconds = GetWorld()->RealTimeSeconds;
+	ModifyOptions.CuspAngle = SmoothNormalAngle;
+	ModifyOptions.LastFrameTime = LastFrameTime;
+	ModifyOptions.DesiredFrameRate = DesiredFrameRateOnModify;
+
+	// Offscreen animations can wait behind the visible ones
+	if (AsyncBuildingLODIndex >= 0)
+	{
+		ModifyOptions.Lane = EOpenLandThreadingLane::LODBuild;
+	}
+	else if (!WasRecentlyRendered(0.2f))
+	{
+		ModifyOptions.Lane = EOpenLandThreadingLane::Prewarm;
+	}
+
+	return ModifyOptions;
+}
+
 void AOpenLandMeshActor::RunAsyncModifyMeshProcess(float LastFrameTime)
 {
 	
@@ -69,11 +141,7 @@ void AOpenLandMeshActor::RunAsyncModifyMeshProcess(float LastFrameTime)
 	
 	if (!ModifyStatus.bStarted)
 	{
-		FOpenLandPolygonMeshModifyOptions ModifyOptions = {};
-		ModifyOptions.RealTimeSeconds = GetWorld()->RealTimeSeconds;
-		ModifyOptions.CuspAngle = SmoothNormalAngle;
-		ModifyOptions.LastFrameTime = LastFrameTime;
-		ModifyOptions.DesiredFrameRate = DesiredFrameRateOnModify;
+		const FOpenLandPolygonMeshModifyOptions ModifyOptions = MakeAsyncModifyOptions(LastFrameTime);
 
 		MakeModifyReady();
 		ModifyStatus = PolygonMesh->StartModifyVertices(this, ModifyingLOD->MeshBuildResult, ModifyOptions);
@@ -86,11 +154,7 @@ void AOpenLandMeshActor::RunAsyncModifyMeshProcess(float LastFrameTime)
 	if (ModifyStatus.bAborted)
 	{
 		UE_LOG(LogTemp, Warning, TEXT(" RunAsyncModifyMeshProcess Aborted"))
-		FOpenLandPolygonMeshModifyOptions ModifyOptions = {};
-		ModifyOptions.RealTimeSeconds = GetWorld()->RealTimeSeconds;
-		ModifyOptions.CuspAngle = SmoothNormalAngle;
-		ModifyOptions.LastFrameTime = LastFrameTime;
-		ModifyOptions.DesiredFrameRate = DesiredFrameRateOnModify;
+		const FOpenLandPolygonMeshModifyOptions ModifyOptions = MakeAsyncModifyOptions(LastFrameTime);
 		ModifyStatus = PolygonMesh->StartModifyVertices(this, ModifyingLOD->MeshBuildResult, ModifyOptions);
 		return;
 	}
@@ -144,7 +208,6 @@ void AOpenLandMeshActor::RunSyncModifyMeshProcess()
 void AOpenLandMeshActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-	AOpenLandInstancingController::UpdateTransforms(this);
 	
 	const bool bIsEditor = GetWorld()->WorldType == EWorldType::Editor;
 
@@ -208,6 +271,40 @@ void AOpenLandMeshActor::Tick(float DeltaTime)
 		return;
 	}
 
+	// When the animation subsystem is there, it decides when to start the next animation frame
+	if (GetWorld()->GetSubsystem<UOpenLandMeshAnimationSubsystem>() != nullptr)
+	{
+		return;
+	}
+
+	RunAnimationFrame(DeltaTime);
+}
+
+bool AOpenLandMeshActor::CanRunAnimationFrame() const
+{
+	if (!bAnimate || CurrentLOD == nullptr || PolygonMesh == nullptr)
+	{
+		return false;
+	}
+
+	if (GetWorld()->WorldType == EWorldType::Editor)
+	{
+		return false;
+	}
+
+	// There's an animation frame in progress or a LOD is being built.
+	// Those are continued inside the Tick()
+	if (ModifyStatus.bStarted || bNeedToAsyncModifyMesh || AsyncBuildingLODIndex >= 0)
+	{
+		return false;
+	}
+
+	const bool bIsLocked = CurrentLOD->MeshBuildResult && CurrentLOD->MeshBuildResult->Target && CurrentLOD->MeshBuildResult->Target->IsLocked();
+	return !bIsLocked;
+}
+
+void AOpenLandMeshActor::RunAnimationFrame(float DeltaTime)
+{
 	if (bUseAsyncAnimations)
 	{
 		RunAsyncModifyMeshProcess(DeltaTime);
@@ -219,6 +316,8 @@ void AOpenLandMeshActor::Tick(float DeltaTime)
 
 void AOpenLandMeshActor::BuildMesh()
 {
+	ResetCollisionWork();
+
 	// TODO: Remove this once we introduced a pool for RenderTargets & Textures
 	if (GetWorld()->WorldType == EWorldType::Editor)
 		// Inside Editor, it's possible to call this function multiple times.
@@ -284,18 +383,8 @@ void AOpenLandMeshActor::BuildMesh()
 			ForcedTextureWidth
 	    };
 
-		const FString CacheKey = MakeCacheKey(BuildMeshOptions.SubDivisions);
+		const FString CacheKey = MakeCacheKey(BuildMeshOptions);
 		const FOpenLandPolygonMeshBuildResultPtr NewMeshBuildResult = PolygonMesh->BuildMesh(this, BuildMeshOptions, CacheKey);
-
-		NewMeshBuildResult->Target->bSectionVisible = false;
-		NewMeshBuildResult->Target->bEnableCollision = bEnableCollision;
-
-		// With this setting, we use the given LOD as the collision mesh
-		// Otherwise, we will use all of these sections
-		if (LODIndexForCollisions >= 0 && bEnableCollision)
-		{
-			NewMeshBuildResult->Target->bEnableCollision = LODIndex == LODIndexForCollisions;
-		}
 		
 		LOD->MeshBuildResult = NewMeshBuildResult;
 		LOD->MeshSectionIndex = LODIndex;
@@ -311,22 +400,21 @@ void AOpenLandMeshActor::BuildMesh()
 		TrackTime TotalLRenderingRegTime = TrackTime("Total Render Registration", true);
 		for (const FLODInfoPtr LOD: NewLODList)
 		{
-			LOD->MeshBuildResult->Target->bSectionVisible = LOD->LODIndex == CurrentLODIndex;
 			const bool bHasSection = MeshComponent->NumMeshSections() > LOD->MeshSectionIndex;
 			if (bHasSection)
 			{
-				MeshComponent->ReplaceMeshSection(LOD->MeshSectionIndex, LOD->MeshBuildResult->Target);
+				MeshComponent->ReplaceMeshSection(LOD->MeshSectionIndex, LOD->MeshBuildResult->Target, LOD->CanShareRenderData());
 			} else
 			{
-				MeshComponent->CreateMeshSection(LOD->MeshSectionIndex, LOD->MeshBuildResult->Target);
+				MeshComponent->CreateMeshSection(LOD->MeshSectionIndex, LOD->MeshBuildResult->Target, LOD->CanShareRenderData());
 			}
+
+			MeshComponent->SetMeshSectionVisible(LOD->MeshSectionIndex, LOD->LODIndex == CurrentLODIndex);
+			// Collisions are handled by a separate collision mesh. See SetupCollisionMesh()
+			MeshComponent->SetMeshSectionCollisionEnabled(LOD->MeshSectionIndex, false);
 		}
 		TotalLRenderingRegTime.Finish();
 
-		TrackTime UpdateCollisionTime = TrackTime("Setup Collisions", true);
-		MeshComponent->SetupCollisions(bUseAsyncCollisionCooking);
-		UpdateCollisionTime.Finish();
-
 		MeshComponent->InvalidateRendering();
 	} else
 	{
@@ -342,6 +430,13 @@ void AOpenLandMeshActor::BuildMesh()
 		CurrentLODIndex = 0;
 	}
 	CurrentLOD = LODList[CurrentLODIndex];
+
+	if (CanRenderMesh())
+	{
+		TrackTime UpdateCollisionTime = TrackTime("Setup Collisions", true);
+		SetupCollisionMesh();
+		UpdateCollisionTime.Finish();
+	}
 	
 	SetMaterial(Material);
 	bMeshGenerated = true;
@@ -527,7 +622,7 @@ void AOpenLandMeshActor::BuildMeshAsync(int32 LODIndex)
 	LODList[LODIndex] = LOD;
 	CurrentLOD = LOD;
 
-	const FString CacheKey = MakeCacheKey(BuildMeshOptions.SubDivisions);
+	const FString CacheKey = MakeCacheKey(BuildMeshOptions);
 	PolygonMesh->BuildMeshAsync(this, BuildMeshOptions, [this](FOpenLandPolygonMeshBuildResultPtr Result)
 	{
 		CurrentLOD->MeshBuildResult = Result;
@@ -552,6 +647,7 @@ void AOpenLandMeshActor::RebuildLODs()
 void AOpenLandMeshActor::ResetCache()
 {
 	PolygonMesh->ClearCache();
+	FOpenLandPointUtils::ClearScatterResults();
 }
 
 void AOpenLandMeshActor::ApplyInstances()
@@ -570,8 +666,9 @@ void AOpenLandMeshActor::ApplyInstances()
 	}
 	
 	TArray<FOpenLandInstancingRequestPoint> InstancingPoints;
-	for (const FOpenLandInstancingRules InstancingRules: InstancingGroups)
+	for (int32 RuleIndex = 0; RuleIndex < InstancingGroups.Num(); RuleIndex++)
 	{
+		const FOpenLandInstancingRules InstancingRules = InstancingGroups[RuleIndex];
 		FLODInfoPtr SelectedLOD = CurrentLOD;
 		if (InstancingRules.DesiredLODIndex >=0 && LODList.Num() > InstancingRules.DesiredLODIndex)
 		{
@@ -582,12 +679,37 @@ void AOpenLandMeshActor::ApplyInstances()
 			}
 		}
 		
+		const int32 RuleSeed = FOpenLandPointUtils::MakeRuleSeed(InstancingSeed, InstancingRules, RuleIndex);
+
+		// An unmodified mesh is identified by its cache key. Then the result only depends on the rules & the seed.
+		FString ScatterKey;
+		if (!SelectedLOD->bIsModifyReady && !SelectedLOD->MeshBuildResult->CacheKey.IsEmpty())
+		{
+			ScatterKey = FOpenLandPointUtils::MakeScatterKey(SelectedLOD->MeshBuildResult->CacheKey, InstancingRules, RuleIndex, RuleSeed);
+			TArray<FOpenLandInstancingRequestPoint> CachedPoints;
+			if (FOpenLandPointUtils::FindScatterResult(ScatterKey, CachedPoints))
+			{
+				// Keys only have asset paths. So, we take the actual objects from the rules.
+				for (FOpenLandInstancingRequestPoint& RequestPoint: CachedPoints)
+				{
+					RequestPoint.ActorClass = InstancingRules.PlacementObject == IROT_ACTOR ? InstancingRules.Actor : nullptr;
+					RequestPoint.StaticMesh = InstancingRules.PlacementObject == IROT_ACTOR ? nullptr : InstancingRules.StaticMesh;
+				}
+				InstancingPoints.Append(CachedPoints);
+				continue;
+			}
+		}
+		
 		const FSimpleMeshInfoPtr MeshInstance = SelectedLOD->MeshBuildResult->Target->Clone();
 		TArray<FOpenLandMeshPoint> MeshPoints;
 
 		if (InstancingRules.SamplingAlgorithm == IRSA_MODIFIED_POISSON_2D)
 		{
-			MeshPoints = FOpenLandPointsBuilder::BuildPointsModifiedPoisson2D(MeshInstance, InstancingRules.Density, InstancingRules.MinimumDistance);
+			MeshPoints = FOpenLandPointsBuilder::BuildPointsModifiedPoisson2D(MeshInstance, InstancingRules.Density, InstancingRules.MinimumDistance, RuleSeed);
+		}
+		else if (InstancingRules.SamplingAlgorithm == IRSA_POISSON_DISK)
+		{
+			MeshPoints = FOpenLandPointsBuilder::BuildPointsPoissonDisk(MeshInstance, InstancingRules.Density, InstancingRules.MinimumDistance, RuleSeed);
 		}
 		else if (InstancingRules.SamplingAlgorithm == IRSA_ORIGIN)
 		{
@@ -614,9 +736,17 @@ void AOpenLandMeshActor::ApplyInstances()
 			MeshPoints = FOpenLandPointsBuilder::BuildPointsMoveToZAxis(MeshInstance);
 		}
 
+		TArray<FOpenLandInstancingRequestPoint> RulePoints;
+		RulePoints.Reserve(MeshPoints.Num());
 		for (const FOpenLandMeshPoint MeshPoint: MeshPoints)
 		{
 			FOpenLandInstancingRequestPoint RequestPoint;
+			RequestPoint.PointId = FOpenLandPointUtils::MakePointId(RuleIndex, MeshPoint);
+			if (RequestPoint.PointId == INDEX_NONE)
+			{
+				continue;
+			}
+
 			RequestPoint.Position = MeshPoint.Position;
 			RequestPoint.Normal = MeshPoint.Normal;
 			RequestPoint.TangentX = MeshPoint.TangentX;
@@ -631,10 +761,17 @@ void AOpenLandMeshActor::ApplyInstances()
 				RequestPoint.ActorClass = nullptr;
 			}
 
-			FOpenLandPointUtils::ApplyPointRandomization(RequestPoint, InstancingRules);
+			const FRandomStream RandomStream(FOpenLandPointUtils::MakePointSeed(RuleSeed, RequestPoint.PointId));
+			FOpenLandPointUtils::ApplyPointRandomization(RequestPoint, InstancingRules, RandomStream);
 			FOpenLandPointUtils::CalculateTangentX(RequestPoint, InstancingRules);
-			InstancingPoints.Push(RequestPoint);
+			RulePoints.Push(RequestPoint);
+		}
+
+		if (!ScatterKey.IsEmpty())
+		{
+			FOpenLandPointUtils::StoreScatterResult(ScatterKey, RulePoints);
 		}
+		InstancingPoints.Append(RulePoints);
 	}
 
 	AOpenLandInstancingController::CreateInstances(this, InstancingPoints);
@@ -645,6 +782,11 @@ void AOpenLandMeshActor::RemoveInstances()
 	AOpenLandInstancingController::Unregister(this);
 }
 
+void AOpenLandMeshActor::OnMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	AOpenLandInstancingController::UpdateTransforms(this);
+}
+
 void AOpenLandMeshActor::SetMaterial(UMaterialInterface* InputMaterial)
 {
 	Material = InputMaterial;
@@ -661,6 +803,18 @@ void AOpenLandMeshActor::OnConstruction(const FTransform& Transform)
 		BuildMesh();
 }
 
+void AOpenLandMeshActor::PostLoad()
+{
+	Super::PostLoad();
+
+	// Keep the id saved by earlier versions. Otherwise we'll lose the link to existing instances.
+	if (!ObjectId_DEPRECATED.IsEmpty())
+	{
+		ObjectGuid = AOpenLandInstancingController::OwnerIdFromString(ObjectId_DEPRECATED);
+		ObjectId_DEPRECATED.Empty();
+	}
+}
+
 void AOpenLandMeshActor::EnsureLODVisibility()
 {
 	for(const FLODInfoPtr LOD: LODList)
@@ -670,8 +824,13 @@ void AOpenLandMeshActor::EnsureLODVisibility()
 			continue;
 		}
 
-		LOD->MeshBuildResult->Target->bSectionVisible = LOD->LODIndex == CurrentLODIndex;
-		MeshComponent->UpdateMeshSectionVisibility(LOD->MeshSectionIndex);
+		MeshComponent->SetMeshSectionVisible(LOD->MeshSectionIndex, LOD->LODIndex == CurrentLODIndex);
+	}
+
+	// Animated collisions follow the current LOD
+	if (bAnimate)
+	{
+		SetupCollisionMesh();
 	}
 }
 
@@ -753,17 +912,17 @@ FSwitchLODsStatus AOpenLandMeshActor::SwitchLODs()
 	return Status;
 }
 
-FString AOpenLandMeshActor::MakeCacheKey(int32 CurrentSubdivisions) const
+FString AOpenLandMeshActor::MakeCacheKey(const FOpenLandPolygonMeshBuildOptions& BuildMeshOptions) const
 {
 	const FString SourceCacheKey = GetCacheKey();
 
-	// So, this actor is not cacheable
 	if (SourceCacheKey.IsEmpty())
 	{
-		return "";
+		// This is empty when there's a CPU vertex modifier. Then this actor is not cacheable.
+		return bUseContentCacheKey ? PolygonMesh->MakeContentCacheKey(BuildMeshOptions) : "";
 	}
 	
-	return SourceCacheKey + "::" + FString::FromInt(SubDivisions) + "::" + FString::FromInt(CurrentSubdivisions);
+	return SourceCacheKey + "::" + FString::FromInt(SubDivisions) + "::" + FString::FromInt(BuildMeshOptions.SubDivisions);
 }
 
 void AOpenLandMeshActor::MakeModifyReady()
@@ -772,6 +931,8 @@ void AOpenLandMeshActor::MakeModifyReady()
 	if (bNeedMeshChange && CurrentLOD->MeshSectionIndex >= 0)
 	{
 		MeshComponent->ReplaceMeshSection(CurrentLOD->MeshSectionIndex, CurrentLOD->MeshBuildResult->Target);
+		// The collision mesh may still point to the shared Target we just replaced
+		SetupCollisionMesh();
 	}
 }
 
@@ -780,23 +941,13 @@ void AOpenLandMeshActor::FinishBuildMeshAsync()
 	if (CanRenderMesh())
 	{
 		CurrentLOD->MeshSectionIndex = MeshComponent->NumMeshSections();
-		MeshComponent->CreateMeshSection(CurrentLOD->MeshSectionIndex, CurrentLOD->MeshBuildResult->Target);
+		MeshComponent->CreateMeshSection(CurrentLOD->MeshSectionIndex, CurrentLOD->MeshBuildResult->Target, CurrentLOD->CanShareRenderData());
 		MeshComponent->InvalidateRendering();
 
-		CurrentLOD->MeshBuildResult->Target->bSectionVisible = true;
-		CurrentLOD->MeshBuildResult->Target->bEnableCollision = bEnableCollision;
-			
-		// With this setting, we use the given LOD as the collision mesh
-		// Otherwise, we will use all of these sections
-		if (LODIndexForCollisions >= 0 && bEnableCollision)
-		{
-			CurrentLOD->MeshBuildResult->Target->bEnableCollision = CurrentLOD->LODIndex == LODIndexForCollisions;
-		}
-				
-		if (CurrentLOD->MeshBuildResult->Target->bEnableCollision)
-		{
-			MeshComponent->SetupCollisions(true);
-		}
+		MeshComponent->SetMeshSectionVisible(CurrentLOD->MeshSectionIndex, true);
+		// Collisions are handled by a separate collision mesh
+		MeshComponent->SetMeshSectionCollisionEnabled(CurrentLOD->MeshSectionIndex, false);
+		SetupCollisionMesh();
 				
 		AsyncBuildingLODIndex = -1;
 		SetMaterial(Material);
@@ -813,6 +964,239 @@ void AOpenLandMeshActor::FinishBuildMeshAsync()
 	}
 }
 
+void AOpenLandMeshActor::SetupCollisionMesh()
+{
+	if (!bEnableCollision)
+	{
+		MeshComponent->SetCollisionMesh(nullptr, false, bUseAsyncCollisionCooking);
+		return;
+	}
+
+	bool bDeformable = false;
+	const FSimpleMeshInfoPtr CollisionSource = FindCollisionSource(bDeformable);
+	if (CollisionSource == nullptr)
+	{
+		return;
+	}
+
+	MeshComponent->SetCollisionMesh(CollisionSource, bDeformable, bUseAsyncCollisionCooking);
+}
+
+FSimpleMeshInfoPtr AOpenLandMeshActor::FindCollisionSource(bool& bIsDeformable)
+{
+	// Only the current LOD gets animated. Others keep their build time positions.
+	bIsDeformable = false;
+
+	// In the async build mode, we only have some of the LODs
+	TArray<FLODInfoPtr> BuiltLODs;
+	for (const FLODInfoPtr LOD: LODList)
+	{
+		if (LOD && LOD->MeshBuildResult && LOD->MeshBuildResult->Target)
+		{
+			BuiltLODs.Push(LOD);
+		}
+	}
+
+	if (BuiltLODs.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	// With this setting, we use the given LOD as the collision mesh
+	if (LODIndexForCollisions >= 0)
+	{
+		for (const FLODInfoPtr LOD: BuiltLODs)
+		{
+			if (LOD->LODIndex == LODIndexForCollisions)
+			{
+				bIsDeformable = bAnimate && LOD == CurrentLOD;
+				return LOD->MeshBuildResult->Target;
+			}
+		}
+
+		return nullptr;
+	}
+
+	if (CollisionSubDivisions >= 0)
+	{
+		for (const FLODInfoPtr LOD: BuiltLODs)
+		{
+			if (LOD->MeshBuildResult->SubDivisions == CollisionSubDivisions)
+			{
+				bIsDeformable = bAnimate && LOD == CurrentLOD;
+				return LOD->MeshBuildResult->Target;
+			}
+		}
+
+		// There's no render LOD with these subdivisions. So, we build one just for collisions.
+		if (CollisionBuildResult != nullptr && CollisionBuildResult->SubDivisions == CollisionSubDivisions)
+		{
+			return CollisionBuildResult->Target;
+		}
+
+		BuildCollisionMeshAsync();
+		return nullptr;
+	}
+
+	// A coarser LOD picked below won't follow the animation. So, we use the one we animate.
+	if (bAnimate)
+	{
+		if (CurrentLOD == nullptr || !BuiltLODs.Contains(CurrentLOD))
+		{
+			return nullptr;
+		}
+
+		bIsDeformable = true;
+		return CurrentLOD->MeshBuildResult->Target;
+	}
+
+	// Pick the coarsest LOD which is close enough to the finest LOD we have
+	BuiltLODs.Sort([](const FLODInfoPtr& A, const FLODInfoPtr& B)
+	{
+		return A->MeshBuildResult->SubDivisions < B->MeshBuildResult->SubDivisions;
+	});
+
+	if (BuiltLODs.Num() == 1)
+	{
+		return BuiltLODs[0]->MeshBuildResult->Target;
+	}
+
+	TArray<FOpenLandPolygonMeshBuildResultPtr> Candidates;
+	TArray<FSimpleMeshInfoPtr> CandidateTargets;
+	for (const FLODInfoPtr LOD: BuiltLODs)
+	{
+		Candidates.Push(LOD->MeshBuildResult);
+		CandidateTargets.Push(LOD->MeshBuildResult->Target);
+	}
+
+	if (PickedCollisionSource != nullptr && CollisionPickCandidates == CandidateTargets)
+	{
+		return PickedCollisionSource;
+	}
+
+	// Calculating the error needs to go through all the vertices of the finest LOD. So, we do it on a worker.
+	PickCollisionSourceAsync(Candidates);
+	return nullptr;
+}
+
+void AOpenLandMeshActor::BuildCollisionMeshAsync()
+{
+	if (bCollisionBuildInProgress)
+	{
+		return;
+	}
+
+	bCollisionBuildInProgress = true;
+	const int32 NumVerticesForLOD0 = PolygonMesh->CalculateVerticesForSubdivision(SubDivisions);
+	FOpenLandPolygonMeshBuildOptions BuildMeshOptions = {};
+	BuildMeshOptions.SubDivisions = CollisionSubDivisions;
+	BuildMeshOptions.CuspAngle = SmoothNormalAngle;
+	BuildMeshOptions.ForcedTextureWidth = FMath::CeilToInt(FMath::Sqrt(NumVerticesForLOD0));
+
+	const int32 WorkId = CollisionWorkId;
+	TWeakObjectPtr<AOpenLandMeshActor> WeakThis = this;
+	const auto Finish = [WeakThis, WorkId](FOpenLandPolygonMeshBuildResultPtr Result)
+	{
+		if (!WeakThis.IsValid() || WeakThis->CollisionWorkId != WorkId)
+		{
+			return;
+		}
+
+		WeakThis->bCollisionBuildInProgress = false;
+		WeakThis->CollisionBuildResult = Result;
+		WeakThis->SetupCollisionMesh();
+	};
+
+	const FString CacheKey = MakeCacheKey(BuildMeshOptions);
+	PolygonMesh->BuildMeshAsync(this, BuildMeshOptions, [WeakThis, BuildMeshOptions, Finish](FOpenLandPolygonMeshBuildResultPtr Result)
+	{
+		if (Result->Target != nullptr)
+		{
+			Finish(Result);
+			return;
+		}
+
+		if (!WeakThis.IsValid() || WeakThis->PolygonMesh == nullptr)
+		{
+			return;
+		}
+
+		WeakThis->PolygonMesh->BuildTargetAsync(WeakThis.Get(), Result, BuildMeshOptions, [Finish, Result]()
+		{
+			Finish(Result);
+		});
+	}, CacheKey);
+}
+
+void AOpenLandMeshActor::PickCollisionSourceAsync(const TArray<FOpenLandPolygonMeshBuildResultPtr>& Candidates)
+{
+	if (bCollisionPickInProgress)
+	{
+		return;
+	}
+
+	bCollisionPickInProgress = true;
+	// Animations should not move these vertices while we compare them
+	for (const FOpenLandPolygonMeshBuildResultPtr& Candidate: Candidates)
+	{
+		Candidate->Target->Lock();
+	}
+
+	const int32 WorkId = CollisionWorkId;
+	const float MaxError = CollisionMaxError;
+	TWeakObjectPtr<AOpenLandMeshActor> WeakThis = this;
+	FOpenLandThreading::RunOnLane(EOpenLandThreadingLane::LODBuild, [WeakThis, Candidates, MaxError, WorkId]()
+	{
+		// Candidates are sorted from the coarsest to the finest
+		const FOpenLandPolygonMeshBuildResultPtr Finest = Candidates.Last();
+		int32 PickedIndex = Candidates.Num() - 1;
+		for (int32 Index = 0; Index < Candidates.Num() - 1; Index++)
+		{
+			const FOpenLandPolygonMeshBuildResultPtr Coarse = Candidates[Index];
+			const float Error = FOpenLandPolygonMesh::CalculateSubDivisionError(Finest->Target.Get(), Finest->SubDivisions, Coarse->Target.Get(), Coarse->SubDivisions);
+			if (Error <= MaxError)
+			{
+				UE_LOG(LogTemp, Verbose, TEXT("Collision SubDivisions: %d, Error: %f"), Coarse->SubDivisions, Error)
+				PickedIndex = Index;
+				break;
+			}
+		}
+
+		FOpenLandThreading::RunOnGameThread([WeakThis, Candidates, PickedIndex, WorkId]()
+		{
+			for (const FOpenLandPolygonMeshBuildResultPtr& Candidate: Candidates)
+			{
+				Candidate->Target->UnLock();
+			}
+
+			if (!WeakThis.IsValid() || WeakThis->CollisionWorkId != WorkId)
+			{
+				return;
+			}
+
+			WeakThis->bCollisionPickInProgress = false;
+			WeakThis->PickedCollisionSource = Candidates[PickedIndex]->Target;
+			WeakThis->CollisionPickCandidates.Reset();
+			for (const FOpenLandPolygonMeshBuildResultPtr& Candidate: Candidates)
+			{
+				WeakThis->CollisionPickCandidates.Push(Candidate->Target);
+			}
+			WeakThis->SetupCollisionMesh();
+		});
+	});
+}
+
+void AOpenLandMeshActor::ResetCollisionWork()
+{
+	// The mesh is going to change. Anything built or picked for the old one is outdated.
+	CollisionWorkId += 1;
+	CollisionBuildResult = nullptr;
+	bCollisionBuildInProgress = false;
+	PickedCollisionSource = nullptr;
+	CollisionPickCandidates.Reset();
+	bCollisionPickInProgress = false;
+}
+
 bool AOpenLandMeshActor::CanRenderMesh() const
 {
 	if (MeshVisibility == MV_SHOW_ALWAYS)
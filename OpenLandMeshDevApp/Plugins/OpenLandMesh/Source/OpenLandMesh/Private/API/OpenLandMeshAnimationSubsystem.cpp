@@ -0,0 +1,201 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "API/OpenLandMeshAnimationSubsystem.h"
+#include "API/OpenLandMeshActor.h"
+#include "Compute/OpenLandJobSystem.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Animation Scheduler Tick"), STAT_OpenLandMesh_AnimationSchedulerTick, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Animated Actors"), STAT_OpenLandMesh_AnimatedActors, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Animation Frames Started"), STAT_OpenLandMesh_AnimationFramesStarted, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Animation Frames Deferred"), STAT_OpenLandMesh_AnimationFramesDeferred, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Animation Frames In Flight"), STAT_OpenLandMesh_AnimationFramesInFlight, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Animation Budget Used (ms)"), STAT_OpenLandMesh_AnimationBudgetUsed, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Animation Max Seconds Behind"), STAT_OpenLandMesh_AnimationMaxSecondsBehind, STATGROUP_OpenLandMesh);
+
+bool UOpenLandMeshAnimationSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// We never animate inside the editor world. So, there's nothing to schedule.
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World != nullptr && World->IsGameWorld();
+}
+
+void UOpenLandMeshAnimationSubsystem::Deinitialize()
+{
+	AnimatedActors.Empty();
+	Super::Deinitialize();
+}
+
+FOpenLandMeshAnimatedActorInfo* UOpenLandMeshAnimationSubsystem::FindActorInfo(const AOpenLandMeshActor* Actor)
+{
+	return AnimatedActors.FindByPredicate([Actor](const FOpenLandMeshAnimatedActorInfo& Info)
+	{
+		return Info.Actor.Get() == Actor;
+	});
+}
+
+void UOpenLandMeshAnimationSubsystem::RegisterActor(AOpenLandMeshActor* Actor)
+{
+	if (Actor == nullptr || FindActorInfo(Actor) != nullptr)
+	{
+		return;
+	}
+
+	FOpenLandMeshAnimatedActorInfo Info;
+	Info.Actor = Actor;
+	Info.LastUpdatedAt = FPlatformTime::Seconds();
+	AnimatedActors.Push(Info);
+}
+
+void UOpenLandMeshAnimationSubsystem::UnregisterActor(AOpenLandMeshActor* Actor)
+{
+	AnimatedActors.RemoveAll([Actor](const FOpenLandMeshAnimatedActorInfo& Info)
+	{
+		return Info.Actor.Get() == Actor;
+	});
+}
+
+FOpenLandMeshAnimationStatus UOpenLandMeshAnimationSubsystem::GetAnimationStatus(AOpenLandMeshActor* Actor)
+{
+	const FOpenLandMeshAnimatedActorInfo* Info = FindActorInfo(Actor);
+	if (Info == nullptr)
+	{
+		return {};
+	}
+
+	return Info->Status;
+}
+
+void UOpenLandMeshAnimationSubsystem::UpdatePriority(FOpenLandMeshAnimatedActorInfo& Info, const FVector& CameraLocation, bool bHasCamera) const
+{
+	const AOpenLandMeshActor* Actor = Info.Actor.Get();
+	FOpenLandMeshAnimationStatus& Status = Info.Status;
+
+	// This is an approximation of the screen size. It's enough to compare actors with each other.
+	const FBoxSphereBounds Bounds = Actor->MeshComponent->Bounds;
+	const float Distance = bHasCamera ? FVector::Distance(CameraLocation, Bounds.Origin) : 0.0f;
+	Status.ScreenSize = Bounds.SphereRadius / FMath::Max(Distance, 1.0f);
+	Status.bRecentlyRendered = Actor->WasRecentlyRendered(0.2f);
+
+	if (!Status.bRecentlyRendered)
+	{
+		Status.UpdateInterval = OffscreenUpdateInterval;
+	}
+	else if (Status.ScreenSize >= FullRateScreenSize)
+	{
+		Status.UpdateInterval = 0;
+	}
+	else
+	{
+		const float SizeRatio = Status.ScreenSize / FMath::Max(FullRateScreenSize, KINDA_SMALL_NUMBER);
+		Status.UpdateInterval = DistantUpdateInterval * (1.0f - SizeRatio);
+	}
+
+	// Actors waiting for a long time get a boost. Otherwise small actors may never get a chance to update
+	// when there are a lot of big actors in the view.
+	const float VisibilityFactor = Status.bRecentlyRendered ? 1.0f : 0.1f;
+	Status.Priority = VisibilityFactor * Status.ScreenSize * (1.0f + Status.SecondsBehind);
+}
+
+void UOpenLandMeshAnimationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_OpenLandMesh_AnimationSchedulerTick);
+
+	AnimatedActors.RemoveAll([](const FOpenLandMeshAnimatedActorInfo& Info)
+	{
+		return !Info.Actor.IsValid();
+	});
+
+	const UWorld* World = GetWorld();
+	const bool bHasCamera = World->ViewLocationsRenderedLastFrame.Num() > 0;
+	const FVector CameraLocation = bHasCamera ? World->ViewLocationsRenderedLastFrame[0] : FVector::ZeroVector;
+	const double Now = FPlatformTime::Seconds();
+
+	// Find actors which are due for a new animation frame
+	TArray<FOpenLandMeshAnimatedActorInfo*> DueActors;
+	int32 FramesInFlight = 0;
+	for (FOpenLandMeshAnimatedActorInfo& Info : AnimatedActors)
+	{
+		AOpenLandMeshActor* Actor = Info.Actor.Get();
+		if (Actor->IsAnimationFrameInProgress())
+		{
+			FramesInFlight += 1;
+		}
+
+		if (!Actor->bAnimate)
+		{
+			Info.Status = {};
+			continue;
+		}
+
+		UpdatePriority(Info, CameraLocation, bHasCamera);
+
+		const float SinceLastUpdate = Now - Info.LastUpdatedAt;
+		if (SinceLastUpdate < Info.Status.UpdateInterval || !Actor->CanRunAnimationFrame())
+		{
+			continue;
+		}
+
+		DueActors.Push(&Info);
+	}
+
+	DueActors.Sort([](const FOpenLandMeshAnimatedActorInfo& A, const FOpenLandMeshAnimatedActorInfo& B)
+	{
+		return A.Status.Priority > B.Status.Priority;
+	});
+
+	const double BudgetSeconds = FrameBudgetMs / 1000.0;
+	const int32 MaxInFlight = MaxFramesInFlight > 0 ? MaxFramesInFlight : FOpenLandJobSystem::GetMaxConcurrentJobs();
+	const double StartedAt = FPlatformTime::Seconds();
+	int32 FramesStarted = 0;
+	int32 SyncFramesStarted = 0;
+	float MaxSecondsBehind = 0;
+
+	for (FOpenLandMeshAnimatedActorInfo* Info : DueActors)
+	{
+		// Async frames cost almost nothing here, the real work runs on workers. So, we limit those instead.
+		// We always allow one sync actor to run. Otherwise, a single expensive actor will never get a chance.
+		const bool bIsAsync = Info->Actor->bUseAsyncAnimations;
+		const bool bBudgetExceeded = bIsAsync ?
+			FramesInFlight >= MaxInFlight :
+			SyncFramesStarted > 0 && FPlatformTime::Seconds() - StartedAt >= BudgetSeconds;
+		if (bBudgetExceeded)
+		{
+			Info->Status.FramesBehind += 1;
+			Info->Status.SecondsBehind = FMath::Max(0.0f, static_cast<float>(Now - Info->LastUpdatedAt) - Info->Status.UpdateInterval);
+			MaxSecondsBehind = FMath::Max(MaxSecondsBehind, Info->Status.SecondsBehind);
+			continue;
+		}
+
+		const float SinceLastUpdate = Now - Info->LastUpdatedAt;
+		Info->Actor->RunAnimationFrame(SinceLastUpdate);
+		Info->LastUpdatedAt = Now;
+		Info->Status.FramesBehind = 0;
+		Info->Status.SecondsBehind = 0;
+		FramesStarted += 1;
+		if (bIsAsync)
+		{
+			FramesInFlight += 1;
+		} else
+		{
+			SyncFramesStarted += 1;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_AnimatedActors, AnimatedActors.Num());
+	SET_DWORD_STAT(STAT_OpenLandMesh_AnimationFramesStarted, FramesStarted);
+	SET_DWORD_STAT(STAT_OpenLandMesh_AnimationFramesDeferred, DueActors.Num() - FramesStarted);
+	SET_DWORD_STAT(STAT_OpenLandMesh_AnimationFramesInFlight, FramesInFlight);
+	SET_FLOAT_STAT(STAT_OpenLandMesh_AnimationBudgetUsed, (FPlatformTime::Seconds() - StartedAt) * 1000.0);
+	SET_FLOAT_STAT(STAT_OpenLandMesh_AnimationMaxSecondsBehind, MaxSecondsBehind);
+}
+
+bool UOpenLandMeshAnimationSubsystem::IsTickable() const
+{
+	return !HasAnyFlags(RF_ClassDefaultObject) && AnimatedActors.Num() > 0;
+}
+
+TStatId UOpenLandMeshAnimationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UOpenLandMeshAnimationSubsystem, STATGROUP_OpenLandMesh);
+}
@@ -1,6 +1,12 @@
 ﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
 
 #include "API/OpenLandMeshHash.h"
+#include "Hash/CityHash.h"
+
+// Pending bytes are hashed once they reach this size
+static const int32 OpenLandMeshHashChunkSize = 64 * 1024;
+// Seeds the high half of the 128-bit hash, so it's independent from the low half
+static const uint64 OpenLandMeshHashHighSeed = 0x9E3779B97F4A7C15ull;
 
 UOpenLandMeshHash::UOpenLandMeshHash()
 {
@@ -11,8 +17,84 @@ bool UOpenLandMeshHash::IsNull() const
 	return bIsNull;
 }
 
+UOpenLandMeshHash* UOpenLandMeshHash::SetMode(TEnumAsByte<EOpenLandMeshHashMode> NewMode)
+{
+	checkf(IsNull(), TEXT("Hash mode must be set before adding values"));
+	Mode = NewMode;
+	return this;
+}
+
+void UOpenLandMeshHash::UpdateFastHash(const uint8* Data, int64 Size)
+{
+	const char* Chars = reinterpret_cast<const char*>(Data);
+	FastHashLow = CityHash64WithSeed(Chars, Size, FastHashLow);
+	if (Mode == OLMHM_FAST128)
+	{
+		FastHashHigh = CityHash64WithSeeds(Chars, Size, FastHashHigh, OpenLandMeshHashHighSeed);
+	}
+}
+
+void UOpenLandMeshHash::FlushPendingBytes()
+{
+	if (PendingBytes.Num() == 0)
+	{
+		return;
+	}
+
+	UpdateFastHash(PendingBytes.GetData(), PendingBytes.Num());
+	PendingBytes.Reset();
+}
+
+UOpenLandMeshHash* UOpenLandMeshHash::AddBytes(const void* Data, int64 Size)
+{
+	check(!bCompleted);
+	bIsNull = false;
+
+	if (Mode == OLMHM_SHA1)
+	{
+		Hash.Update(static_cast<const uint8*>(Data), Size);
+		return this;
+	}
+
+	// Big buffers are hashed directly. Copying them into the pending bytes is a waste.
+	if (Size >= OpenLandMeshHashChunkSize)
+	{
+		FlushPendingBytes();
+		UpdateFastHash(static_cast<const uint8*>(Data), Size);
+		return this;
+	}
+
+	PendingBytes.Append(static_cast<const uint8*>(Data), Size);
+	if (PendingBytes.Num() >= OpenLandMeshHashChunkSize)
+	{
+		FlushPendingBytes();
+	}
+
+	return this;
+}
+
+UOpenLandMeshHash* UOpenLandMeshHash::AddMeshInfo(const FOpenLandMeshInfo* MeshInfo)
+{
+	// Vertices have padding bytes, which may not be initialized. So, we add the fields we care about.
+	for (size_t Index = 0; Index < MeshInfo->Vertices.Length(); Index++)
+	{
+		const FOpenLandMeshVertex& Vertex = MeshInfo->Vertices.GetData()[Index];
+		AddValue(Vertex.Position);
+		AddValue(Vertex.Normal);
+		AddValue(Vertex.UV0);
+	}
+
+	return AddBytes(MeshInfo->Triangles.GetData(), MeshInfo->Triangles.Length() * sizeof(FOpenLandMeshTriangle));
+}
+
 UOpenLandMeshHash* UOpenLandMeshHash::AddString(FString Value)
 {
+	if (Mode != OLMHM_SHA1)
+	{
+		const FTCHARToUTF8 ValueUTF8(*Value);
+		return AddBytes(ValueUTF8.Get(), ValueUTF8.Length());
+	}
+
 	bIsNull = false;
 	Hash.UpdateWithString(ToCStr(Value), Value.Len());
 	return this;
@@ -20,22 +102,52 @@ UOpenLandMeshHash* UOpenLandMeshHash::AddString(FString Value)
 
 UOpenLandMeshHash* UOpenLandMeshHash::AddInteger(int32 Value)
 {
+	if (Mode != OLMHM_SHA1)
+	{
+		return AddValue(Value);
+	}
+
 	AddString(FString::FromInt(Value));
 	return this;
 }
 
 UOpenLandMeshHash* UOpenLandMeshHash::AddFloat(float Value)
 {
+	if (Mode != OLMHM_SHA1)
+	{
+		return AddValue(Value);
+	}
+
 	AddString(FString::SanitizeFloat(Value));
 	return this;
 }
 
 UOpenLandMeshHash* UOpenLandMeshHash::AddVector(FVector Value)
 {
+	if (Mode != OLMHM_SHA1)
+	{
+		return AddValue(Value);
+	}
+
 	AddString(Value.ToString());
 	return this;
 }
 
+UOpenLandMeshHash* UOpenLandMeshHash::AddIntegerArray(const TArray<int32>& Values)
+{
+	return AddArray<int32>(Values);
+}
+
+UOpenLandMeshHash* UOpenLandMeshHash::AddFloatArray(const TArray<float>& Values)
+{
+	return AddArray<float>(Values);
+}
+
+UOpenLandMeshHash* UOpenLandMeshHash::AddVectorArray(const TArray<FVector>& Values)
+{
+	return AddArray<FVector>(Values);
+}
+
 FString UOpenLandMeshHash::Generate()
 {
 	if (IsNull())
@@ -45,6 +157,18 @@ FString UOpenLandMeshHash::Generate()
 
 	check(!bCompleted);
 	bCompleted = true;
+
+	if (Mode == OLMHM_FAST64)
+	{
+		FlushPendingBytes();
+		return FString::Printf(TEXT("%016llx"), FastHashLow);
+	}
+
+	if (Mode == OLMHM_FAST128)
+	{
+		FlushPendingBytes();
+		return FString::Printf(TEXT("%016llx%016llx"), FastHashHigh, FastHashLow);
+	}
 	
 	Hash.Final();
 	
@@ -53,7 +177,9 @@ FString UOpenLandMeshHash::Generate()
 	return BytesToHex(HashResult, FSHA1::DigestSize);
 }
 
-UOpenLandMeshHash* UOpenLandMeshHash::MakeHash()
+UOpenLandMeshHash* UOpenLandMeshHash::MakeHash(TEnumAsByte<EOpenLandMeshHashMode> HashMode)
 {
-	return NewObject<UOpenLandMeshHash>();
+	UOpenLandMeshHash* HashGen = NewObject<UOpenLandMeshHash>();
+	HashGen->SetMode(HashMode);
+	return HashGen;
 }
@@ -1,18 +1,23 @@
 ﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
 
 #include "API/OpenLandMeshPolygonMeshProxy.h"
+#include "Compute/OpenLandThreading.h"
+#include "Core/OpenLandBuildMeshCache.h"
+#include "Core/OpenLandBuildMeshDiskCache.h"
+#include "Utils/OpenLandMeshStats.h"
 
-TMap<FString, FOpenLandBuildMeshResultCacheInfo> UOpenLandMeshPolygonMeshProxy::CachedBuildMesh = {};
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Build Cache Rebuild Time (ms)"), STAT_OpenLandMesh_BuildCacheRebuildTime, STATGROUP_OpenLandMesh);
 
 UOpenLandMeshPolygonMeshProxy::UOpenLandMeshPolygonMeshProxy()
 {
-	PolygonMesh = new FOpenLandPolygonMesh();
+	PolygonMesh = MakeShared<FOpenLandPolygonMesh, ESPMode::ThreadSafe>();
 }
 
 UOpenLandMeshPolygonMeshProxy::~UOpenLandMeshPolygonMeshProxy()
 {
-	UE_LOG(LogTemp, Warning, TEXT("Deleting UOpenLandMeshPolygonMesh"))
-	FOpenLandPolygonMesh::DeletePolygonMesh(PolygonMesh);
+	// Running async tasks keep their own references.
+	// The mesh gets deleted when the last of them finishes.
+	PolygonMesh = nullptr;
 }
 
 FOpenLandPolygonMeshBuildResultPtr UOpenLandMeshPolygonMeshProxy::BuildMesh(UObject* WorldContext, FOpenLandPolygonMeshBuildOptions Options, FString CacheKey) const
@@ -23,27 +28,24 @@ FOpenLandPolygonMeshBuildResultPtr UOpenLandMeshPolygonMeshProxy::BuildMesh(UObj
 		return PolygonMesh->BuildMesh(WorldContext, Options);
 	}
 
-	FOpenLandBuildMeshResultCacheInfo* CachedInfo = CachedBuildMesh.Find(CacheKey);
-	if (CachedInfo != nullptr)
+	return FOpenLandBuildMeshCache::FindOrBuild(CacheKey, [Self = PolygonMesh, WorldContext, Options, CacheKey]()
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Cache Hit"))
-		CachedInfo->LastCacheHitAt = FDateTime::Now();
-		return CachedInfo->MeshBuildResult->ShallowClone();
-	}
+		// A disk cache hit skips subdivision, tangents & normal smoothing entirely
+		FOpenLandPolygonMeshBuildResultPtr Result = FOpenLandBuildMeshDiskCache::Load(CacheKey, Options.ForcedTextureWidth);
+		if (Result != nullptr)
+		{
+			return Result;
+		}
 
-	UE_LOG(LogTemp, Warning, TEXT("Cache Create"))
-	const FOpenLandPolygonMeshBuildResultPtr Result = PolygonMesh->BuildMesh(WorldContext, Options);
-	Result->CacheKey = CacheKey;
-	
-	FOpenLandBuildMeshResultCacheInfo NewCacheInfo = {};
-	NewCacheInfo.CacheKey = CacheKey;
-	NewCacheInfo.MeshBuildResult = Result;
-	NewCacheInfo.CachedAt = FDateTime::Now();
-	NewCacheInfo.LastCacheHitAt = NewCacheInfo.CachedAt;
-	
-	CachedBuildMesh.Add(CacheKey, NewCacheInfo);
+		UE_LOG(LogTemp, Warning, TEXT("Cache Create"))
+		const double BuildStartedAt = FPlatformTime::Seconds();
+		Result = Self->BuildMesh(WorldContext, Options);
+		SET_FLOAT_STAT(STAT_OpenLandMesh_BuildCacheRebuildTime, (FPlatformTime::Seconds() - BuildStartedAt) * 1000.0);
+		Result->CacheKey = CacheKey;
+		FOpenLandBuildMeshDiskCache::SaveAsync(Result);
 
-	return NewCacheInfo.MeshBuildResult->ShallowClone();
+		return Result;
+	});
 }
 
 void UOpenLandMeshPolygonMeshProxy::BuildMeshAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildOptions Options,
@@ -55,58 +57,69 @@ void UOpenLandMeshPolygonMeshProxy::BuildMeshAsync(UObject* WorldContext, FOpenL
 		return  PolygonMesh->BuildMeshAsync(WorldContext, Options, Callback);
 	}
 
-	FOpenLandBuildMeshResultCacheInfo* CachedInfo = CachedBuildMesh.Find(CacheKey);
-	if (CachedInfo != nullptr)
+	// Other requests may wait on this build. So, it should not keep the requester's world context alive or use it after it's gone.
+	// Then we fail the build & the next waiting request builds it with its own context.
+	TWeakObjectPtr<UObject> WeakWorldContext = WorldContext;
+	const auto Builder = [Self = PolygonMesh, WeakWorldContext, Options, CacheKey](FOpenLandBuildMeshCallback Complete)
 	{
-		if (CachedInfo->MeshBuildResult == nullptr || CachedInfo->MeshBuildResult->Target == nullptr)
+		UE_LOG(LogTemp, Warning, TEXT("BuildMeshAsync:Cache Create"));
+		const double BuildStartedAt = FPlatformTime::Seconds();
+
+		// Loading from the disk cache involves decompression. So, we do it in the same lane as the build.
+		FOpenLandThreading::RunOnLane(Options.Lane, [Self, WeakWorldContext, Options, CacheKey, Complete, BuildStartedAt]()
 		{
-			
-			CachedInfo->AsyncMeshBuildCallbacks.Push(Callback);
-			return;
-		}
-		
-		UE_LOG(LogTemp, Warning, TEXT("BuildMeshAsync:Cache Hit, Have Target"))
-		CachedInfo->LastCacheHitAt = FDateTime::Now();
-		Callback(CachedInfo->MeshBuildResult->ShallowClone());
-		return;
-	}
+			const FOpenLandPolygonMeshBuildResultPtr CachedResult = FOpenLandBuildMeshDiskCache::Load(CacheKey, Options.ForcedTextureWidth);
+			if (CachedResult != nullptr)
+			{
+				Complete(CachedResult);
+				return;
+			}
 
-	UE_LOG(LogTemp, Warning, TEXT("BuildMeshAsync:Cache Create"));
-	
-	FOpenLandBuildMeshResultCacheInfo NewCacheInfo = {};
-	NewCacheInfo.CacheKey = CacheKey;
-	NewCacheInfo.CachedAt = FDateTime::Now();
-	NewCacheInfo.LastCacheHitAt = NewCacheInfo.CachedAt;
-	
-	CachedBuildMesh.Add(CacheKey, NewCacheInfo);
-	
-	auto CallbackWrapper = [Callback, CacheKey](FOpenLandPolygonMeshBuildResultPtr Result)
-	{
-		Result->CacheKey = CacheKey;
-		CachedBuildMesh[CacheKey].MeshBuildResult = Result->ShallowClone();
-		Callback(Result);
+			FOpenLandThreading::RunOnGameThread([Self, WeakWorldContext, Options, CacheKey, Complete, BuildStartedAt]()
+			{
+				if (!WeakWorldContext.IsValid())
+				{
+					Complete(nullptr);
+					return;
+				}
+
+				Self->BuildMeshAsync(WeakWorldContext.Get(), Options, [Self, WeakWorldContext, Options, CacheKey, Complete, BuildStartedAt](FOpenLandPolygonMeshBuildResultPtr Result)
+				{
+					// The GPU modifiers need the world context
+					if (!WeakWorldContext.IsValid())
+					{
+						Complete(nullptr);
+						return;
+					}
+
+					// Everyone waiting on this key gets the result at once.
+					// So, we build the Target here instead of depending on a modify call from one of them.
+					Self->BuildTargetAsync(WeakWorldContext.Get(), Result, Options, [Result, CacheKey, Complete, BuildStartedAt]()
+					{
+						SET_FLOAT_STAT(STAT_OpenLandMesh_BuildCacheRebuildTime, (FPlatformTime::Seconds() - BuildStartedAt) * 1000.0);
+						Result->CacheKey = CacheKey;
+						FOpenLandBuildMeshDiskCache::SaveAsync(Result);
+						Complete(Result);
+					});
+				});
+			});
+		});
 	};
-	
-	return PolygonMesh->BuildMeshAsync(WorldContext, Options, CallbackWrapper);
+
+	FOpenLandBuildMeshCache::FindOrBuildAsync(CacheKey, Builder, Callback);
+}
+
+void UOpenLandMeshPolygonMeshProxy::BuildTargetAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
+                                                     FOpenLandPolygonMeshBuildOptions Options, std::function<void()> Callback) const
+{
+	PolygonMesh->BuildTargetAsync(WorldContext, MeshBuildResult, Options, Callback);
 }
 
 void UOpenLandMeshPolygonMeshProxy::ModifyVertices(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
                                                    FOpenLandPolygonMeshModifyOptions Options) const
                                                    
 {
-	FOpenLandBuildMeshResultCacheInfo* CacheInfo = CachedBuildMesh.Find(MeshBuildResult->CacheKey);
 	PolygonMesh->ModifyVertices(WorldContext, MeshBuildResult, Options);
-
-	if (CacheInfo && CacheInfo->MeshBuildResult->Target == nullptr)
-	{
-		UE_LOG(LogTemp, Warning, TEXT("ModifyVertices: Processing Callabcks"))
-		CacheInfo->MeshBuildResult->Target = MeshBuildResult->Target->Clone();
-		for (const auto Callback: CacheInfo->AsyncMeshBuildCallbacks)
-		{
-			Callback(CacheInfo->MeshBuildResult->ShallowClone());
-		}
-		CacheInfo->AsyncMeshBuildCallbacks = {};
-	}
 }
 
 FOpenLandPolygonMeshModifyStatus UOpenLandMeshPolygonMeshProxy::StartModifyVertices(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
@@ -117,23 +130,7 @@ FOpenLandPolygonMeshModifyStatus UOpenLandMeshPolygonMeshProxy::StartModifyVerti
 
 FOpenLandPolygonMeshModifyStatus UOpenLandMeshPolygonMeshProxy::CheckModifyVerticesStatus(FOpenLandPolygonMeshBuildResultPtr MeshBuildResult, float LastFrameTime) const
 {
-	const FOpenLandPolygonMeshModifyStatus Status = PolygonMesh->CheckModifyVerticesStatus(LastFrameTime);
-	if (Status.bCompleted)
-	{
-		FOpenLandBuildMeshResultCacheInfo* CacheInfo = CachedBuildMesh.Find(MeshBuildResult->CacheKey);
-		if (CacheInfo && CacheInfo->MeshBuildResult->Target == nullptr)
-		{
-			UE_LOG(LogTemp, Warning, TEXT("CheckModifyVerticesStatus: Processing Callabcks"))
-			CacheInfo->MeshBuildResult->Target = MeshBuildResult->Target->Clone();
-			for (const auto Callback: CacheInfo->AsyncMeshBuildCallbacks)
-			{
-				Callback(CacheInfo->MeshBuildResult->ShallowClone());
-			}
-			CacheInfo->AsyncMeshBuildCallbacks = {};
-		}
-	}
-
-	return Status;
+	return PolygonMesh->CheckModifyVerticesStatus(LastFrameTime);
 }
 
 int32 UOpenLandMeshPolygonMeshProxy::CalculateVerticesForSubdivision(int32 Subdivision) const
@@ -141,6 +138,17 @@ int32 UOpenLandMeshPolygonMeshProxy::CalculateVerticesForSubdivision(int32 Subdi
 	return PolygonMesh->CalculateVerticesForSubdivision(Subdivision);
 }
 
+FString UOpenLandMeshPolygonMeshProxy::MakeContentCacheKey(FOpenLandPolygonMeshBuildOptions Options) const
+{
+	uint64 ContentHash;
+	if (!PolygonMesh->CalculateContentHash(Options, ContentHash))
+	{
+		return "";
+	}
+
+	return FString::Printf(TEXT("content::%016llx"), ContentHash);
+}
+
 UOpenLandMeshPolygonMeshProxy* UOpenLandMeshPolygonMeshProxy::AddTriFace(const FOpenLandMeshVertex A,
 	const FOpenLandMeshVertex B, const FOpenLandMeshVertex C)
 {
@@ -335,7 +343,18 @@ UOpenLandMeshPolygonMeshProxy* UOpenLandMeshPolygonMeshProxy::MakeGridMesh(float
 
 void UOpenLandMeshPolygonMeshProxy::ClearCache()
 {
-	CachedBuildMesh.Empty();
+	FOpenLandBuildMeshCache::Clear();
+	FOpenLandBuildMeshDiskCache::Clear();
+}
+
+void UOpenLandMeshPolygonMeshProxy::SetCacheBudget(int32 MegaBytes)
+{
+	FOpenLandBuildMeshCache::SetBudget(static_cast<int64>(MegaBytes) * 1024 * 1024);
+}
+
+int32 UOpenLandMeshPolygonMeshProxy::GetCacheBudget()
+{
+	return FOpenLandBuildMeshCache::GetBudget() / (1024 * 1024);
 }
 
 UOpenLandMeshPolygonMeshProxy* UOpenLandMeshPolygonMeshProxy::AddTriFace(
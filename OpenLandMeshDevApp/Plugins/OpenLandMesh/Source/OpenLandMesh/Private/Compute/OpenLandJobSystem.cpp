@@ -0,0 +1,170 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "Compute/OpenLandJobSystem.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Jobs Running"), STAT_OpenLandMesh_JobsRunning, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queue Depth: VisibleAnimation"), STAT_OpenLandMesh_QueueDepth_VisibleAnimation, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queue Depth: LODBuild"), STAT_OpenLandMesh_QueueDepth_LODBuild, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queue Depth: Prewarm"), STAT_OpenLandMesh_QueueDepth_Prewarm, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Wait Time (ms): VisibleAnimation"), STAT_OpenLandMesh_WaitTime_VisibleAnimation, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Wait Time (ms): LODBuild"), STAT_OpenLandMesh_WaitTime_LODBuild, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Wait Time (ms): Prewarm"), STAT_OpenLandMesh_WaitTime_Prewarm, STATGROUP_OpenLandMesh);
+
+FCriticalSection FOpenLandJobSystem::Lock;
+TQueue<FOpenLandJobSystem::FJob> FOpenLandJobSystem::Queues[static_cast<int32>(EOpenLandThreadingLane::Num)];
+FOpenLandJobLaneStats FOpenLandJobSystem::LaneStats[static_cast<int32>(EOpenLandThreadingLane::Num)];
+int32 FOpenLandJobSystem::SkippedDispatches[static_cast<int32>(EOpenLandThreadingLane::Num)] = {};
+int32 FOpenLandJobSystem::NumRunning = 0;
+int32 FOpenLandJobSystem::MaxConcurrentJobs = 0;
+
+// After this many skipped dispatches, a lane gets the next free worker even if higher lanes have jobs
+static const int32 OpenLandJobMaxSkippedDispatches = 8;
+
+static thread_local bool bOpenLandIsInJob = false;
+
+void FOpenLandJobSystem::Submit(EOpenLandThreadingLane Lane, TFunction<void()> InFunction)
+{
+	const int32 LaneIndex = static_cast<int32>(Lane);
+	{
+		FScopeLock ScopeLock(&Lock);
+		Queues[LaneIndex].Enqueue({MoveTemp(InFunction), FPlatformTime::Seconds()});
+		LaneStats[LaneIndex].QueueDepth += 1;
+		UpdateStats(LaneIndex);
+	}
+
+	TryDispatch();
+}
+
+void FOpenLandJobSystem::TryDispatch()
+{
+	while (true)
+	{
+		FJob Job;
+		int32 LaneIndex = 0;
+
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (NumRunning >= GetMaxConcurrentJobs())
+			{
+				return;
+			}
+
+			// Lanes waited too long go first. Otherwise, the highest lane with a job.
+			constexpr int32 NumLanes = static_cast<int32>(EOpenLandThreadingLane::Num);
+			LaneIndex = INDEX_NONE;
+			for (int32 Index = 0; Index < NumLanes && LaneIndex == INDEX_NONE; Index++)
+			{
+				if (!Queues[Index].IsEmpty() && SkippedDispatches[Index] >= OpenLandJobMaxSkippedDispatches)
+				{
+					LaneIndex = Index;
+				}
+			}
+			for (int32 Index = 0; Index < NumLanes && LaneIndex == INDEX_NONE; Index++)
+			{
+				if (!Queues[Index].IsEmpty())
+				{
+					LaneIndex = Index;
+				}
+			}
+
+			if (LaneIndex == INDEX_NONE || !Queues[LaneIndex].Dequeue(Job))
+			{
+				return;
+			}
+
+			SkippedDispatches[LaneIndex] = 0;
+			for (int32 Index = LaneIndex + 1; Index < NumLanes; Index++)
+			{
+				if (!Queues[Index].IsEmpty())
+				{
+					SkippedDispatches[Index] += 1;
+				}
+			}
+
+			FOpenLandJobLaneStats& Stats = LaneStats[LaneIndex];
+			const float WaitTimeMs = (FPlatformTime::Seconds() - Job.QueuedAt) * 1000.0;
+			Stats.QueueDepth -= 1;
+			Stats.Running += 1;
+			Stats.LastWaitTimeMs = WaitTimeMs;
+			Stats.MaxWaitTimeMs = FMath::Max(Stats.MaxWaitTimeMs, WaitTimeMs);
+			// A moving average is enough to see how the lane behaves over time
+			Stats.AverageWaitTimeMs = Stats.AverageWaitTimeMs == 0 ? WaitTimeMs : FMath::Lerp(Stats.AverageWaitTimeMs, WaitTimeMs, 0.1f);
+			NumRunning += 1;
+			UpdateStats(LaneIndex);
+		}
+
+		TFunction<void()> Function = MoveTemp(Job.Function);
+		FFunctionGraphTask::CreateAndDispatchWhenReady([Function, LaneIndex]()
+		{
+			bOpenLandIsInJob = true;
+			Function();
+			bOpenLandIsInJob = false;
+
+			{
+				FScopeLock ScopeLock(&Lock);
+				LaneStats[LaneIndex].Running -= 1;
+				LaneStats[LaneIndex].Completed += 1;
+				NumRunning -= 1;
+				UpdateStats(LaneIndex);
+			}
+
+			// This worker is free now. So, we can start the next one.
+			TryDispatch();
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	}
+}
+
+void FOpenLandJobSystem::UpdateStats(int32 LaneIndex)
+{
+	const FOpenLandJobLaneStats& Stats = LaneStats[LaneIndex];
+	SET_DWORD_STAT(STAT_OpenLandMesh_JobsRunning, NumRunning);
+
+	switch (static_cast<EOpenLandThreadingLane>(LaneIndex))
+	{
+	case EOpenLandThreadingLane::VisibleAnimation:
+		SET_DWORD_STAT(STAT_OpenLandMesh_QueueDepth_VisibleAnimation, Stats.QueueDepth);
+		SET_FLOAT_STAT(STAT_OpenLandMesh_WaitTime_VisibleAnimation, Stats.AverageWaitTimeMs);
+		break;
+	case EOpenLandThreadingLane::LODBuild:
+		SET_DWORD_STAT(STAT_OpenLandMesh_QueueDepth_LODBuild, Stats.QueueDepth);
+		SET_FLOAT_STAT(STAT_OpenLandMesh_WaitTime_LODBuild, Stats.AverageWaitTimeMs);
+		break;
+	default:
+		SET_DWORD_STAT(STAT_OpenLandMesh_QueueDepth_Prewarm, Stats.QueueDepth);
+		SET_FLOAT_STAT(STAT_OpenLandMesh_WaitTime_Prewarm, Stats.AverageWaitTimeMs);
+		break;
+	}
+}
+
+void FOpenLandJobSystem::SetMaxConcurrentJobs(int32 NewMaxConcurrentJobs)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		MaxConcurrentJobs = FMath::Max(0, NewMaxConcurrentJobs);
+	}
+
+	// We may have more room now
+	TryDispatch();
+}
+
+int32 FOpenLandJobSystem::GetMaxConcurrentJobs()
+{
+	if (MaxConcurrentJobs > 0)
+	{
+		return MaxConcurrentJobs;
+	}
+
+	return FMath::Max(1, FTaskGraphInterface::Get().GetNumBackgroundThreads() - 1);
+}
+
+FOpenLandJobLaneStats FOpenLandJobSystem::GetLaneStats(EOpenLandThreadingLane Lane)
+{
+	FScopeLock ScopeLock(&Lock);
+	return LaneStats[static_cast<int32>(Lane)];
+}
+
+bool FOpenLandJobSystem::IsInJob()
+{
+	return bOpenLandIsInJob;
+}
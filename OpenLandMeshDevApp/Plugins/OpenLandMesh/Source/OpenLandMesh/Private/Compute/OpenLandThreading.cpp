@@ -19,3 +19,13 @@ FGraphEventRef FOpenLandThreading::RunOnAnyBackgroundThread(TFunction<void()> In
 	return FFunctionGraphTask::CreateAndDispatchWhenReady(InFunction, TStatId(), nullptr,
 	                                                      ENamedThreads::AnyBackgroundThreadNormalTask);
 }
+
+void FOpenLandThreading::RunOnLane(EOpenLandThreadingLane Lane, TFunction<void()> InFunction)
+{
+	FOpenLandJobSystem::Submit(Lane, MoveTemp(InFunction));
+}
+
+FOpenLandJobLaneStats FOpenLandThreading::GetLaneStats(EOpenLandThreadingLane Lane)
+{
+	return FOpenLandJobSystem::GetLaneStats(Lane);
+}
\ No newline at end of file
@@ -0,0 +1,331 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "Core/OpenLandBuildMeshCache.h"
+#include "Compute/OpenLandThreading.h"
+#include "Compute/OpenLandJobSystem.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Build Cache Hits"), STAT_OpenLandMesh_BuildCacheHits, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Build Cache Misses"), STAT_OpenLandMesh_BuildCacheMisses, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Build Cache Attached Requests"), STAT_OpenLandMesh_BuildCacheAttached, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Build Cache Evictions"), STAT_OpenLandMesh_BuildCacheEvictions, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Build Cache Entries"), STAT_OpenLandMesh_BuildCacheEntries, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Build Cache Memory (MB)"), STAT_OpenLandMesh_BuildCacheMemory, STATGROUP_OpenLandMesh);
+
+FCriticalSection FOpenLandBuildMeshCache::CacheLock;
+TMap<FString, FOpenLandBuildMeshResultCacheInfo> FOpenLandBuildMeshCache::CachedBuildMesh = {};
+int64 FOpenLandBuildMeshCache::CacheBudgetBytes = 512 * 1024 * 1024;
+int64 FOpenLandBuildMeshCache::CachedBytes = 0;
+
+static int64 MeshInfoSizeInBytes(const FSimpleMeshInfoPtr MeshInfo)
+{
+	if (MeshInfo == nullptr)
+	{
+		return 0;
+	}
+
+	return MeshInfo->Vertices.Length() * sizeof(FOpenLandMeshVertex) + MeshInfo->Triangles.Length() * sizeof(FOpenLandMeshTriangle);
+}
+
+int64 FOpenLandBuildMeshResultCacheInfo::CalculateSizeInBytes() const
+{
+	if (MeshBuildResult == nullptr)
+	{
+		return 0;
+	}
+
+	// Each data texture keeps a CPU copy & a GPU texture. Both use 4 bytes per vertex.
+	const int64 TextureBytes = static_cast<int64>(MeshBuildResult->TextureWidth) * MeshBuildResult->TextureWidth * 4 * 2;
+	return MeshInfoSizeInBytes(MeshBuildResult->Original) + MeshInfoSizeInBytes(MeshBuildResult->Target) + TextureBytes * MeshBuildResult->DataTextures.Num();
+}
+
+bool FOpenLandBuildMeshResultCacheInfo::IsPinned() const
+{
+	if (MeshBuildResult == nullptr)
+	{
+		return true;
+	}
+
+	// Every LOD rendering this entry holds a shallow clone. So, it shares the Original with us.
+	return MeshBuildResult->Original.GetSharedReferenceCount() > 1;
+}
+
+FOpenLandBuildMeshResultCacheInfo& FOpenLandBuildMeshCache::FindOrAddEntry(const FString& CacheKey, bool& bCreated)
+{
+	FOpenLandBuildMeshResultCacheInfo* CacheInfo = CachedBuildMesh.Find(CacheKey);
+	if (CacheInfo != nullptr)
+	{
+		bCreated = false;
+		CacheInfo->LastCacheHitAt = FDateTime::Now();
+		if (CacheInfo->MeshBuildResult != nullptr)
+		{
+			INC_DWORD_STAT(STAT_OpenLandMesh_BuildCacheHits);
+		}
+		else
+		{
+			INC_DWORD_STAT(STAT_OpenLandMesh_BuildCacheAttached);
+		}
+
+		return *CacheInfo;
+	}
+
+	bCreated = true;
+	INC_DWORD_STAT(STAT_OpenLandMesh_BuildCacheMisses);
+
+	FOpenLandBuildMeshResultCacheInfo NewCacheInfo = {};
+	NewCacheInfo.CacheKey = CacheKey;
+	NewCacheInfo.InFlight = MakeShared<FOpenLandBuildMeshInFlight, ESPMode::ThreadSafe>();
+	NewCacheInfo.InFlight->Future = NewCacheInfo.InFlight->Promise.GetFuture().Share();
+	NewCacheInfo.CachedAt = FDateTime::Now();
+	NewCacheInfo.LastCacheHitAt = NewCacheInfo.CachedAt;
+
+	return CachedBuildMesh.Add(CacheKey, NewCacheInfo);
+}
+
+FOpenLandPolygonMeshBuildResultPtr FOpenLandBuildMeshCache::FindOrBuild(const FString& CacheKey, TFunction<FOpenLandPolygonMeshBuildResultPtr()> Builder)
+{
+	FOpenLandBuildMeshInFlightPtr InFlight;
+	bool bCreated;
+	{
+		FScopeLock Lock(&CacheLock);
+		const FOpenLandBuildMeshResultCacheInfo& CacheInfo = FindOrAddEntry(CacheKey, bCreated);
+		if (CacheInfo.MeshBuildResult != nullptr)
+		{
+			return CacheInfo.MeshBuildResult->ShallowClone();
+		}
+
+		InFlight = CacheInfo.InFlight;
+	}
+
+	if (!bCreated && !IsInGameThread() && !FOpenLandJobSystem::IsInJob())
+	{
+		// This is nullptr if every builder of the in flight build failed. Then we build it ourselves.
+		const FOpenLandPolygonMeshBuildResultPtr InFlightResult = InFlight->Future.Get();
+		if (InFlightResult != nullptr)
+		{
+			return InFlightResult->ShallowClone();
+		}
+	}
+
+	// If this is an attached request, whichever build completes first gets cached.
+	const FOpenLandPolygonMeshBuildResultPtr Result = Builder();
+	CompleteBuild(CacheKey, InFlight, Result);
+
+	return Result->ShallowClone();
+}
+
+void FOpenLandBuildMeshCache::FindOrBuildAsync(const FString& CacheKey, FOpenLandBuildMeshAsyncBuilder Builder, FOpenLandBuildMeshCallback Callback)
+{
+	FOpenLandBuildMeshInFlightPtr InFlight;
+	FOpenLandPolygonMeshBuildResultPtr CachedResult;
+	bool bCreated;
+	{
+		FScopeLock Lock(&CacheLock);
+		const FOpenLandBuildMeshResultCacheInfo& CacheInfo = FindOrAddEntry(CacheKey, bCreated);
+		if (CacheInfo.MeshBuildResult != nullptr)
+		{
+			CachedResult = CacheInfo.MeshBuildResult->ShallowClone();
+		}
+		else
+		{
+			InFlight = CacheInfo.InFlight;
+			InFlight->Waiters.Push({Callback, Builder});
+		}
+	}
+
+	if (CachedResult != nullptr)
+	{
+		if (IsInGameThread())
+		{
+			Callback(CachedResult);
+			return;
+		}
+
+		FOpenLandThreading::RunOnGameThread([Callback, CachedResult]()
+		{
+			Callback(CachedResult);
+		});
+		return;
+	}
+
+	if (!bCreated)
+	{
+		return;
+	}
+
+	StartBuild(CacheKey, InFlight, Builder);
+}
+
+void FOpenLandBuildMeshCache::StartBuild(const FString& CacheKey, FOpenLandBuildMeshInFlightPtr InFlight, FOpenLandBuildMeshAsyncBuilder Builder)
+{
+	Builder([CacheKey, InFlight](FOpenLandPolygonMeshBuildResultPtr Result)
+	{
+		if (Result == nullptr)
+		{
+			FailBuild(CacheKey, InFlight);
+			return;
+		}
+
+		CompleteBuild(CacheKey, InFlight, Result);
+	});
+}
+
+void FOpenLandBuildMeshCache::FailBuild(const FString& CacheKey, FOpenLandBuildMeshInFlightPtr InFlight)
+{
+	FOpenLandBuildMeshAsyncBuilder NextBuilder;
+	{
+		FScopeLock Lock(&CacheLock);
+		if (InFlight->bCompleted)
+		{
+			return;
+		}
+
+		// The failed builder belongs to the first waiter. It's gone, so it doesn't need the result either.
+		if (InFlight->Waiters.Num() > 0)
+		{
+			InFlight->Waiters.RemoveAt(0);
+		}
+
+		if (InFlight->Waiters.Num() > 0)
+		{
+			NextBuilder = InFlight->Waiters[0].Builder;
+		}
+		else
+		{
+			InFlight->bCompleted = true;
+			const FOpenLandBuildMeshResultCacheInfo* CacheInfo = CachedBuildMesh.Find(CacheKey);
+			if (CacheInfo != nullptr && CacheInfo->InFlight == InFlight)
+			{
+				CachedBuildMesh.Remove(CacheKey);
+			}
+		}
+	}
+
+	if (NextBuilder)
+	{
+		StartBuild(CacheKey, InFlight, NextBuilder);
+		return;
+	}
+
+	// Synchronous requests waiting on this will build it themselves
+	InFlight->Promise.SetValue(nullptr);
+}
+
+void FOpenLandBuildMeshCache::CompleteBuild(const FString& CacheKey, FOpenLandBuildMeshInFlightPtr InFlight, FOpenLandPolygonMeshBuildResultPtr Result)
+{
+	TArray<FOpenLandBuildMeshCallback> Callbacks;
+	{
+		FScopeLock Lock(&CacheLock);
+		if (InFlight->bCompleted)
+		{
+			return;
+		}
+
+		InFlight->bCompleted = true;
+		for (const FOpenLandBuildMeshWaiter& Waiter: InFlight->Waiters)
+		{
+			Callbacks.Push(Waiter.Callback);
+		}
+		InFlight->Waiters.Reset();
+		Result->CacheKey = CacheKey;
+
+		// The entry may have been cleared (& even re-created) while building. Then we don't own it anymore.
+		FOpenLandBuildMeshResultCacheInfo* CacheInfo = CachedBuildMesh.Find(CacheKey);
+		if (CacheInfo != nullptr && CacheInfo->InFlight == InFlight)
+		{
+			// We keep a clone. So, the entry stays pinned as long as someone uses the Result.
+			CacheInfo->MeshBuildResult = Result->ShallowClone();
+			CacheInfo->InFlight = nullptr;
+			UpdateCacheEntrySize(CacheInfo);
+		}
+
+		EvictCacheEntries();
+	}
+
+	InFlight->Promise.SetValue(Result);
+
+	if (Callbacks.Num() == 0)
+	{
+		return;
+	}
+
+	FOpenLandThreading::RunOnGameThread([Callbacks, Result]()
+	{
+		for (const auto Callback: Callbacks)
+		{
+			Callback(Result->ShallowClone());
+		}
+	});
+}
+
+void FOpenLandBuildMeshCache::Clear()
+{
+	FScopeLock Lock(&CacheLock);
+	CachedBuildMesh.Empty();
+	CachedBytes = 0;
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_BuildCacheEntries, 0);
+	SET_FLOAT_STAT(STAT_OpenLandMesh_BuildCacheMemory, 0);
+}
+
+void FOpenLandBuildMeshCache::SetBudget(int64 Bytes)
+{
+	FScopeLock Lock(&CacheLock);
+	CacheBudgetBytes = FMath::Max<int64>(0, Bytes);
+	EvictCacheEntries();
+}
+
+int64 FOpenLandBuildMeshCache::GetBudget()
+{
+	return CacheBudgetBytes;
+}
+
+void FOpenLandBuildMeshCache::UpdateCacheEntrySize(FOpenLandBuildMeshResultCacheInfo* CacheInfo)
+{
+	const int64 NewSize = CacheInfo->CalculateSizeInBytes();
+	CachedBytes += NewSize - CacheInfo->SizeInBytes;
+	CacheInfo->SizeInBytes = NewSize;
+}
+
+void FOpenLandBuildMeshCache::EvictCacheEntries()
+{
+	if (CachedBytes > CacheBudgetBytes)
+	{
+		TArray<FOpenLandBuildMeshResultCacheInfo*> Candidates;
+		for (auto& Item: CachedBuildMesh)
+		{
+			if (!Item.Value.IsPinned())
+			{
+				Candidates.Push(&Item.Value);
+			}
+		}
+
+		Candidates.Sort([](const FOpenLandBuildMeshResultCacheInfo& A, const FOpenLandBuildMeshResultCacheInfo& B)
+		{
+			return A.LastCacheHitAt < B.LastCacheHitAt;
+		});
+
+		TArray<FString> KeysToEvict;
+		for (const FOpenLandBuildMeshResultCacheInfo* CacheInfo: Candidates)
+		{
+			if (CachedBytes <= CacheBudgetBytes)
+			{
+				break;
+			}
+
+			CachedBytes -= CacheInfo->SizeInBytes;
+			KeysToEvict.Push(CacheInfo->CacheKey);
+		}
+
+		// Evicted entries can still be loaded back from the disk cache
+		for (const FString& Key: KeysToEvict)
+		{
+			CachedBuildMesh.Remove(Key);
+		}
+
+		INC_DWORD_STAT_BY(STAT_OpenLandMesh_BuildCacheEvictions, KeysToEvict.Num());
+	}
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_BuildCacheEntries, CachedBuildMesh.Num());
+	SET_FLOAT_STAT(STAT_OpenLandMesh_BuildCacheMemory, CachedBytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,269 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "Core/OpenLandBuildMeshDiskCache.h"
+#include "Async/MappedFileHandle.h"
+#include "Compute/OpenLandThreading.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Hash/CityHash.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Build Cache Disk Hits"), STAT_OpenLandMesh_BuildCacheDiskHits, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Build Cache Disk Misses"), STAT_OpenLandMesh_BuildCacheDiskMisses, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Build Cache Disk Load Time (ms)"), STAT_OpenLandMesh_BuildCacheDiskLoadTime, STATGROUP_OpenLandMesh);
+
+const uint32 FOpenLandBuildMeshDiskCache::Version = 1;
+bool FOpenLandBuildMeshDiskCache::bEnabled = true;
+
+static const uint32 OpenLandBuildMeshDiskCacheMagic = 0x434D4C4F; // "OLMC"
+
+// Written as is at the start of the file. Everything after this is the compressed payload.
+// Payload: Original BoundingBox, Target BoundingBox, Original Vertices, Target Vertices & Triangles.
+// Both mesh infos share the same triangles.
+struct FOpenLandBuildMeshDiskCacheHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	// These catch layout changes of the vertex & triangle structs without a version bump
+	uint32 VertexSize;
+	uint32 TriangleSize;
+	uint64 CacheKeyHash;
+	int32 SubDivisions;
+	int32 TextureWidth;
+	uint64 NumVertices;
+	uint64 NumTriangles;
+	int64 UncompressedSize;
+	int64 CompressedSize;
+};
+
+static uint64 HashCacheKey(const FString& CacheKey)
+{
+	const FTCHARToUTF8 KeyUTF8(*CacheKey);
+	return CityHash64(KeyUTF8.Get(), KeyUTF8.Length());
+}
+
+FString FOpenLandBuildMeshDiskCache::GetCacheDir()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("OpenLandMesh"), TEXT("BuildCache"));
+}
+
+FString FOpenLandBuildMeshDiskCache::GetCacheFilePath(const FString& CacheKey)
+{
+	// Cache keys can have any character. So, we use a hash as the file name.
+	return FPaths::Combine(GetCacheDir(), FString::Printf(TEXT("%016llx.olmc"), HashCacheKey(CacheKey)));
+}
+
+TArray<uint8> FOpenLandBuildMeshDiskCache::Encode(const FString& CacheKey, FOpenLandPolygonMeshBuildResultPtr Result)
+{
+	const FOpenLandMeshInfo* Original = Result->Original.Get();
+	const FOpenLandMeshInfo* Target = Result->Target.Get();
+
+	// FCompression works with int32 sizes. Very large meshes don't fit, so we don't save them.
+	const int64 VerticesSize = static_cast<int64>(Original->Vertices.Length()) * sizeof(FOpenLandMeshVertex);
+	const int64 TrianglesSize = static_cast<int64>(Original->Triangles.Length()) * sizeof(FOpenLandMeshTriangle);
+	const int64 UncompressedSize = static_cast<int64>(sizeof(FBox) * 2) + VerticesSize * 2 + TrianglesSize;
+	if (UncompressedSize > MAX_int32)
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("Mesh is too large for the disk cache: %lld bytes"), UncompressedSize)
+		return {};
+	}
+
+	const int32 PayloadSize = static_cast<int32>(UncompressedSize);
+	TArray<uint8> Payload;
+	Payload.SetNumUninitialized(PayloadSize);
+	uint8* Cursor = Payload.GetData();
+
+	FMemory::Memcpy(Cursor, &Original->BoundingBox, sizeof(FBox));
+	Cursor += sizeof(FBox);
+	FMemory::Memcpy(Cursor, &Target->BoundingBox, sizeof(FBox));
+	Cursor += sizeof(FBox);
+	FMemory::Memcpy(Cursor, Original->Vertices.GetData(), VerticesSize);
+	Cursor += VerticesSize;
+	FMemory::Memcpy(Cursor, Target->Vertices.GetData(), VerticesSize);
+	Cursor += VerticesSize;
+	FMemory::Memcpy(Cursor, Original->Triangles.GetData(), TrianglesSize);
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, PayloadSize);
+	if (CompressedSize <= 0 || static_cast<int64>(sizeof(FOpenLandBuildMeshDiskCacheHeader)) + CompressedSize > MAX_int32)
+	{
+		return {};
+	}
+
+	TArray<uint8> FileData;
+	FileData.SetNumUninitialized(sizeof(FOpenLandBuildMeshDiskCacheHeader) + CompressedSize);
+
+	if (!FCompression::CompressMemory(NAME_Zlib, FileData.GetData() + sizeof(FOpenLandBuildMeshDiskCacheHeader), CompressedSize, Payload.GetData(), PayloadSize))
+	{
+		return {};
+	}
+
+	FOpenLandBuildMeshDiskCacheHeader Header = {};
+	Header.Magic = OpenLandBuildMeshDiskCacheMagic;
+	Header.Version = Version;
+	Header.VertexSize = sizeof(FOpenLandMeshVertex);
+	Header.TriangleSize = sizeof(FOpenLandMeshTriangle);
+	Header.CacheKeyHash = HashCacheKey(CacheKey);
+	Header.SubDivisions = Result->SubDivisions;
+	Header.TextureWidth = Result->TextureWidth;
+	Header.NumVertices = Original->Vertices.Length();
+	Header.NumTriangles = Original->Triangles.Length();
+	Header.UncompressedSize = UncompressedSize;
+	Header.CompressedSize = CompressedSize;
+
+	FMemory::Memcpy(FileData.GetData(), &Header, sizeof(FOpenLandBuildMeshDiskCacheHeader));
+	FileData.SetNum(sizeof(FOpenLandBuildMeshDiskCacheHeader) + CompressedSize);
+
+	return FileData;
+}
+
+bool FOpenLandBuildMeshDiskCache::Decode(const FString& CacheKey, const uint8* FileData, int64 FileSize, FOpenLandPolygonMeshBuildResultPtr Result)
+{
+	if (FileSize < static_cast<int64>(sizeof(FOpenLandBuildMeshDiskCacheHeader)))
+	{
+		return false;
+	}
+
+	FOpenLandBuildMeshDiskCacheHeader Header;
+	FMemory::Memcpy(&Header, FileData, sizeof(FOpenLandBuildMeshDiskCacheHeader));
+
+	const int64 VerticesSize = Header.NumVertices * sizeof(FOpenLandMeshVertex);
+	const int64 TrianglesSize = Header.NumTriangles * sizeof(FOpenLandMeshTriangle);
+
+	const bool bValidHeader = Header.Magic == OpenLandBuildMeshDiskCacheMagic
+		&& Header.Version == Version
+		&& Header.VertexSize == sizeof(FOpenLandMeshVertex)
+		&& Header.TriangleSize == sizeof(FOpenLandMeshTriangle)
+		&& Header.CacheKeyHash == HashCacheKey(CacheKey)
+		&& Header.UncompressedSize == static_cast<int64>(sizeof(FBox) * 2) + VerticesSize * 2 + TrianglesSize
+		&& Header.CompressedSize == FileSize - static_cast<int64>(sizeof(FOpenLandBuildMeshDiskCacheHeader))
+		&& Header.UncompressedSize <= MAX_int32;
+
+	if (!bValidHeader)
+	{
+		return false;
+	}
+
+	TArray<uint8> Payload;
+	Payload.SetNumUninitialized(static_cast<int32>(Header.UncompressedSize));
+	if (!FCompression::UncompressMemory(NAME_Zlib, Payload.GetData(), Payload.Num(), FileData + sizeof(FOpenLandBuildMeshDiskCacheHeader), static_cast<int32>(Header.CompressedSize)))
+	{
+		return false;
+	}
+
+	Result->Original = FOpenLandMeshInfo::New();
+	Result->Target = FOpenLandMeshInfo::New();
+	Result->Original->Vertices.SetLength(Header.NumVertices);
+	Result->Target->Vertices.SetLength(Header.NumVertices);
+	Result->Original->Triangles.SetLength(Header.NumTriangles);
+	Result->Target->Triangles.SetLength(Header.NumTriangles);
+
+	const uint8* Cursor = Payload.GetData();
+	FMemory::Memcpy(&Result->Original->BoundingBox, Cursor, sizeof(FBox));
+	Cursor += sizeof(FBox);
+	FMemory::Memcpy(&Result->Target->BoundingBox, Cursor, sizeof(FBox));
+	Cursor += sizeof(FBox);
+	FMemory::Memcpy(Result->Original->Vertices.GetData(), Cursor, VerticesSize);
+	Cursor += VerticesSize;
+	FMemory::Memcpy(Result->Target->Vertices.GetData(), Cursor, VerticesSize);
+	Cursor += VerticesSize;
+	FMemory::Memcpy(Result->Original->Triangles.GetData(), Cursor, TrianglesSize);
+	FMemory::Memcpy(Result->Target->Triangles.GetData(), Cursor, TrianglesSize);
+
+	Result->SubDivisions = Header.SubDivisions;
+	Result->TextureWidth = Header.TextureWidth;
+
+	return true;
+}
+
+FOpenLandPolygonMeshBuildResultPtr FOpenLandBuildMeshDiskCache::Load(const FString& CacheKey, int32 ForcedTextureWidth)
+{
+	if (!bEnabled || CacheKey.IsEmpty())
+	{
+		return nullptr;
+	}
+
+	const double StartedAt = FPlatformTime::Seconds();
+	const FString FilePath = GetCacheFilePath(CacheKey);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	if (!PlatformFile.FileExists(*FilePath))
+	{
+		INC_DWORD_STAT(STAT_OpenLandMesh_BuildCacheDiskMisses);
+		return nullptr;
+	}
+
+	FOpenLandPolygonMeshBuildResultPtr Result = MakeShared<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe>();
+	bool bDecoded;
+
+	// Not every platform supports mapped files. Then we simply read the file.
+	TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*FilePath));
+	if (MappedFile.IsValid())
+	{
+		TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+		bDecoded = MappedRegion.IsValid() && Decode(CacheKey, MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize(), Result);
+	}
+	else
+	{
+		TArray<uint8> FileData;
+		bDecoded = FFileHelper::LoadFileToArray(FileData, *FilePath) && Decode(CacheKey, FileData.GetData(), FileData.Num(), Result);
+	}
+
+	if (!bDecoded)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Ignoring outdated or invalid build cache file: %s"), *FilePath);
+		INC_DWORD_STAT(STAT_OpenLandMesh_BuildCacheDiskMisses);
+		return nullptr;
+	}
+
+	Result->CacheKey = CacheKey;
+	FOpenLandPolygonMesh::BuildDataTextures(Result, ForcedTextureWidth);
+
+	const float LoadTimeMs = (FPlatformTime::Seconds() - StartedAt) * 1000.0;
+	INC_DWORD_STAT(STAT_OpenLandMesh_BuildCacheDiskHits);
+	SET_FLOAT_STAT(STAT_OpenLandMesh_BuildCacheDiskLoadTime, LoadTimeMs);
+	UE_LOG(LogTemp, Warning, TEXT("Loaded %s from the build cache in %.2fms"), *CacheKey, LoadTimeMs);
+
+	return Result;
+}
+
+void FOpenLandBuildMeshDiskCache::SaveAsync(FOpenLandPolygonMeshBuildResultPtr Result)
+{
+	if (!bEnabled || Result->CacheKey.IsEmpty() || Result->Target == nullptr)
+	{
+		return;
+	}
+
+	// Data textures are not safe to share with other threads. So, we only hand over what we store.
+	FOpenLandPolygonMeshBuildResultPtr ToSave = MakeShared<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe>();
+	ToSave->Original = Result->Original;
+	ToSave->Target = Result->Target;
+	ToSave->SubDivisions = Result->SubDivisions;
+	ToSave->TextureWidth = Result->TextureWidth;
+	ToSave->CacheKey = Result->CacheKey;
+
+	FOpenLandThreading::RunOnLane(EOpenLandThreadingLane::Prewarm, [ToSave]()
+	{
+		const TArray<uint8> FileData = Encode(ToSave->CacheKey, ToSave);
+		if (FileData.Num() == 0)
+		{
+			return;
+		}
+
+		// We write to a temporary file first. So, a crash in the middle never leaves a partial file behind.
+		const FString FilePath = GetCacheFilePath(ToSave->CacheKey);
+		const FString TempFilePath = FilePath + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(FileData, *TempFilePath) || !IFileManager::Get().Move(*FilePath, *TempFilePath))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Couldn't write the build cache file: %s"), *FilePath);
+			IFileManager::Get().Delete(*TempFilePath);
+		}
+	});
+}
+
+void FOpenLandBuildMeshDiskCache::Clear()
+{
+	IFileManager::Get().DeleteDirectory(*GetCacheDir(), false, true);
+}
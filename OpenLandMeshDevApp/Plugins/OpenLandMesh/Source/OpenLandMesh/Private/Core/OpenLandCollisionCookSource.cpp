@@ -0,0 +1,107 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "Core/OpenLandCollisionCookSource.h"
+#include "PhysicsEngine/BodySetup.h"
+
+TMap<uint64, TWeakObjectPtr<UOpenLandCollisionCookSource>> UOpenLandCollisionCookSource::Registry = {};
+
+void UOpenLandCollisionCookSource::RequestBodySetup(FOpenLandCollisionMeshPtr CollisionMesh, bool bUseComplexAsSimpleCollision,
+                                                    bool bUseAsyncCollisionCooking, std::function<void(UBodySetup*)> Callback)
+{
+	// Trace flag is part of the cooked body setup. So, it needs to be part of the key as well.
+	const uint64 CacheKey = CollisionMesh->ContentHash ^ (bUseComplexAsSimpleCollision ? 1 : 0);
+
+	const TWeakObjectPtr<UOpenLandCollisionCookSource>* Existing = Registry.Find(CacheKey);
+	if (Existing != nullptr && Existing->IsValid())
+	{
+		UOpenLandCollisionCookSource* CookSource = Existing->Get();
+		if (CookSource->bCooked)
+		{
+			Callback(CookSource->BodySetup);
+		}
+		else
+		{
+			CookSource->WaitingCallbacks.Push(Callback);
+		}
+		return;
+	}
+
+	// Components only keep the body setup. It keeps this object alive via the outer chain.
+	// Until then (while cooking), nobody references it. So, we keep it in the root set.
+	UOpenLandCollisionCookSource* CookSource = NewObject<UOpenLandCollisionCookSource>(GetTransientPackage());
+	CookSource->AddToRoot();
+	CookSource->CollisionMesh = CollisionMesh;
+	CookSource->CacheKey = CacheKey;
+	CookSource->WaitingCallbacks.Push(Callback);
+	Registry.Add(CacheKey, CookSource);
+
+	UBodySetup* NewBodySetup = NewObject<UBodySetup>(CookSource);
+	NewBodySetup->BodySetupGuid = FGuid::NewGuid();
+	NewBodySetup->bGenerateMirroredCollision = false;
+	NewBodySetup->bDoubleSidedGeometry = true;
+	NewBodySetup->bHasCookedCollisionData = true;
+	NewBodySetup->CollisionTraceFlag = bUseComplexAsSimpleCollision ? CTF_UseComplexAsSimple : CTF_UseDefault;
+	CookSource->BodySetup = NewBodySetup;
+
+	if (bUseAsyncCollisionCooking)
+	{
+		NewBodySetup->CreatePhysicsMeshesAsync(
+			FOnAsyncPhysicsCookFinished::CreateUObject(CookSource, &UOpenLandCollisionCookSource::FinishPhysicsAsyncCook));
+	}
+	else
+	{
+		NewBodySetup->CreatePhysicsMeshes();
+		CookSource->FinishPhysicsAsyncCook(true);
+	}
+}
+
+void UOpenLandCollisionCookSource::FinishPhysicsAsyncCook(bool bSuccess)
+{
+	RemoveFromRoot();
+	bCooked = bSuccess;
+	if (!bSuccess)
+	{
+		// Let the next request try again
+		Registry.Remove(CacheKey);
+	}
+
+	UBodySetup* Result = bSuccess ? BodySetup : nullptr;
+	TArray<std::function<void(UBodySetup*)>> Callbacks = MoveTemp(WaitingCallbacks);
+	for (const auto& Callback : Callbacks)
+	{
+		Callback(Result);
+	}
+}
+
+void UOpenLandCollisionCookSource::BeginDestroy()
+{
+	const TWeakObjectPtr<UOpenLandCollisionCookSource>* Existing = Registry.Find(CacheKey);
+	if (Existing != nullptr && (!Existing->IsValid() || Existing->Get() == this))
+	{
+		Registry.Remove(CacheKey);
+	}
+
+	CollisionMesh = nullptr;
+	Super::BeginDestroy();
+}
+
+bool UOpenLandCollisionCookSource::GetPhysicsTriMeshData(FTriMeshCollisionData* CollisionData, bool InUseAllTriData)
+{
+	if (!CollisionMesh.IsValid())
+	{
+		return false;
+	}
+
+	CollisionData->Vertices = CollisionMesh->Positions;
+	CollisionData->Indices = CollisionMesh->Indices;
+	CollisionData->bFlipNormals = true;
+	CollisionData->bDeformableMesh = false;
+	CollisionData->bFastCook = true;
+
+	return true;
+}
+
+bool UOpenLandCollisionCookSource::ContainsPhysicsTriMeshData(bool InUseAllTriData) const
+{
+	return CollisionMesh.IsValid() && CollisionMesh->NumTriangles() > 0;
+}
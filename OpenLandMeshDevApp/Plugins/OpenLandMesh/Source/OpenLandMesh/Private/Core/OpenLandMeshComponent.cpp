@@ -2,7 +2,22 @@
 
 #include "Core/OpenLandMeshComponent.h"
 #include "Core/OpenLandMeshSceneProxy.h"
+#include "Core/OpenLandCollisionCookSource.h"
 #include "PhysicsEngine/PhysicsSettings.h"
+#include "Compute/OpenLandThreading.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Collision Triangles (Last Cook)"), STAT_OpenLandMesh_CollisionTriangles, STATGROUP_OpenLandMesh);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Collision Cook Time (ms)"), STAT_OpenLandMesh_CollisionCookTime, STATGROUP_OpenLandMesh);
+
+UOpenLandMeshComponent::UOpenLandMeshComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	// We only tick when there are pending collision updates
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+}
 
 void UOpenLandMeshComponent::AddCollisionConvexMesh(TArray<FVector> ConvexVerts)
 {
@@ -48,64 +63,168 @@ void UOpenLandMeshComponent::SetCollisionConvexMeshes(const TArray<TArray<FVecto
 
 bool UOpenLandMeshComponent::GetPhysicsTriMeshData(FTriMeshCollisionData* CollisionData, bool InUseAllTriData)
 {
-	int32 VertexBase = 0; // Base vertex index for current section
+	CollisionData->bFlipNormals = true;
+	CollisionData->bFastCook = true;
+
+	if (CollisionMesh.IsValid())
+	{
+		// Collision mesh is already welded & positions only.
+		// There's only one section, so no need of material indices.
+		// Positions of the collision mesh are from the weld time. Animations may have moved them since.
+		if (CollisionPositions.Num() == CollisionMesh->Positions.Num())
+			CollisionData->Vertices = CollisionPositions;
+		else if (CollisionMesh->bDeformable)
+			CollisionMesh->UpdatePositions(CollisionData->Vertices);
+		else
+			CollisionData->Vertices = CollisionMesh->Positions;
+		CollisionData->Indices = CollisionMesh->Indices;
+		CollisionData->bDeformableMesh = CollisionMesh->bDeformable;
+
+		return true;
+	}
+
+	// Find all the collision sections first. Then we can allocate everything upfront.
+	TArray<TPair<int32, FOpenLandCollisionMeshPtr>> CollisionSections;
+	int32 NumVertices = 0;
+	int32 NumTriangles = 0;
+	for (int32 SectionIdx = 0; SectionIdx < MeshSections.Num(); SectionIdx++)
+	{
+		if (!SectionStates[SectionIdx].bEnableCollision)
+			continue;
+
+		const FOpenLandCollisionMeshPtr SectionCollisionMesh = GetSectionCollisionMesh(SectionIdx);
+		CollisionSections.Push({SectionIdx, SectionCollisionMesh});
+		NumVertices += SectionCollisionMesh->Positions.Num();
+		NumTriangles += SectionCollisionMesh->Indices.Num();
+	}
 
 	// See if we should copy UVs
-	bool bCopyUVs = UPhysicsSettings::Get()->bSupportUVFromHitResults;
+	// Since vertices are welded, UVs along seams come from one of the welded vertices.
+	const bool bCopyUVs = UPhysicsSettings::Get()->bSupportUVFromHitResults;
+	const bool bNeedMaterialIndices = CollisionSections.Num() > 1;
+	// These are the latest positions we gave to the trimesh (with hidden sections moved away)
+	const bool bUseCollisionPositions = CollisionPositions.Num() == NumVertices;
+
+	CollisionData->Vertices.Reserve(NumVertices);
+	CollisionData->Indices.Reserve(NumTriangles);
+	if (bNeedMaterialIndices)
+		CollisionData->MaterialIndices.Reserve(NumTriangles);
 	if (bCopyUVs)
+	{
 		CollisionData->UVs.AddZeroed(1); // only one UV channel
+		CollisionData->UVs[0].Reserve(NumVertices);
+	}
 
-	// For each section..
-	for (int32 SectionIdx = 0; SectionIdx < MeshSections.Num(); SectionIdx++)
+	for (const auto& Item : CollisionSections)
 	{
-		const FSimpleMeshInfoPtr Section = MeshSections[SectionIdx];
-		// Do we have collision enabled?
-		if (Section->bEnableCollision)
-		{
-			// Copy vert data
-			for (size_t VertIdx = 0; VertIdx < Section->Vertices.Length(); VertIdx++)
-			{
-				CollisionData->Vertices.Add(Section->Vertices.Get(VertIdx).Position);
+		const int32 SectionIdx = Item.Key;
+		const FOpenLandCollisionMeshPtr SectionCollisionMesh = Item.Value;
+		// Base vertex index for current section
+		const int32 VertexBase = CollisionData->Vertices.Num();
 
-				// Copy UV if desired
-				if (bCopyUVs)
-					CollisionData->UVs[0].Add(Section->Vertices.Get(VertIdx).UV0);
-			}
+		if (bUseCollisionPositions)
+		{
+			CollisionData->Vertices.Append(CollisionPositions.GetData() + VertexBase, SectionCollisionMesh->Positions.Num());
+		}
+		else
+		{
+			TArray<FVector> SectionPositions;
+			SectionCollisionMesh->UpdatePositions(SectionPositions);
+			CollisionData->Vertices.Append(SectionPositions);
+		}
+		if (bCopyUVs)
+		{
+			for (const int32 SourceVertex : SectionCollisionMesh->SourceVertices)
+				CollisionData->UVs[0].Add(SectionCollisionMesh->Source->Vertices.Get(SourceVertex).UV0);
+		}
 
-			// Copy triangle data
-			const int32 NumTriangles = Section->Triangles.Length();
-			for (int32 TriIdx = 0; TriIdx < NumTriangles; TriIdx++)
-			{
-				// Need to add base offset for indices
-				const FOpenLandMeshTriangle MeshTriangle = Section->Triangles.Get(TriIdx);
-				FTriIndices Triangle;
-				Triangle.v0 = MeshTriangle.T0 + VertexBase;
-				Triangle.v1 = MeshTriangle.T1 + VertexBase;
-				Triangle.v2 = MeshTriangle.T2 + VertexBase;
-				CollisionData->Indices.Add(Triangle);
-
-				// Also store material info
+		for (const FTriIndices& SectionTriangle : SectionCollisionMesh->Indices)
+		{
+			// Need to add base offset for indices
+			FTriIndices Triangle;
+			Triangle.v0 = SectionTriangle.v0 + VertexBase;
+			Triangle.v1 = SectionTriangle.v1 + VertexBase;
+			Triangle.v2 = SectionTriangle.v2 + VertexBase;
+			CollisionData->Indices.Add(Triangle);
+
+			// Also store material info
+			if (bNeedMaterialIndices)
 				CollisionData->MaterialIndices.Add(SectionIdx);
-			}
-
-			// Remember the base index that new verts will be added from in next section
-			VertexBase = CollisionData->Vertices.Num();
 		}
 	}
 
-	CollisionData->bFlipNormals = true;
 	CollisionData->bDeformableMesh = true;
-	CollisionData->bFastCook = true;
 
 	return true;
 }
 
+FOpenLandCollisionMeshPtr UOpenLandMeshComponent::GetSectionCollisionMesh(int32 SectionIndex)
+{
+	if (SectionCollisionMeshes.Num() < MeshSections.Num())
+		SectionCollisionMeshes.SetNum(MeshSections.Num());
+
+	const FSimpleMeshInfoPtr Section = MeshSections[SectionIndex];
+	FOpenLandCollisionMeshPtr& SectionCollisionMesh = SectionCollisionMeshes[SectionIndex];
+	if (!SectionCollisionMesh.IsValid() || SectionCollisionMesh->Source != Section)
+		SectionCollisionMesh = FOpenLandCollisionMesh::Build(Section, true);
+
+	return SectionCollisionMesh;
+}
+
+FOpenLandCollisionMeshPtr UOpenLandMeshComponent::FindSectionCollisionMesh(int32 SectionIndex)
+{
+	if (SectionCollisionMeshes.Num() < MeshSections.Num())
+		SectionCollisionMeshes.SetNum(MeshSections.Num());
+
+	const FSimpleMeshInfoPtr Section = MeshSections[SectionIndex];
+	const FOpenLandCollisionMeshPtr SectionCollisionMesh = SectionCollisionMeshes[SectionIndex];
+	if (SectionCollisionMesh.IsValid() && SectionCollisionMesh->Source == Section)
+		return SectionCollisionMesh;
+
+	if (SectionCollisionMeshBuilds.Contains(Section))
+		return nullptr;
+
+	// Welding needs to read all the vertices. Animations should wait until that's done.
+	SectionCollisionMeshBuilds.Add(Section);
+	Section->Lock();
+
+	TWeakObjectPtr<UOpenLandMeshComponent> WeakThis = this;
+	FOpenLandThreading::RunOnLane(EOpenLandThreadingLane::LODBuild, [WeakThis, Section, SectionIndex]()
+	{
+		const FOpenLandCollisionMeshPtr NewCollisionMesh = FOpenLandCollisionMesh::Build(Section, true);
+		FOpenLandThreading::RunOnGameThread([WeakThis, Section, SectionIndex, NewCollisionMesh]()
+		{
+			Section->UnLock();
+			if (!WeakThis.IsValid())
+				return;
+
+			WeakThis->SectionCollisionMeshBuilds.Remove(Section);
+			// Section got replaced or removed while we were welding
+			if (!WeakThis->MeshSections.IsValidIndex(SectionIndex) || WeakThis->MeshSections[SectionIndex] != Section)
+				return;
+
+			if (WeakThis->SectionCollisionMeshes.Num() < WeakThis->MeshSections.Num())
+				WeakThis->SectionCollisionMeshes.SetNum(WeakThis->MeshSections.Num());
+			WeakThis->SectionCollisionMeshes[SectionIndex] = NewCollisionMesh;
+
+			// Now we can pass its positions to the trimesh
+			WeakThis->CollisionDirtySections.Add(SectionIndex);
+			WeakThis->SetComponentTickEnabled(true);
+		});
+	});
+
+	return nullptr;
+}
+
 bool UOpenLandMeshComponent::ContainsPhysicsTriMeshData(bool InUseAllTriData) const
 {
+	if (CollisionMesh.IsValid())
+		return CollisionMesh->NumTriangles() > 0;
+
 	for (int32 Index = 0; Index < MeshSections.Num(); Index++)
 	{
 		const FSimpleMeshInfoPtr Section = MeshSections[Index];
-		if (Section->Triangles.Length() >= 0 && Section->bEnableCollision)
+		if (Section->Triangles.Length() >= 0 && SectionStates[Index].bEnableCollision)
 			return true;
 	}
 
@@ -120,6 +239,9 @@ FPrimitiveSceneProxy* UOpenLandMeshComponent::CreateSceneProxy()
 
 UBodySetup* UOpenLandMeshComponent::GetBodySetup()
 {
+	if (SharedBodySetup != nullptr)
+		return SharedBodySetup;
+
 	CreateSimpleMeshBodySetup();
 	return SimpleMeshBodySetup;
 }
@@ -135,14 +257,30 @@ UMaterialInterface* UOpenLandMeshComponent::GetMaterialFromCollisionFaceIndex(
 	UMaterialInterface* Result = nullptr;
 	SectionIndex = 0;
 
-	if (FaceIndex >= 0)
+	if (FaceIndex >= 0 && CollisionMesh.IsValid())
+	{
+		// There's only one collision section. Its material comes from the render section it's built from (if any).
+		const int32 SourceSectionIndex = MeshSections.IndexOfByKey(CollisionMesh->Source);
+		if (FaceIndex < CollisionMesh->NumTriangles() && SourceSectionIndex != INDEX_NONE)
+		{
+			Result = GetMaterial(SourceSectionIndex);
+			SectionIndex = SourceSectionIndex;
+		}
+	}
+	else if (FaceIndex >= 0)
 	{
 		// Look for element that corresponds to the supplied face
+		// Faces are in the same order as GetPhysicsTriMeshData, where welding drops collapsed triangles.
 		int32 TotalFaceCount = 0;
 		for (int32 SectionIdx = 0; SectionIdx < MeshSections.Num(); SectionIdx++)
 		{
+			if (!SectionStates[SectionIdx].bEnableCollision)
+				continue;
+
 			const FSimpleMeshInfoPtr Section = MeshSections[SectionIdx];
-			const int32 NumFaces = Section->Triangles.Length();
+			const bool bHasCollisionMesh = SectionCollisionMeshes.IsValidIndex(SectionIdx) && SectionCollisionMeshes[SectionIdx].IsValid()
+				&& SectionCollisionMeshes[SectionIdx]->Source == Section;
+			const int32 NumFaces = bHasCollisionMesh ? SectionCollisionMeshes[SectionIdx]->NumTriangles() : Section->Triangles.Length();
 			TotalFaceCount += NumFaces;
 
 			if (FaceIndex < TotalFaceCount)
@@ -171,7 +309,14 @@ void UOpenLandMeshComponent::PostLoad()
 		SimpleMeshBodySetup->SetFlags(RF_Public | RF_ArchetypeObject);
 }
 
-void UOpenLandMeshComponent::CreateMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo)
+void UOpenLandMeshComponent::OnUnregister()
+{
+	// Updates queued before the render state went away would hold their locks forever
+	ReleasePendingSectionUpdates();
+	Super::OnUnregister();
+}
+
+void UOpenLandMeshComponent::CreateMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo, bool bShareRenderData)
 {
 	UE_LOG(LogTemp, Warning, TEXT("CreateMeshSection"))
 	if (SectionIndex < MeshSections.Num())
@@ -181,6 +326,12 @@ void UOpenLandMeshComponent::CreateMeshSection(int32 SectionIndex, FSimpleMeshIn
 
 	MeshSections.SetNum(SectionIndex + 1);
 	MeshSections[SectionIndex] = MeshInfo;
+	SectionStates.SetNum(SectionIndex + 1);
+	SectionStates[SectionIndex] = {};
+	SectionStates[SectionIndex].bShareRenderData = bShareRenderData;
+	// Layout of the collision mesh changes. So, next collision update needs to gather everything.
+	CollisionPositions.Reset();
+	SectionLayoutId += 1;
 
 	// Here we are Freezing the mesh info
 	// Only the values of vertices can be changed
@@ -189,7 +340,7 @@ void UOpenLandMeshComponent::CreateMeshSection(int32 SectionIndex, FSimpleMeshIn
 	UpdateLocalBounds(); // Update overall bounds
 }
 
-void UOpenLandMeshComponent::ReplaceMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo)
+void UOpenLandMeshComponent::ReplaceMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo, bool bShareRenderData)
 {
 	UE_LOG(LogTemp, Warning, TEXT("ReplaceMeshSection"))
 	if (SectionIndex >= MeshSections.Num())
@@ -197,7 +348,16 @@ void UOpenLandMeshComponent::ReplaceMeshSection(int32 SectionIndex, FSimpleMeshI
 		checkf(false, TEXT("There is no existing mesh section with the index: %d"), SectionIndex);
 	}
 
+	// Pending updates hold a lock on the old mesh info
+	ReleasePendingSectionUpdates();
 	MeshSections[SectionIndex] = MeshInfo;
+	CollisionPositions.Reset();
+	SectionLayoutId += 1;
+
+	// Shared buffers cannot be updated with the new vertices. So, the proxy needs to be re-created.
+	if (SectionStates[SectionIndex].bShareRenderData || bShareRenderData)
+		MarkRenderStateDirty();
+	SectionStates[SectionIndex].bShareRenderData = bShareRenderData;
 
 	// Here we are Freezing the mesh info
 	// Only the values of vertices can be changed
@@ -208,69 +368,393 @@ void UOpenLandMeshComponent::ReplaceMeshSection(int32 SectionIndex, FSimpleMeshI
 
 void UOpenLandMeshComponent::UpdateCollisionMesh()
 {
-	TArray<FVector> CollisionPositions;
-
-	// We have one collision mesh for all sections, so need to build array of _all_ positions
+	struct FCollisionSectionItem
+	{
+		int32 Offset;
+		FOpenLandCollisionMeshPtr SectionCollisionMesh;
+		bool bSectionVisible;
+	};
+
+	// We have one collision mesh for all sections. Find where each section lives inside the positions array.
+	int32 NumPositions = 0;
+	TArray<FCollisionSectionItem> AllCollisionSections;
+	bool bCollisionMeshesReady = true;
 	for (int32 Index = 0; Index < MeshSections.Num(); Index++)
 	{
-		const FSimpleMeshInfoPtr CollisionSection = MeshSections[Index];
-		// If section has collision, copy it
-		if (CollisionSection->bEnableCollision )
+		const FOpenLandMeshComponentSectionState& SectionState = SectionStates[Index];
+		if (!SectionState.bEnableCollision)
+			continue;
+
+		const FOpenLandCollisionMeshPtr SectionCollisionMesh = FindSectionCollisionMesh(Index);
+		if (!SectionCollisionMesh.IsValid())
 		{
-			for (size_t VertIdx = 0; VertIdx < CollisionSection->Vertices.Length(); VertIdx++)
+			// We keep looking, so all the missing ones get built at once
+			bCollisionMeshesReady = false;
+			continue;
+		}
+
+		if (CollisionDirtySections.Contains(Index))
+			AllCollisionSections.Push({NumPositions, SectionCollisionMesh, SectionState.bSectionVisible});
+
+		NumPositions += SectionCollisionMesh->Positions.Num();
+	}
+
+	// Dirty sections are kept. We'll try again once the missing collision meshes are built.
+	if (!bCollisionMeshesReady)
+		return;
+
+	// Sections were added or removed after the last update. So, we need to rebuild everything.
+	if (NumPositions != CollisionPositions.Num())
+	{
+		AllCollisionSections.Reset();
+		int32 Offset = 0;
+		for (int32 Index = 0; Index < MeshSections.Num(); Index++)
+		{
+			const FOpenLandMeshComponentSectionState& SectionState = SectionStates[Index];
+			if (!SectionState.bEnableCollision)
+				continue;
+
+			const FOpenLandCollisionMeshPtr SectionCollisionMesh = GetSectionCollisionMesh(Index);
+			AllCollisionSections.Push({Offset, SectionCollisionMesh, SectionState.bSectionVisible});
+			Offset += SectionCollisionMesh->Positions.Num();
+		}
+	}
+
+	CollisionDirtySections.Reset();
+	if (AllCollisionSections.Num() == 0)
+		return;
+
+	// Make sure animations won't touch these vertices while we copy them
+	for (const FCollisionSectionItem& Item : AllCollisionSections)
+		Item.SectionCollisionMesh->Source->Lock();
+
+	bCollisionUpdateInProgress = true;
+	TArray<FVector> Positions = MoveTemp(CollisionPositions);
+	Positions.SetNumUninitialized(NumPositions);
+
+	TWeakObjectPtr<UOpenLandMeshComponent> WeakThis = this;
+	const int32 LayoutId = SectionLayoutId;
+	FOpenLandThreading::RunOnLane(EOpenLandThreadingLane::VisibleAnimation, [WeakThis, AllCollisionSections, Positions, LayoutId]() mutable
+	{
+		for (const FCollisionSectionItem& Item : AllCollisionSections)
+		{
+			const FOpenLandCollisionMeshPtr SectionCollisionMesh = Item.SectionCollisionMesh;
+			const FSimpleMeshInfoPtr CollisionSection = SectionCollisionMesh->Source;
+			for (int32 VertIdx = 0; VertIdx < SectionCollisionMesh->SourceVertices.Num(); VertIdx++)
 			{
-				if (CollisionSection->bSectionVisible)
+				if (Item.bSectionVisible)
 				{
-					CollisionPositions.Add(CollisionSection->Vertices.Get(VertIdx).Position);
+					Positions[Item.Offset + VertIdx] = CollisionSection->Vertices.Get(SectionCollisionMesh->SourceVertices[VertIdx]).Position;
 				} else
 				{
-					CollisionPositions.Add(FVector(0, 0, -9999999));
+					Positions[Item.Offset + VertIdx] = FVector(0, 0, -9999999);
 				}
 			}
 		}
-	}
+
+		FOpenLandThreading::RunOnGameThread([WeakThis, AllCollisionSections, Positions, LayoutId]() mutable
+		{
+			for (const FCollisionSectionItem& Item : AllCollisionSections)
+				Item.SectionCollisionMesh->Source->UnLock();
+
+			if (!WeakThis.IsValid())
+				return;
+
+			// Sections got replaced while we were gathering positions. These don't match the trimesh anymore.
+			if (WeakThis->SectionLayoutId != LayoutId)
+			{
+				WeakThis->bCollisionUpdateInProgress = false;
+				if (WeakThis->CollisionDirtySections.Num() > 0)
+					WeakThis->SetComponentTickEnabled(true);
+				return;
+			}
+
+			WeakThis->FinishCollisionMeshUpdate(MoveTemp(Positions));
+		});
+	});
+}
+
+void UOpenLandMeshComponent::UpdateCollisionMeshPositions()
+{
+	bCollisionMeshDirty = false;
+	CollisionDirtySections.Reset();
+
+	// Make sure animations won't touch these vertices while we copy them
+	const FOpenLandCollisionMeshPtr CurrentCollisionMesh = CollisionMesh;
+	CurrentCollisionMesh->Source->Lock();
+	bCollisionUpdateInProgress = true;
+
+	TWeakObjectPtr<UOpenLandMeshComponent> WeakThis = this;
+	FOpenLandThreading::RunOnLane(EOpenLandThreadingLane::VisibleAnimation, [WeakThis, CurrentCollisionMesh]()
+	{
+		TArray<FVector> Positions;
+		CurrentCollisionMesh->UpdatePositions(Positions);
+
+		FOpenLandThreading::RunOnGameThread([WeakThis, CurrentCollisionMesh, Positions]() mutable
+		{
+			CurrentCollisionMesh->Source->UnLock();
+			if (!WeakThis.IsValid())
+				return;
+
+			// Collision mesh got replaced while we were gathering positions
+			if (WeakThis->CollisionMesh != CurrentCollisionMesh)
+			{
+				WeakThis->bCollisionUpdateInProgress = false;
+				return;
+			}
+
+			WeakThis->FinishCollisionMeshUpdate(MoveTemp(Positions));
+		});
+	});
+}
+
+void UOpenLandMeshComponent::FinishCollisionMeshUpdate(TArray<FVector> NewCollisionPositions)
+{
+	bCollisionUpdateInProgress = false;
+	CollisionPositions = MoveTemp(NewCollisionPositions);
 
 	// Pass new positions to trimesh
 	BodyInstance.UpdateTriMeshVertices(CollisionPositions);
+
+	// Sections may got updated while we were gathering positions
+	if (CollisionDirtySections.Num() > 0 || bCollisionMeshDirty)
+		SetComponentTickEnabled(true);
+}
+
+void UOpenLandMeshComponent::SetCollisionMesh(FSimpleMeshInfoPtr CollisionSource, bool bDeformable, bool bUseAsyncCollisionCooking)
+{
+	// Any build started earlier is outdated now
+	CollisionMeshBuildId += 1;
+	const int32 BuildId = CollisionMeshBuildId;
+
+	if (CollisionMesh.IsValid() && CollisionMesh->Source == CollisionSource && CollisionMesh->bDeformable == bDeformable)
+	{
+		// We already have it. No need to cook again.
+		return;
+	}
+
+	if (CollisionSource == nullptr)
+	{
+		CollisionMesh = nullptr;
+		bCollisionMeshDirty = false;
+		CollisionPositions.Reset();
+		SetupCollisions(bUseAsyncCollisionCooking);
+		return;
+	}
+
+	// Welding needs to read all the vertices. Animations should wait until that's done.
+	CollisionSource->Lock();
+
+	TWeakObjectPtr<UOpenLandMeshComponent> WeakThis = this;
+	FOpenLandThreading::RunOnLane(EOpenLandThreadingLane::LODBuild, [WeakThis, CollisionSource, bDeformable, bUseAsyncCollisionCooking, BuildId]()
+	{
+		const FOpenLandCollisionMeshPtr NewCollisionMesh = FOpenLandCollisionMesh::Build(CollisionSource, bDeformable);
+		FOpenLandThreading::RunOnGameThread([WeakThis, CollisionSource, NewCollisionMesh, bUseAsyncCollisionCooking, BuildId]()
+		{
+			CollisionSource->UnLock();
+			if (!WeakThis.IsValid() || WeakThis->CollisionMeshBuildId != BuildId)
+				return;
+
+			WeakThis->CollisionMesh = NewCollisionMesh;
+			WeakThis->CollisionPositions = NewCollisionMesh->Positions;
+			WeakThis->bCollisionMeshDirty = false;
+			WeakThis->SetupCollisions(bUseAsyncCollisionCooking);
+		});
+	});
+}
+
+int32 UOpenLandMeshComponent::GetCollisionTriangleCount() const
+{
+	if (CollisionMesh.IsValid())
+		return CollisionMesh->NumTriangles();
+
+	int32 NumTriangles = 0;
+	for (int32 Index = 0; Index < MeshSections.Num(); Index++)
+	{
+		if (SectionStates[Index].bEnableCollision)
+			NumTriangles += MeshSections[Index]->Triangles.Length();
+	}
+
+	return NumTriangles;
+}
+
+void UOpenLandMeshComponent::ReportCollisionCook()
+{
+	LastCollisionCookTimeMs = (FPlatformTime::Seconds() - CollisionCookStartedAt) * 1000.0;
+	const int32 NumTriangles = GetCollisionTriangleCount();
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_CollisionTriangles, NumTriangles);
+	SET_FLOAT_STAT(STAT_OpenLandMesh_CollisionCookTime, LastCollisionCookTimeMs);
+	UE_LOG(LogTemp, Verbose, TEXT("Collision Cooked: Triangles: %d, Time: %f ms"), NumTriangles, LastCollisionCookTimeMs)
 }
 
 void UOpenLandMeshComponent::UpdateMeshSection(int32 SectionIndex, FOpenLandMeshComponentUpdateRange UpdateRange)
 {
-	// We cannot update not existing mesh section.
-	// TODO: May be we need to throw
-	if (SectionIndex >= MeshSections.Num())
+	const FOpenLandMeshComponentSectionUpdate Update = {SectionIndex, UpdateRange};
+	UpdateMeshSections(MakeArrayView(&Update, 1));
+}
+
+void UOpenLandMeshComponent::UpdateMeshSections(TArrayView<const FOpenLandMeshComponentSectionUpdate> Updates)
+{
+	for (const FOpenLandMeshComponentSectionUpdate& Update : Updates)
+	{
+		// We cannot update not existing mesh section.
+		// TODO: May be we need to throw
+		if (Update.SectionIndex >= MeshSections.Num())
+			continue;
+
+		const FSimpleMeshInfoPtr MeshSection = MeshSections[Update.SectionIndex];
+		FOpenLandMeshComponentSectionState& SectionState = SectionStates[Update.SectionIndex];
+
+		// Other components are rendering the shared buffers. So, this section needs its own buffers.
+		// The new proxy picks up the latest vertices, so there's nothing more to send.
+		if (SectionState.bShareRenderData)
+		{
+			SectionState.bShareRenderData = false;
+			MarkRenderStateDirty();
+		}
+
+		// If we have collision enabled on this section, update that too
+		if (CollisionMesh.IsValid())
+			bCollisionMeshDirty |= CollisionMesh->bDeformable && CollisionMesh->Source == MeshSection;
+		else if (SectionState.bEnableCollision)
+			CollisionDirtySections.Add(Update.SectionIndex);
+
+		// Without a render state, nothing sends the update & releases the lock.
+		// The proxy created later picks up the latest vertices anyway.
+		if (!IsRenderStateCreated())
+			continue;
+
+		FOpenLandMeshComponentUpdateRange* PendingRange = PendingSectionUpdates.Find(Update.SectionIndex);
+		if (PendingRange == nullptr)
+		{
+			// This will be unlocked by the render thread once the update is sent
+			MeshSection->Lock();
+			PendingSectionUpdates.Add(Update.SectionIndex, Update.UpdateRange);
+			continue;
+		}
+
+		// Both updates point to the same mesh info. So, we only need to cover both ranges.
+		if (PendingRange->Count == -1 || Update.UpdateRange.Count == -1)
+		{
+			*PendingRange = {FMath::Min(PendingRange->StartIndex, Update.UpdateRange.StartIndex), -1};
+		}
+		else
+		{
+			const int32 StartIndex = FMath::Min(PendingRange->StartIndex, Update.UpdateRange.StartIndex);
+			const int32 EndIndex = FMath::Max(PendingRange->StartIndex + PendingRange->Count, Update.UpdateRange.StartIndex + Update.UpdateRange.Count);
+			*PendingRange = {StartIndex, EndIndex - StartIndex};
+		}
+	}
+
+	if (PendingSectionUpdates.Num() > 0)
+		MarkRenderDynamicDataDirty();
+
+	if (CollisionDirtySections.Num() > 0 || bCollisionMeshDirty)
+		SetComponentTickEnabled(true);
+
+	// Animations move vertices. So, bounds may have changed.
+	UpdateLocalBoundsIfChanged();
+}
+
+void UOpenLandMeshComponent::SendRenderDynamicData_Concurrent()
+{
+	Super::SendRenderDynamicData_Concurrent();
+
+	if (PendingSectionUpdates.Num() == 0)
 		return;
 
-	//MeshSections[SectionIndex] = MeshInfo;
-	FSimpleMeshInfoPtr MeshSection = MeshSections[SectionIndex];
+	// If there's no proxy or it's pending recreation, the new proxy will pick up the latest vertices anyway
+	if (SceneProxy == nullptr || IsRenderStateDirty())
+	{
+		ReleasePendingSectionUpdates();
+		return;
+	}
 
-	// If we have collision enabled on this section, update that too
-	if (MeshSection->bEnableCollision)
+	struct FSectionUpdateData
 	{
-		UpdateCollisionMesh();
+		int32 SectionIndex;
+		FSimpleMeshInfoPtr MeshSection;
+		FOpenLandMeshComponentUpdateRange UpdateRange;
+	};
+
+	TArray<FSectionUpdateData> SectionUpdates;
+	SectionUpdates.Reserve(PendingSectionUpdates.Num());
+	for (const auto& Item : PendingSectionUpdates)
+	{
+		SectionUpdates.Push({Item.Key, MeshSections[Item.Key], Item.Value});
 	}
+	PendingSectionUpdates.Reset();
 
-	// If we have a valid proxy and it is not pending recreation
-	 if (SceneProxy && !IsRenderStateDirty())
-	 {
-	 	// Enqueue command to send to render thread
-	 	FOpenLandMeshSceneProxy* ProcMeshSceneProxy = static_cast<FOpenLandMeshSceneProxy*>(SceneProxy);
-	 	MeshSection->Lock();
-	 	ENQUEUE_RENDER_COMMAND(FProcMeshSectionUpdate)
-	 	([ProcMeshSceneProxy, SectionIndex, MeshSection, UpdateRange](FRHICommandListImmediate& RHICmdList)
-	 	{
-	 		ProcMeshSceneProxy->UpdateSection_RenderThread(SectionIndex, MeshSection, UpdateRange);
-	 		MeshSection->UnLock();
-	 	});
-	 }
+	// Enqueue a single command for all the sections
+	FOpenLandMeshSceneProxy* ProcMeshSceneProxy = static_cast<FOpenLandMeshSceneProxy*>(SceneProxy);
+	ENQUEUE_RENDER_COMMAND(FProcMeshSectionsUpdate)
+	([ProcMeshSceneProxy, SectionUpdates](FRHICommandListImmediate& RHICmdList)
+	{
+		for (const FSectionUpdateData& Update : SectionUpdates)
+		{
+			ProcMeshSceneProxy->UpdateSection_RenderThread(Update.SectionIndex, Update.MeshSection, Update.UpdateRange);
+			Update.MeshSection->UnLock();
+		}
+	});
+}
 
-	// UpdateLocalBounds(); // Update overall bounds
-	// MarkRenderTransformDirty(); // Need to send new bounds to render thread
+void UOpenLandMeshComponent::DestroyRenderState_Concurrent()
+{
+	Super::DestroyRenderState_Concurrent();
+
+	// The next proxy is created with the latest vertices. So, there's nothing to send.
+	ReleasePendingSectionUpdates();
+}
+
+void UOpenLandMeshComponent::ReleasePendingSectionUpdates()
+{
+	for (const auto& Item : PendingSectionUpdates)
+	{
+		if (MeshSections.IsValidIndex(Item.Key))
+			MeshSections[Item.Key]->UnLock();
+	}
+
+	PendingSectionUpdates.Reset();
+}
+
+void UOpenLandMeshComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	TimeSinceCollisionUpdate += DeltaTime;
+	if (bCollisionUpdateInProgress)
+		return;
+
+	if (CollisionDirtySections.Num() == 0 && !bCollisionMeshDirty)
+	{
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// Physics does not need to follow every animation frame
+	const float CollisionUpdateInterval = CollisionUpdateRate > 0 ? 1.0f / CollisionUpdateRate : 0.0f;
+	if (TimeSinceCollisionUpdate < CollisionUpdateInterval)
+		return;
+
+	TimeSinceCollisionUpdate = 0;
+	if (CollisionMesh.IsValid())
+		UpdateCollisionMeshPositions();
+	else
+		UpdateCollisionMesh();
 }
 
 void UOpenLandMeshComponent::RemoveAllSections()
 {
+	ReleasePendingSectionUpdates();
+	CollisionPositions.Reset();
+	CollisionDirtySections.Reset();
+	CollisionMesh = nullptr;
+	bCollisionMeshDirty = false;
+	CollisionMeshBuildId += 1;
+	SectionLayoutId += 1;
 	MeshSections.Empty();
+	SectionStates.Empty();
 	UpdateLocalBounds();
 }
 
@@ -279,13 +763,21 @@ int32 UOpenLandMeshComponent::NumMeshSections()
 	return MeshSections.Num();
 }
 
-void UOpenLandMeshComponent::UpdateMeshSectionVisibility(int32 SectionIndex)
+void UOpenLandMeshComponent::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
 {
 	if (SectionIndex < NumMeshSections())
 	{
 		
 		// Set game thread state
-		bool bVisibility = MeshSections[SectionIndex]->bSectionVisible;
+		SectionStates[SectionIndex].bSectionVisible = bNewVisibility;
+		bool bVisibility = bNewVisibility;
+
+		// Hidden sections are moved away in the collision mesh
+		if (SectionStates[SectionIndex].bEnableCollision)
+		{
+			CollisionDirtySections.Add(SectionIndex);
+			SetComponentTickEnabled(true);
+		}
 
 		// update the render thread
 		if (SceneProxy)
@@ -301,6 +793,32 @@ void UOpenLandMeshComponent::UpdateMeshSectionVisibility(int32 SectionIndex)
 	}
 }
 
+bool UOpenLandMeshComponent::IsMeshSectionVisible(int32 SectionIndex) const
+{
+	return SectionStates.IsValidIndex(SectionIndex) && SectionStates[SectionIndex].bSectionVisible;
+}
+
+void UOpenLandMeshComponent::SetMeshSectionCollisionEnabled(int32 SectionIndex, bool bNewEnableCollision)
+{
+	if (!SectionStates.IsValidIndex(SectionIndex) || SectionStates[SectionIndex].bEnableCollision == bNewEnableCollision)
+		return;
+
+	SectionStates[SectionIndex].bEnableCollision = bNewEnableCollision;
+	// Layout of the collision mesh changes. So, next collision update needs to gather everything.
+	CollisionPositions.Reset();
+	SectionLayoutId += 1;
+}
+
+bool UOpenLandMeshComponent::IsMeshSectionCollisionEnabled(int32 SectionIndex) const
+{
+	return SectionStates.IsValidIndex(SectionIndex) && SectionStates[SectionIndex].bEnableCollision;
+}
+
+bool UOpenLandMeshComponent::IsMeshSectionRenderDataShared(int32 SectionIndex) const
+{
+	return SectionStates.IsValidIndex(SectionIndex) && SectionStates[SectionIndex].bShareRenderData;
+}
+
 void UOpenLandMeshComponent::UpdateLocalBounds()
 {
 	FBox LocalBox(ForceInit);
@@ -317,6 +835,23 @@ void UOpenLandMeshComponent::UpdateLocalBounds()
 	MarkRenderTransformDirty();
 }
 
+void UOpenLandMeshComponent::UpdateLocalBoundsIfChanged()
+{
+	FBox LocalBox(ForceInit);
+	for (int32 Index = 0; Index < MeshSections.Num(); Index++)
+		LocalBox += MeshSections[Index]->BoundingBox;
+
+	const FBox CurrentBox = LocalBounds.GetBox();
+	if (!LocalBox.IsValid || (LocalBox.Min.Equals(CurrentBox.Min) && LocalBox.Max.Equals(CurrentBox.Max)))
+		return;
+
+	// This only updates the bounds & sends the new transform to the render thread.
+	// Render state is not re-created.
+	LocalBounds = FBoxSphereBounds(LocalBox);
+	UpdateBounds();
+	MarkRenderTransformDirty();
+}
+
 FBoxSphereBounds UOpenLandMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
 {
 	FBoxSphereBounds Ret(LocalBounds.TransformBy(LocalToWorld));
@@ -349,6 +884,13 @@ void UOpenLandMeshComponent::CreateSimpleMeshBodySetup()
 
 void UOpenLandMeshComponent::SetupCollisions(bool bUseAsyncCollisionCooking)
 {
+	// Any shared body setup we asked for earlier is outdated now
+	SharedBodySetupRequestId += 1;
+	if (SetupSharedCollisions(bUseAsyncCollisionCooking))
+		return;
+
+	SharedBodySetup = nullptr;
+
 	UWorld* World = GetWorld();
 
 	if (bUseAsyncCollisionCooking)
@@ -366,6 +908,7 @@ void UOpenLandMeshComponent::SetupCollisions(bool bUseAsyncCollisionCooking)
 	}
 
 	UBodySetup* UseBodySetup = bUseAsyncCollisionCooking ? AsyncBodySetupQueue.Last() : SimpleMeshBodySetup;
+	CollisionCookStartedAt = FPlatformTime::Seconds();
 
 	// Fill in simple collision convex elements
 	UseBodySetup->AggGeom.ConvexElems = CollisionConvexElems;
@@ -386,9 +929,33 @@ void UOpenLandMeshComponent::SetupCollisions(bool bUseAsyncCollisionCooking)
 		UseBodySetup->InvalidatePhysicsData();
 		UseBodySetup->CreatePhysicsMeshes();
 		RecreatePhysicsState();
+		ReportCollisionCook();
 	}
 }
 
+bool UOpenLandMeshComponent::SetupSharedCollisions(bool bUseAsyncCollisionCooking)
+{
+	// Only static collision meshes can be shared. Deformable ones get updated per component.
+	// Simple convex collisions are per component too.
+	if (!CollisionMesh.IsValid() || CollisionMesh->bDeformable || CollisionConvexElems.Num() > 0)
+		return false;
+
+	CollisionCookStartedAt = FPlatformTime::Seconds();
+	const int32 RequestId = SharedBodySetupRequestId;
+	TWeakObjectPtr<UOpenLandMeshComponent> WeakThis = this;
+	UOpenLandCollisionCookSource::RequestBodySetup(CollisionMesh, bUseComplexAsSimpleCollision, bUseAsyncCollisionCooking, [WeakThis, RequestId](UBodySetup* BodySetup)
+	{
+		if (!WeakThis.IsValid() || WeakThis->SharedBodySetupRequestId != RequestId || BodySetup == nullptr)
+			return;
+
+		WeakThis->SharedBodySetup = BodySetup;
+		WeakThis->RecreatePhysicsState();
+		WeakThis->ReportCollisionCook();
+	});
+
+	return true;
+}
+
 void UOpenLandMeshComponent::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBodySetup)
 {
 	TArray<UBodySetup*> NewQueue;
@@ -402,6 +969,7 @@ void UOpenLandMeshComponent::FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* F
 			//The new body was found in the array meaning it's newer so use it
 			SimpleMeshBodySetup = FinishedBodySetup;
 			RecreatePhysicsState();
+			ReportCollisionCook();
 
 			//remove any async body setups that were requested before this one
 			for (int32 AsyncIdx = FoundIdx + 1; AsyncIdx < AsyncBodySetupQueue.Num(); ++AsyncIdx)
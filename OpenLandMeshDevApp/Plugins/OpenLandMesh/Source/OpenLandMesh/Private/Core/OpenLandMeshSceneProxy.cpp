@@ -3,6 +3,23 @@
 #include "Core/OpenLandMeshSceneProxy.h"
 #include "Math/Color.h"
 #include "Engine.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shared Section Buffers"), STAT_OpenLandMesh_SharedSectionBuffers, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shared Section Buffer Hits"), STAT_OpenLandMesh_SharedSectionBufferHits, STATGROUP_OpenLandMesh);
+
+struct FOpenLandMeshSharedRenderDataItem
+{
+	// We hold the mesh info weakly. So, a new mesh info allocated at the same address won't match.
+	TWeakPtr<FOpenLandMeshInfo, ESPMode::ThreadSafe> MeshInfo;
+	TWeakPtr<FOpenLandMeshSectionRenderData, ESPMode::ThreadSafe> RenderData;
+	ERHIFeatureLevel::Type FeatureLevel;
+};
+
+// Scene proxies can be created outside of the game thread. So, this is guarded by a lock.
+static FCriticalSection SharedRenderDataLock;
+static TMap<const FOpenLandMeshInfo*, FOpenLandMeshSharedRenderDataItem> SharedRenderData;
+static int32 SharedRenderDataLookups = 0;
 
 static void ConvertProcMeshToDynMeshVertex(FDynamicMeshVertex& Vert, const FOpenLandMeshVertex& ProcVert)
 {
@@ -17,6 +34,109 @@ static void ConvertProcMeshToDynMeshVertex(FDynamicMeshVertex& Vert, const FOpen
 	Vert.TangentZ.Vector.W = ProcVert.Tangent.bFlipTangentY ? -127 : 127;
 }
 
+FOpenLandMeshSectionRenderData::FOpenLandMeshSectionRenderData(ERHIFeatureLevel::Type InFeatureLevel, const FOpenLandMeshInfo* MeshInfo)
+	: VertexFactory(InFeatureLevel, "FOpenLandMeshProxySection")
+{
+	// Copy data from vertex buffer
+	const int32 NumVerts = MeshInfo->Vertices.Length();
+
+	// Allocate verts
+
+	TArray<FDynamicMeshVertex> Vertices;
+	Vertices.SetNumUninitialized(NumVerts);
+	// Copy verts
+	for (int VertIdx = 0; VertIdx < NumVerts; VertIdx++)
+	{
+		const FOpenLandMeshVertex& ProcVert = MeshInfo->Vertices.Get(VertIdx);
+		FDynamicMeshVertex& Vert = Vertices[VertIdx];
+		ConvertProcMeshToDynMeshVertex(Vert, ProcVert);
+	}
+
+	// Copy index buffer
+	const int32 NumIndices = MeshInfo->Triangles.Length() * 3;
+	IndexBuffer.Indices.SetNum(NumIndices);
+	for (size_t Index = 0; Index < MeshInfo->Triangles.Length(); Index++)
+	{
+		const FOpenLandMeshTriangle Triangle = MeshInfo->Triangles.Get(Index);
+		IndexBuffer.Indices[Index * 3 + 0] = Triangle.T0;
+		IndexBuffer.Indices[Index * 3 + 1] = Triangle.T1;
+		IndexBuffer.Indices[Index * 3 + 2] = Triangle.T2;
+	}
+
+	VertexBuffers.InitFromDynamicVertex(&VertexFactory, Vertices, 4);
+
+	// Enqueue initialization of render resource
+	BeginInitResource(&VertexBuffers.PositionVertexBuffer);
+	BeginInitResource(&VertexBuffers.StaticMeshVertexBuffer);
+	BeginInitResource(&VertexBuffers.ColorVertexBuffer);
+	BeginInitResource(&IndexBuffer);
+	BeginInitResource(&VertexFactory);
+}
+
+void FOpenLandMeshSectionRenderData::ReleaseResources()
+{
+	check(IsInRenderingThread());
+	VertexBuffers.PositionVertexBuffer.ReleaseResource();
+	VertexBuffers.StaticMeshVertexBuffer.ReleaseResource();
+	VertexBuffers.ColorVertexBuffer.ReleaseResource();
+	IndexBuffer.ReleaseResource();
+	VertexFactory.ReleaseResource();
+}
+
+FOpenLandMeshSectionRenderDataPtr FOpenLandMeshSectionRenderData::Create(ERHIFeatureLevel::Type InFeatureLevel, const FOpenLandMeshInfo* MeshInfo)
+{
+	// Usually the last reference goes away with the scene proxy in the render thread.
+	// But a lookup in the game thread could hold it for a moment. Then we release it via a render command.
+	return MakeShareable(new FOpenLandMeshSectionRenderData(InFeatureLevel, MeshInfo), [](FOpenLandMeshSectionRenderData* RenderData)
+	{
+		if (IsInRenderingThread())
+		{
+			RenderData->ReleaseResources();
+			delete RenderData;
+			return;
+		}
+
+		ENQUEUE_RENDER_COMMAND(FOpenLandMeshReleaseSectionRenderData)([RenderData](FRHICommandListImmediate& RHICmdList)
+		{
+			RenderData->ReleaseResources();
+			delete RenderData;
+		});
+	});
+}
+
+FOpenLandMeshSectionRenderDataPtr FOpenLandMeshSectionRenderData::FindOrCreateShared(ERHIFeatureLevel::Type InFeatureLevel, FSimpleMeshInfoPtr MeshInfo)
+{
+	FScopeLock Lock(&SharedRenderDataLock);
+
+	FOpenLandMeshSharedRenderDataItem* Item = SharedRenderData.Find(MeshInfo.Get());
+	if (Item != nullptr && Item->FeatureLevel == InFeatureLevel && Item->MeshInfo.Pin() == MeshInfo)
+	{
+		FOpenLandMeshSectionRenderDataPtr RenderData = Item->RenderData.Pin();
+		if (RenderData.IsValid())
+		{
+			INC_DWORD_STAT(STAT_OpenLandMesh_SharedSectionBufferHits);
+			return RenderData;
+		}
+	}
+
+	// Get rid of entries whose render data is gone, once in a while
+	SharedRenderDataLookups += 1;
+	if (SharedRenderDataLookups % 256 == 0)
+	{
+		for (auto It = SharedRenderData.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().RenderData.IsValid())
+				It.RemoveCurrent();
+		}
+	}
+
+	FOpenLandMeshSectionRenderDataPtr RenderData = Create(InFeatureLevel, MeshInfo.Get());
+	SharedRenderData.Add(MeshInfo.Get(), {MeshInfo, RenderData, InFeatureLevel});
+	SET_DWORD_STAT(STAT_OpenLandMesh_SharedSectionBuffers, SharedRenderData.Num());
+
+	return RenderData;
+}
+
 FOpenLandMeshSceneProxy::FOpenLandMeshSceneProxy(UOpenLandMeshComponent* Component)
 	: FPrimitiveSceneProxy(Component)
 	  , BodySetup(Component->GetBodySetup())
@@ -31,49 +151,20 @@ FOpenLandMeshSceneProxy::FOpenLandMeshSceneProxy(UOpenLandMeshComponent* Compone
 		FSimpleMeshInfoPtr SrcSection = Component->MeshSections[SectionId];
 		if (SrcSection->Triangles.Length() > 0 && SrcSection->Vertices.Length() > 0)
 		{
-			FOpenLandMeshProxySection* NewSection = new FOpenLandMeshProxySection(GetScene().GetFeatureLevel());
+			FOpenLandMeshProxySection* NewSection = new FOpenLandMeshProxySection();
 
-			// Copy data from vertex buffer
-			const int32 NumVerts = SrcSection->Vertices.Length();
-
-			// Allocate verts
-
-			TArray<FDynamicMeshVertex> Vertices;
-			Vertices.SetNumUninitialized(NumVerts);
-			// Copy verts
-			for (int VertIdx = 0; VertIdx < NumVerts; VertIdx++)
-			{
-				const FOpenLandMeshVertex& ProcVert = SrcSection->Vertices.Get(VertIdx);
-				FDynamicMeshVertex& Vert = Vertices[VertIdx];
-				ConvertProcMeshToDynMeshVertex(Vert, ProcVert);
-			}
-
-			// Copy index buffer
-			const int32 NumIndices = SrcSection->Triangles.Length() * 3;
-			NewSection->IndexBuffer.Indices.SetNum(NumIndices);
-			for (size_t Index = 0; Index < SrcSection->Triangles.Length(); Index++)
-			{
-				const FOpenLandMeshTriangle Triangle = SrcSection->Triangles.Get(Index);
-				NewSection->IndexBuffer.Indices[Index * 3 + 0] = Triangle.T0;
-				NewSection->IndexBuffer.Indices[Index * 3 + 1] = Triangle.T1;
-				NewSection->IndexBuffer.Indices[Index * 3 + 2] = Triangle.T2;
-			}
-
-			NewSection->VertexBuffers.InitFromDynamicVertex(&NewSection->VertexFactory, Vertices, 4);
-
-			// Enqueue initialization of render resource
-			BeginInitResource(&NewSection->VertexBuffers.PositionVertexBuffer);
-			BeginInitResource(&NewSection->VertexBuffers.StaticMeshVertexBuffer);
-			BeginInitResource(&NewSection->VertexBuffers.ColorVertexBuffer);
-			BeginInitResource(&NewSection->IndexBuffer);
-			BeginInitResource(&NewSection->VertexFactory);
+			// Immutable sections reuse the buffers of other components rendering the same mesh info
+			NewSection->bSharedRenderData = Component->IsMeshSectionRenderDataShared(SectionId);
+			NewSection->RenderData = NewSection->bSharedRenderData
+				                         ? FOpenLandMeshSectionRenderData::FindOrCreateShared(GetScene().GetFeatureLevel(), SrcSection)
+				                         : FOpenLandMeshSectionRenderData::Create(GetScene().GetFeatureLevel(), SrcSection.Get());
 
 			NewSection->Material = Component->GetMaterial(SectionId);
 			if (NewSection->Material == nullptr)
 				NewSection->Material = UMaterial::GetDefaultMaterial(MD_Surface);
 
 			// Copy visibility info
-			NewSection->bSectionVisible = SrcSection->bSectionVisible;
+			NewSection->bSectionVisible = Component->IsMeshSectionVisible(SectionId);
 
 			// Save ref to new section
 			ProxySections[SectionId] = NewSection;
@@ -86,12 +177,7 @@ FOpenLandMeshSceneProxy::~FOpenLandMeshSceneProxy()
 	for (auto ProxySection : ProxySections)
 		if (ProxySection != nullptr)
 		{
-			ProxySection->VertexBuffers.PositionVertexBuffer.ReleaseResource();
-			ProxySection->VertexBuffers.StaticMeshVertexBuffer.ReleaseResource();
-			ProxySection->VertexBuffers.ColorVertexBuffer.ReleaseResource();
-			ProxySection->IndexBuffer.ReleaseResource();
-			ProxySection->VertexFactory.ReleaseResource();
-
+			// Render resources are released with the last reference to the render data
 			delete ProxySection;
 		}
 }
@@ -99,7 +185,7 @@ FOpenLandMeshSceneProxy::~FOpenLandMeshSceneProxy()
 void FOpenLandMeshSceneProxy::SetSectionVisibility_RenderThread(int32 SectionIndex, bool bNewVisibility)
 {
 	check(IsInRenderingThread());
-	if (SectionIndex < ProxySections.Num())
+	if (SectionIndex < ProxySections.Num() && ProxySections[SectionIndex] != nullptr)
 		ProxySections[SectionIndex]->bSectionVisible = bNewVisibility;
 }
 
@@ -113,7 +199,12 @@ void FOpenLandMeshSceneProxy::UpdateSection_RenderThread(int32 SectionIndex, FSi
 		if (SectionIndex < ProxySections.Num() &&
 			ProxySections[SectionIndex] != nullptr)
 		{
-			FOpenLandMeshProxySection* Section = ProxySections[SectionIndex];
+			FOpenLandMeshProxySection* ProxySection = ProxySections[SectionIndex];
+			// Other proxies are rendering these buffers. The component re-creates the proxy before updating such sections.
+			if (!ensure(!ProxySection->bSharedRenderData))
+				return;
+
+			FOpenLandMeshSectionRenderData* Section = ProxySection->RenderData.Get();
 
 			const int32 NumVerts = SectionData->Vertices.Length();
 			const int32 EndIndex = UpdateRange.StartIndex + (UpdateRange.Count == -1? NumVerts : UpdateRange.Count);
@@ -207,9 +298,9 @@ void FOpenLandMeshSceneProxy::GetDynamicMeshElements(const TArray<const FSceneVi
 					// Draw the mesh.
 					FMeshBatch& Mesh = Collector.AllocateMesh();
 					FMeshBatchElement& BatchElement = Mesh.Elements[0];
-					BatchElement.IndexBuffer = &ProxySection->IndexBuffer;
+					BatchElement.IndexBuffer = &ProxySection->RenderData->IndexBuffer;
 					Mesh.bWireframe = bWireframe;
-					Mesh.VertexFactory = &ProxySection->VertexFactory;
+					Mesh.VertexFactory = &ProxySection->RenderData->VertexFactory;
 					Mesh.MaterialRenderProxy = MaterialProxy;
 
 					bool bHasPrecomputedVolumetricLightmap;
@@ -228,9 +319,9 @@ void FOpenLandMeshSceneProxy::GetDynamicMeshElements(const TArray<const FSceneVi
 					BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
 
 					BatchElement.FirstIndex = 0;
-					BatchElement.NumPrimitives = ProxySection->IndexBuffer.Indices.Num() / 3;
+					BatchElement.NumPrimitives = ProxySection->RenderData->IndexBuffer.Indices.Num() / 3;
 					BatchElement.MinVertexIndex = 0;
-					BatchElement.MaxVertexIndex = ProxySection->VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+					BatchElement.MaxVertexIndex = ProxySection->RenderData->VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
 					Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
 					Mesh.Type = PT_TriangleList;
 					Mesh.DepthPriorityGroup = SDPG_World;
@@ -3,9 +3,9 @@
 #include "Core/OpenLandPolygonMesh.h"
 #include "Utils/TrackTime.h"
 #include "Compute/OpenLandThreading.h"
-
-bool FOpenLandPolygonMesh::bIsDeleteSchedulerRunning = false;
-TArray<FOpenLandPolygonMesh*> FOpenLandPolygonMesh::PolygonMeshesToDelete = {};
+#include "Hash/CityHash.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialInstance.h"
 
 void FOpenLandPolygonMesh::ApplyNormalSmoothing(FOpenLandMeshInfo* MeshInfo, float CuspAngle)
 {
@@ -137,7 +137,7 @@ FOpenLandPolygonMeshBuildResultPtr FOpenLandPolygonMesh::BuildMesh(UObject* Worl
 
 	FOpenLandMeshInfo Source = SubDivide(TransformedMeshInfo, Options.SubDivisions);
 
-	FOpenLandPolygonMeshBuildResultPtr Result = MakeShared<FOpenLandPolygonMeshBuildResult>();
+	FOpenLandPolygonMeshBuildResultPtr Result = MakeShared<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe>();
 
 	Result->Original = Source.Clone();
 	Result->Target = Source.Clone();
@@ -160,7 +160,7 @@ FOpenLandPolygonMeshBuildResultPtr FOpenLandPolygonMesh::BuildMesh(UObject* Worl
 
 	// Build Faces
 	auto TrackCpuVertexModifiers = TrackTime("CpuVertexModifiers");
-	ApplyVertexModifiers(VertexModifier, Intermediate.Get(), Result->Target.Get(), 0, Result->Original->Triangles.Length(), 0);
+	Result->Target->BoundingBox = ApplyVertexModifiers(VertexModifier, Intermediate.Get(), Result->Target.Get(), 0, Result->Original->Triangles.Length(), 0);
 	TrackCpuVertexModifiers.Finish();
 
 	if (Options.CuspAngle > 0.0)
@@ -176,8 +176,7 @@ FOpenLandPolygonMeshBuildResultPtr FOpenLandPolygonMesh::BuildMesh(UObject* Worl
 void FOpenLandPolygonMesh::BuildMeshAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildOptions Options,
                                           std::function<void(FOpenLandPolygonMeshBuildResultPtr)> Callback)
 {
-	std::function<void(FOpenLandPolygonMeshBuildResultPtr)> HandleCallback = [this, WorldContext, Callback, Options
-		](FOpenLandPolygonMeshBuildResultPtr Result)
+	std::function<void(FOpenLandPolygonMeshBuildResultPtr)> HandleCallback = [Callback](FOpenLandPolygonMeshBuildResultPtr Result)
 	{
 		// Here we don't do any modifications
 		// That needs to taken care in somewhere else
@@ -185,13 +184,13 @@ void FOpenLandPolygonMesh::BuildMeshAsync(UObject* WorldContext, FOpenLandPolygo
 	};
 
 	// Apply Source transformation
-	FOpenLandThreading::RunOnAnyBackgroundThread([this, Options, HandleCallback]()
+	FOpenLandThreading::RunOnLane(Options.Lane, [Self = AsShared(), Options, HandleCallback]()
 	{
-		FOpenLandMeshInfo TransformedMeshInfo = SourceMeshInfo;
+		FOpenLandMeshInfo TransformedMeshInfo = Self->SourceMeshInfo;
 		for (size_t Index = 0; Index < TransformedMeshInfo.Vertices.Length(); Index++)
 		{
 			FOpenLandMeshVertex& Vertex = TransformedMeshInfo.Vertices.GetRef(Index);
-			Vertex.Position = SourceTransformer.TransformPosition(Vertex.Position);
+			Vertex.Position = Self->SourceTransformer.TransformPosition(Vertex.Position);
 		}
 
 		// Build faces & tangents for the TransformedMeshInfo
@@ -213,7 +212,7 @@ void FOpenLandPolygonMesh::BuildMeshAsync(UObject* WorldContext, FOpenLandPolygo
 	    }
 
 		FOpenLandMeshInfo Source = SubDivide(TransformedMeshInfo, Options.SubDivisions);
-		FOpenLandPolygonMeshBuildResultPtr Result = MakeShared<FOpenLandPolygonMeshBuildResult>();
+		FOpenLandPolygonMeshBuildResultPtr Result = MakeShared<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe>();
 		
 		Result->Original = Source.Clone();
 		// We cannot create Target vertices here.
@@ -231,9 +230,11 @@ void FOpenLandPolygonMesh::BuildMeshAsync(UObject* WorldContext, FOpenLandPolygo
 	});
 }
 
-void FOpenLandPolygonMesh::ApplyVertexModifiers(function<FVertexModifierResult(FVertexModifierPayload)> VertexModifier, FOpenLandMeshInfo* Original, FOpenLandMeshInfo* Target, int RangeStart,
+FBox FOpenLandPolygonMesh::ApplyVertexModifiers(function<FVertexModifierResult(FVertexModifierPayload)> VertexModifier, FOpenLandMeshInfo* Original, FOpenLandMeshInfo* Target, int RangeStart,
                                                 int RangeEnd, float RealTimeSeconds)
 {
+	FBox BoundingBox(ForceInit);
+
 	for (int TriIndex = RangeStart; TriIndex < RangeEnd; TriIndex++)
 	{
 		const FOpenLandMeshTriangle OTriangle = Original->Triangles.Get(TriIndex);
@@ -260,10 +261,12 @@ void FOpenLandPolygonMesh::ApplyVertexModifiers(function<FVertexModifierResult(F
 
 
 		// Build Bounding Box
-		Target->BoundingBox += T0.Position;
-		Target->BoundingBox += T1.Position;
-		Target->BoundingBox += T2.Position;
+		BoundingBox += T0.Position;
+		BoundingBox += T1.Position;
+		BoundingBox += T2.Position;
 	}
+
+	return BoundingBox;
 }
 
 void FOpenLandPolygonMesh::BuildDataTextures(FOpenLandPolygonMeshBuildResultPtr Result, int32 ForcedTextureWidth)
@@ -276,14 +279,14 @@ void FOpenLandPolygonMesh::BuildDataTextures(FOpenLandPolygonMeshBuildResultPtr
 	
 	Result->TextureWidth = ForcedTextureWidth > 0 ? ForcedTextureWidth : FMath::CeilToInt(FMath::Sqrt(VertexCount));
 	
-	TSharedPtr<FDataTexture> DataTexturePositionX = MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTexturePositionY = MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTexturePositionZ = MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTextureUV0X= MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTextureUV0Y= MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTextureFaceNormalX = MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTextureFaceNormalY = MakeShared<FDataTexture>(Result->TextureWidth);
-	TSharedPtr<FDataTexture> DataTextureFaceNormalZ = MakeShared<FDataTexture>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTexturePositionX = MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTexturePositionY = MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTexturePositionZ = MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTextureUV0X= MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTextureUV0Y= MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTextureFaceNormalX = MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTextureFaceNormalY = MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTextureFaceNormalZ = MakeShared<FDataTexture, ESPMode::ThreadSafe>(Result->TextureWidth);
 
 	for(int32 Index=0; Index<VertexCount; Index++)
 	{
@@ -341,12 +344,11 @@ void FOpenLandPolygonMesh::ApplyGpuVertexModifers(UObject* WorldContext, FOpenLa
 	TArray<FGpuComputeVertexOutput> ModifiedPositions;
 	ModifiedPositions.SetNumUninitialized(MeshBuildResult->Original->Vertices.Length());
 
-	for (auto Param : AdditionalMaterialParameters)
-	{
-		GpuVertexModifier.Parameters.Push(Param);
-	}
+	// Per frame parameters like Time go into a copy, so the registered modifier (and its content hash) stays the same
+	FComputeMaterial ComputeMaterial = GpuVertexModifier;
+	ComputeMaterial.Parameters.Append(AdditionalMaterialParameters);
 	
-	GpuComputeEngine->Compute(WorldContext, MeshBuildResult->DataTextures, GpuVertexModifier);
+	GpuComputeEngine->Compute(WorldContext, MeshBuildResult->DataTextures, ComputeMaterial);
 	GpuComputeEngine->ReadData(ModifiedPositions, 0, MeshBuildResult->TextureWidth);
 
 	for (size_t Index = 0; Index < MeshBuildResult->Original->Vertices.Length(); Index++)
@@ -367,11 +369,6 @@ void FOpenLandPolygonMesh::ApplyGpuVertexModifers(UObject* WorldContext, FOpenLa
 void FOpenLandPolygonMesh::ApplyGpuVertexModifersAsync(UObject* WorldContext,
 	FOpenLandPolygonMeshBuildResultPtr MeshBuildResult, TArray<FComputeMaterialParameter> AdditionalMaterialParameters)
 {
-	for (auto Param : AdditionalMaterialParameters)
-	{
-		GpuVertexModifier.Parameters.Push(Param);
-	}
-	
 	int32 RowsPerFrame;
 	
 	const float DesiredFrameTime = 1000 / ModifyInfo.Options.DesiredFrameRate;
@@ -399,7 +396,9 @@ void FOpenLandPolygonMesh::ApplyGpuVertexModifersAsync(UObject* WorldContext,
 
 	if (ModifyInfo.GpuRowsCompleted == 0)
 	{
-		GpuComputeEngine->Compute(WorldContext, MeshBuildResult->DataTextures, GpuVertexModifier);
+		FComputeMaterial ComputeMaterial = GpuVertexModifier;
+		ComputeMaterial.Parameters.Append(AdditionalMaterialParameters);
+		GpuComputeEngine->Compute(WorldContext, MeshBuildResult->DataTextures, ComputeMaterial);
 	}
 
 	// Sometimes underline render targets getting destroyed.
@@ -466,10 +465,8 @@ void FOpenLandPolygonMesh::ModifyVertices(UObject* WorldContext, FOpenLandPolygo
 	}
 
 	// Build Faces
-	MeshBuildResult->Target->BoundingBox.Init();
-
 	auto TrackCpuVertexModifiers = TrackTime("CpuVertexModifiers");
-	ApplyVertexModifiers(VertexModifier, Intermediate.Get(), MeshBuildResult->Target.Get(), 0, MeshBuildResult->Original->Triangles.Length(), Options.RealTimeSeconds);
+	MeshBuildResult->Target->BoundingBox = ApplyVertexModifiers(VertexModifier, Intermediate.Get(), MeshBuildResult->Target.Get(), 0, MeshBuildResult->Original->Triangles.Length(), Options.RealTimeSeconds);
 	TrackCpuVertexModifiers.Finish();
 
 	if (Options.CuspAngle > 0.0)
@@ -480,6 +477,37 @@ void FOpenLandPolygonMesh::ModifyVertices(UObject* WorldContext, FOpenLandPolygo
 	}
 }
 
+void FOpenLandPolygonMesh::BuildTargetAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
+                                            FOpenLandPolygonMeshBuildOptions Options, std::function<void()> Callback)
+{
+	MeshBuildResult->Target = MeshBuildResult->Original->Clone();
+
+	EnsureGpuComputeEngine(WorldContext, MeshBuildResult);
+
+	FSimpleMeshInfoPtr Intermediate = MeshBuildResult->Original;
+	if (GpuVertexModifier.Material != nullptr)
+	{
+		ApplyGpuVertexModifers(WorldContext, MeshBuildResult, MakeParameters(0));
+		Intermediate = MeshBuildResult->Target;
+	}
+
+	FOpenLandThreading::RunOnLane(Options.Lane, [Self = AsShared(), MeshBuildResult, Intermediate, Options, Callback]()
+	{
+		FOpenLandMeshInfo* Target = MeshBuildResult->Target.Get();
+		Target->BoundingBox = ApplyVertexModifiers(Self->VertexModifier, Intermediate.Get(), Target, 0, Target->Triangles.Length(), 0);
+
+		if (Options.CuspAngle > 0.0)
+		{
+			ApplyNormalSmoothing(Target, Options.CuspAngle);
+		}
+
+		FOpenLandThreading::RunOnGameThread([Callback]()
+		{
+			Callback();
+		});
+	});
+}
+
 FOpenLandPolygonMeshModifyStatus FOpenLandPolygonMesh::StartModifyVertices(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
                                                FOpenLandPolygonMeshModifyOptions Options)
 {
@@ -547,64 +575,52 @@ FOpenLandPolygonMeshModifyStatus FOpenLandPolygonMesh::CheckModifyVerticesStatus
 	}
 
 	// Build Faces
-	ModifyInfo.MeshBuildResult->Target->BoundingBox.Init();
-
 	const int NumTris = ModifyInfo.MeshBuildResult->Original->Triangles.Length();
-	// TODO: Find out number of workers in the core & detect the workers accordingly
-	// TODO: May be we need to get worker information from the user may be.
-	const int NumWorkers = 10; // find this automatically based on number of cores in the system
+	// There's no point of creating more workers than the job system can run at once
+	const int NumWorkers = FMath::Clamp(FOpenLandJobSystem::GetMaxConcurrentJobs(), 1, 10);
 	const int TasksPerWorker = (NumTris / NumWorkers);
 
+	// The worker finishing last does the normal smoothing since it needs all the faces.
+	// It does that before marking itself as completed. So, all completions means smoothing is done too.
+	TSharedPtr<FThreadSafeCounter, ESPMode::ThreadSafe> RemainingWorkers = MakeShared<FThreadSafeCounter, ESPMode::ThreadSafe>(NumWorkers);
+	// Each worker writes the bounds of its own range into its slot. The last worker combines them.
+	TSharedPtr<TArray<FBox>, ESPMode::ThreadSafe> WorkerBounds = MakeShared<TArray<FBox>, ESPMode::ThreadSafe>();
+	WorkerBounds->Init(FBox(ForceInit), NumWorkers);
+
 	// Submit jobs
 	for (int WorkerId = 0; WorkerId < NumWorkers; WorkerId++)
 	{
 		AsyncCompletions.Push(false);
-		FOpenLandThreading::RunOnAnyBackgroundThread(
-			[this, Intermediate, NumWorkers, TasksPerWorker, WorkerId]
+		FOpenLandThreading::RunOnLane(ModifyInfo.Options.Lane,
+			[Self = AsShared(), Intermediate, NumWorkers, TasksPerWorker, WorkerId, RemainingWorkers, WorkerBounds]
 			{
+				const FOpenLandPolygonMeshModifyInfo& ModifyInfo = Self->ModifyInfo;
 				const int NumTris = Intermediate->Triangles.Length();
 				const int StartIndex = TasksPerWorker * WorkerId;
 				const int EndIndex = (WorkerId == NumWorkers - 1) ? NumTris : StartIndex + TasksPerWorker;
-				ApplyVertexModifiers(VertexModifier, Intermediate.Get(), ModifyInfo.MeshBuildResult->Target.Get(), StartIndex, EndIndex, ModifyInfo.Options.RealTimeSeconds);
+				(*WorkerBounds)[WorkerId] = ApplyVertexModifiers(Self->VertexModifier, Intermediate.Get(), ModifyInfo.MeshBuildResult->Target.Get(), StartIndex, EndIndex, ModifyInfo.Options.RealTimeSeconds);
+
+				if (RemainingWorkers->Decrement() == 0)
+				{
+					FBox BoundingBox(ForceInit);
+					for (const FBox& Box : *WorkerBounds)
+					{
+						BoundingBox += Box;
+					}
+					ModifyInfo.MeshBuildResult->Target->BoundingBox = BoundingBox;
+
+					ApplyNormalSmoothing(ModifyInfo.MeshBuildResult->Target.Get(), ModifyInfo.Options.CuspAngle);
+				}
 
 				// Mark the work as completed.
 				// We need to do this on the game thread since AsyncCompletions is not thread safe.
-				FOpenLandThreading::RunOnGameThread([this, WorkerId]
+				FOpenLandThreading::RunOnGameThread([Self, WorkerId]
 				{
-					AsyncCompletions[WorkerId] = true;
+					Self->AsyncCompletions[WorkerId] = true;
 				});
 			});
 	}
 
-	// Add a task to do the normal smoothing
-	AsyncCompletions.Push(false);
-	FOpenLandThreading::RunOnAnyBackgroundThread([this]
-	{
-		while (true)
-		{
-			bool bAsyncTaskCompleted = true;
-
-			for (int32 Index = 0; Index < AsyncCompletions.Num() - 1; Index++)
-			{
-				bAsyncTaskCompleted = bAsyncTaskCompleted && AsyncCompletions[Index];
-			}
-			
-			if (bAsyncTaskCompleted == false)
-			{
-				FPlatformProcess::Sleep(0.001);
-				continue;
-			}
-
-			ApplyNormalSmoothing(ModifyInfo.MeshBuildResult->Target.Get(), ModifyInfo.Options.CuspAngle);
-			break;
-		}
-
-		FOpenLandThreading::RunOnGameThread([this]
-		{
-			AsyncCompletions[AsyncCompletions.Num() - 1] = true;
-		});
-	});
-
 	return ModifyInfo.Status;
 }
 
@@ -613,6 +629,41 @@ int32 FOpenLandPolygonMesh::CalculateVerticesForSubdivision(int32 Subdivision) c
 	return SourceMeshInfo.Vertices.Length() * FMath::Pow(4, Subdivision);
 }
 
+float FOpenLandPolygonMesh::CalculateSubDivisionError(FOpenLandMeshInfo* Fine, int32 FineSubDivisions, FOpenLandMeshInfo* Coarse, int32 CoarseSubDivisions)
+{
+	check(FineSubDivisions >= CoarseSubDivisions);
+
+	// SubDivide replaces each triangle with 4 triangles in order.
+	// So, the ancestor of a fine triangle is at TriIndex / 4^(FineSubDivisions - CoarseSubDivisions)
+	const int32 AncestorShift = 2 * (FineSubDivisions - CoarseSubDivisions);
+	float MaxError = 0;
+
+	for (size_t TriIndex = 0; TriIndex < Fine->Triangles.Length(); TriIndex++)
+	{
+		const size_t AncestorIndex = TriIndex >> AncestorShift;
+		if (AncestorIndex >= Coarse->Triangles.Length())
+		{
+			// These meshes are not related
+			return BIG_NUMBER;
+		}
+
+		const FOpenLandMeshTriangle Ancestor = Coarse->Triangles.Get(AncestorIndex);
+		const FVector A = Coarse->Vertices.Get(Ancestor.T0).Position;
+		const FVector B = Coarse->Vertices.Get(Ancestor.T1).Position;
+		const FVector C = Coarse->Vertices.Get(Ancestor.T2).Position;
+
+		const FOpenLandMeshTriangle Triangle = Fine->Triangles.Get(TriIndex);
+		for (const int32 VertexIndex : {Triangle.T0, Triangle.T1, Triangle.T2})
+		{
+			const FVector Position = Fine->Vertices.Get(VertexIndex).Position;
+			const FVector ClosestPoint = FMath::ClosestPointOnTriangleToPoint(Position, A, B, C);
+			MaxError = FMath::Max(MaxError, FVector::Distance(Position, ClosestPoint));
+		}
+	}
+
+	return MaxError;
+}
+
 void FOpenLandPolygonMesh::AddTriFace(const FVector A, const FVector B, const FVector C)
 {
 	const TOpenLandArray<FOpenLandMeshVertex> InputVertices = {
@@ -622,12 +673,14 @@ void FOpenLandPolygonMesh::AddTriFace(const FVector A, const FVector B, const FV
 	};
 
 	AddFace(&SourceMeshInfo, InputVertices);
+	bSourceHashDirty = true;
 }
 
 void FOpenLandPolygonMesh::AddTriFace(const FOpenLandMeshVertex A, const FOpenLandMeshVertex B,
 	const FOpenLandMeshVertex C)
 {
 	AddFace(&SourceMeshInfo, {A, B, C});
+	bSourceHashDirty = true;
 }
 
 void FOpenLandPolygonMesh::AddQuadFace(const FOpenLandMeshVertex A, const FOpenLandMeshVertex B,
@@ -639,6 +692,7 @@ void FOpenLandPolygonMesh::AddQuadFace(const FOpenLandMeshVertex A, const FOpenL
 	};
 
 	AddFace(&SourceMeshInfo, InputVertices);
+	bSourceHashDirty = true;
 }
 
 void FOpenLandPolygonMesh::AddQuadFace(const FVector A, const FVector B, const FVector C, const FVector D)
@@ -654,6 +708,7 @@ void FOpenLandPolygonMesh::AddQuadFace(const FVector A, const FVector B, const F
 	};
 
 	AddFace(&SourceMeshInfo, InputVertices);
+	bSourceHashDirty = true;
 }
 
 void FOpenLandPolygonMesh::Transform(FTransform Transformer)
@@ -661,6 +716,123 @@ void FOpenLandPolygonMesh::Transform(FTransform Transformer)
 	SourceTransformer = Transformer;
 }
 
+static uint64 HashString(const FString& Value, uint64 Seed)
+{
+	const FTCHARToUTF8 ValueUTF8(*Value);
+	return CityHash64WithSeed(ValueUTF8.Get(), ValueUTF8.Length(), Seed);
+}
+
+template <typename T>
+static uint64 HashValue(const T& Value, uint64 Seed)
+{
+	return CityHash64WithSeed(reinterpret_cast<const char*>(&Value), sizeof(T), Seed);
+}
+
+// Hashes the material graph version and the parameter overrides of every instance up to it.
+// Returns false when we can't tell whether the material changed.
+static bool HashMaterialVersion(UMaterialInterface* Material, uint64& Hash)
+{
+	while (UMaterialInstance* MaterialInstance = Cast<UMaterialInstance>(Material))
+	{
+		Hash = HashString(MaterialInstance->GetPathName(), Hash);
+		for (const FScalarParameterValue& Value : MaterialInstance->ScalarParameterValues)
+		{
+			Hash = HashString(Value.ParameterInfo.Name.ToString(), Hash);
+			Hash = HashValue(Value.ParameterValue, Hash);
+		}
+		for (const FVectorParameterValue& Value : MaterialInstance->VectorParameterValues)
+		{
+			Hash = HashString(Value.ParameterInfo.Name.ToString(), Hash);
+			Hash = HashValue(Value.ParameterValue, Hash);
+		}
+		for (const FTextureParameterValue& Value : MaterialInstance->TextureParameterValues)
+		{
+			Hash = HashString(Value.ParameterInfo.Name.ToString(), Hash);
+			Hash = HashString(Value.ParameterValue ? Value.ParameterValue->GetPathName() : FString(), Hash);
+		}
+
+		Material = MaterialInstance->Parent;
+	}
+
+	const UMaterial* BaseMaterial = Cast<UMaterial>(Material);
+	if (BaseMaterial == nullptr)
+	{
+		return false;
+	}
+
+	// StateId gets regenerated whenever the material graph changes
+	Hash = HashString(BaseMaterial->GetPathName(), Hash);
+	Hash = HashValue(BaseMaterial->StateId, Hash);
+	return true;
+}
+
+bool FOpenLandPolygonMesh::CalculateContentHash(const FOpenLandPolygonMeshBuildOptions& Options, uint64& OutHash)
+{
+	if (VertexModifier != nullptr)
+	{
+		return false;
+	}
+
+	if (bSourceHashDirty)
+	{
+		// Vertices have padding bytes. So, we pack the fields before hashing them.
+		TArray<uint8> PackedVertices;
+		PackedVertices.Reserve(SourceMeshInfo.Vertices.Length() * 96);
+		const auto Pack = [&PackedVertices](const void* Data, int32 Size)
+		{
+			PackedVertices.Append(static_cast<const uint8*>(Data), Size);
+		};
+
+		for (size_t Index = 0; Index < SourceMeshInfo.Vertices.Length(); Index++)
+		{
+			const FOpenLandMeshVertex Vertex = SourceMeshInfo.Vertices.Get(Index);
+			Pack(&Vertex.Position, sizeof(FVector));
+			Pack(&Vertex.Normal, sizeof(FVector));
+			Pack(&Vertex.Tangent.TangentX, sizeof(FVector));
+			Pack(&Vertex.Tangent.bFlipTangentY, sizeof(bool));
+			Pack(&Vertex.Color, sizeof(FColor));
+			Pack(&Vertex.UV0, sizeof(FVector2D));
+			Pack(&Vertex.UV1, sizeof(FVector2D));
+			Pack(&Vertex.UV2, sizeof(FVector2D));
+			Pack(&Vertex.UV3, sizeof(FVector2D));
+			Pack(&Vertex.ObjectId, sizeof(size_t));
+			Pack(&Vertex.TriangleId, sizeof(size_t));
+		}
+
+		SourceHash = CityHash64(reinterpret_cast<const char*>(PackedVertices.GetData()), PackedVertices.Num());
+		SourceHash = CityHash64WithSeed(reinterpret_cast<const char*>(SourceMeshInfo.Triangles.GetData()),
+		                                SourceMeshInfo.Triangles.Length() * sizeof(FOpenLandMeshTriangle), SourceHash);
+		bSourceHashDirty = false;
+	}
+
+	uint64 Hash = SourceHash;
+	const FMatrix Transformer = SourceTransformer.ToMatrixWithScale();
+	Hash = HashValue(Transformer.M, Hash);
+	Hash = HashValue(Options.SubDivisions, Hash);
+	Hash = HashValue(Options.CuspAngle, Hash);
+	Hash = HashValue(Options.ForcedTextureWidth, Hash);
+
+	if (GpuVertexModifier.Material != nullptr)
+	{
+		if (!HashMaterialVersion(GpuVertexModifier.Material, Hash))
+		{
+			return false;
+		}
+
+		for (const FComputeMaterialParameter& Parameter : GpuVertexModifier.Parameters)
+		{
+			Hash = HashString(Parameter.Name.ToString(), Hash);
+			Hash = HashValue(Parameter.Type.GetValue(), Hash);
+			Hash = HashValue(Parameter.ScalarValue, Hash);
+			Hash = HashValue(Parameter.VectorValue, Hash);
+			Hash = HashString(Parameter.TextureValue ? Parameter.TextureValue->GetPathName() : FString(), Hash);
+		}
+	}
+
+	OutHash = Hash;
+	return true;
+}
+
 bool FOpenLandPolygonMesh::IsThereAnyAsyncTask() const
 {
 	if (AsyncCompletions.Num() == 0)
@@ -793,58 +965,18 @@ TArray<FComputeMaterialParameter> FOpenLandPolygonMesh::MakeParameters(float Tim
 FOpenLandPolygonMesh::~FOpenLandPolygonMesh()
 {
 	VertexModifier = nullptr;
-}
 
-void FOpenLandPolygonMesh::RunDeleteScheduler()
-{
-	if (bIsDeleteSchedulerRunning)
+	// The last reference can be released by a background task.
+	// GPU compute engines own UObjects & render resources. So, they must be released on the game thread.
+	if (!IsInGameThread() && (GpuComputeEngine.IsValid() || OldGpuComputeEngines.Num() > 0))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("[Delete Schedular] Running"))
-		return;
-	}
-
-	// Start the delete loop
-	UE_LOG(LogTemp, Warning, TEXT("[Delete Schedular] Trying to delete: %d"), PolygonMeshesToDelete.Num())
-	bIsDeleteSchedulerRunning = true;
-
-	TArray<FOpenLandPolygonMesh*> StillRunningPolygonMeshes;
-	for (int32 Index = 0; Index < PolygonMeshesToDelete.Num(); Index++)
-	{
-		FOpenLandPolygonMesh* PolygonMesh = PolygonMeshesToDelete[Index];
-		if (PolygonMesh == nullptr)
-			continue;
-
-		if (PolygonMesh->IsThereAnyAsyncTask())
-			StillRunningPolygonMeshes.Push(PolygonMeshesToDelete[Index]);
-		else
-		{
-			UE_LOG(LogTemp, Warning, TEXT("[Delete Schedular] Deleting polygon mesh"))
-			delete PolygonMesh;
-		}
-	}
-
-	PolygonMeshesToDelete = StillRunningPolygonMeshes;
-	bIsDeleteSchedulerRunning = false;
-	UE_LOG(LogTemp, Warning, TEXT("[Delete Schedular] Still need to delete: %d"), PolygonMeshesToDelete.Num())
-
-	// Nothing to delete, let's stop this
-	if (PolygonMeshesToDelete.Num() == 0)
-		return;
-
-	UE_LOG(LogTemp, Warning, TEXT("[Delete Schedular] Adding a Timeout for 1 sec"))
-	// If there are more to delete, Schedule again with a timeout
-	FOpenLandThreading::RunOnAnyBackgroundThread([]()
-	{
-		FPlatformProcess::Sleep(1);
-		FOpenLandThreading::RunOnGameThread([]()
+		// These shared pointers are not thread safe. So, we move them into a heap allocation rather than
+		// copying them around with the task.
+		TArray<TSharedPtr<FGpuComputeVertex>>* EnginesToRelease = new TArray<TSharedPtr<FGpuComputeVertex>>(MoveTemp(OldGpuComputeEngines));
+		EnginesToRelease->Push(MoveTemp(GpuComputeEngine));
+		FOpenLandThreading::RunOnGameThread([EnginesToRelease]()
 		{
-			RunDeleteScheduler();
+			delete EnginesToRelease;
 		});
-	});
-}
-
-void FOpenLandPolygonMesh::DeletePolygonMesh(FOpenLandPolygonMesh* PolygonMesh)
-{
-	PolygonMeshesToDelete.Push(PolygonMesh);
-	RunDeleteScheduler();
+	}
 }
@@ -73,6 +73,18 @@ T& TOpenLandArray<T>::GetRef(size_t Index)
 	return Data[Index];
 }
 
+template <typename T>
+T* TOpenLandArray<T>::GetData()
+{
+	return Data.data();
+}
+
+template <typename T>
+const T* TOpenLandArray<T>::GetData() const
+{
+	return Data.data();
+}
+
 template <typename T>
 void TOpenLandArray<T>::Set(size_t Index, T Value)
 {
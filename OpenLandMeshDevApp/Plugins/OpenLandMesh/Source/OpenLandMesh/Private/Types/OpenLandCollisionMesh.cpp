@@ -0,0 +1,70 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#include "Types/OpenLandCollisionMesh.h"
+#include "Hash/CityHash.h"
+
+void FOpenLandCollisionMesh::UpdatePositions(TArray<FVector>& OutPositions) const
+{
+	OutPositions.SetNumUninitialized(SourceVertices.Num());
+	for (int32 Index = 0; Index < SourceVertices.Num(); Index++)
+	{
+		OutPositions[Index] = Source->Vertices.Get(SourceVertices[Index]).Position;
+	}
+}
+
+FOpenLandCollisionMeshPtr FOpenLandCollisionMesh::Build(FSimpleMeshInfoPtr Source, bool bDeformable)
+{
+	FOpenLandCollisionMeshPtr CollisionMesh = MakeShared<FOpenLandCollisionMesh, ESPMode::ThreadSafe>();
+	CollisionMesh->Source = Source;
+	CollisionMesh->bDeformable = bDeformable;
+
+	const int32 NumVertices = Source->Vertices.Length();
+	const int32 NumTriangles = Source->Triangles.Length();
+
+	// Welding
+	TArray<int32> VertexToPosition;
+	VertexToPosition.SetNumUninitialized(NumVertices);
+	TMap<FVector, int32> PositionToIndex;
+	PositionToIndex.Reserve(NumVertices / 2);
+	CollisionMesh->Positions.Reserve(NumVertices / 2);
+	CollisionMesh->SourceVertices.Reserve(NumVertices / 2);
+
+	for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+	{
+		const FVector Position = Source->Vertices.Get(VertexIndex).Position;
+		const int32* ExistingIndex = PositionToIndex.Find(Position);
+		if (ExistingIndex != nullptr)
+		{
+			VertexToPosition[VertexIndex] = *ExistingIndex;
+			continue;
+		}
+
+		const int32 NewIndex = CollisionMesh->Positions.Add(Position);
+		CollisionMesh->SourceVertices.Add(VertexIndex);
+		PositionToIndex.Add(Position, NewIndex);
+		VertexToPosition[VertexIndex] = NewIndex;
+	}
+
+	CollisionMesh->Indices.Reserve(NumTriangles);
+	for (int32 TriIndex = 0; TriIndex < NumTriangles; TriIndex++)
+	{
+		const FOpenLandMeshTriangle Triangle = Source->Triangles.Get(TriIndex);
+		FTriIndices Indices;
+		Indices.v0 = VertexToPosition[Triangle.T0];
+		Indices.v1 = VertexToPosition[Triangle.T1];
+		Indices.v2 = VertexToPosition[Triangle.T2];
+
+		// Welding can collapse tiny triangles. Cookers don't like them.
+		if (Indices.v0 == Indices.v1 || Indices.v1 == Indices.v2 || Indices.v0 == Indices.v2)
+		{
+			continue;
+		}
+
+		CollisionMesh->Indices.Add(Indices);
+	}
+
+	const uint64 PositionsHash = CityHash64(reinterpret_cast<const char*>(CollisionMesh->Positions.GetData()), CollisionMesh->Positions.Num() * sizeof(FVector));
+	CollisionMesh->ContentHash = CityHash64WithSeed(reinterpret_cast<const char*>(CollisionMesh->Indices.GetData()), CollisionMesh->Indices.Num() * sizeof(FTriIndices), PositionsHash);
+
+	return CollisionMesh;
+}
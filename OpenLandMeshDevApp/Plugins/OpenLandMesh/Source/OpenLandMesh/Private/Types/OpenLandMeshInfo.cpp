@@ -10,6 +10,23 @@ FOpenLandMeshInfo::FOpenLandMeshInfo()
 	BoundingBox.Init();
 }
 
+FOpenLandMeshInfo::FOpenLandMeshInfo(const FOpenLandMeshInfo& Other)
+	: LockCount(Other.LockCount)
+	  , Vertices(Other.Vertices)
+	  , Triangles(Other.Triangles)
+	  , BoundingBox(Other.BoundingBox)
+{
+}
+
+FOpenLandMeshInfo& FOpenLandMeshInfo::operator=(const FOpenLandMeshInfo& Other)
+{
+	LockCount = Other.LockCount;
+	Vertices = Other.Vertices;
+	Triangles = Other.Triangles;
+	BoundingBox = Other.BoundingBox;
+	return *this;
+}
+
 FOpenLandMeshInfo::~FOpenLandMeshInfo()
 {
 	Release();
@@ -31,27 +48,27 @@ void FOpenLandMeshInfo::Freeze()
 
 bool FOpenLandMeshInfo::IsLocked() const
 {
-	return bLocked;
+	return LockCount > 0;
 }
 
 void FOpenLandMeshInfo::Lock()
 {
-	bLocked = true;
-	Vertices.Lock();
+	FScopeLock ScopeLock(&LockGuard);
+	if (FPlatformAtomics::InterlockedIncrement(&LockCount) == 1)
+		Vertices.Lock();
 }
 
 void FOpenLandMeshInfo::UnLock()
 {
-	bLocked = false;
-	Vertices.UnLock();
+	FScopeLock ScopeLock(&LockGuard);
+	if (FPlatformAtomics::InterlockedDecrement(&LockCount) == 0)
+		Vertices.UnLock();
 }
 
 FSimpleMeshInfoPtr FOpenLandMeshInfo::Clone()
 {
 	FSimpleMeshInfoPtr NewMeshInfo = MakeShared<FOpenLandMeshInfo, ESPMode::ThreadSafe>();
 	NewMeshInfo->BoundingBox = BoundingBox;
-	NewMeshInfo->bEnableCollision = bEnableCollision;
-	NewMeshInfo->bSectionVisible = bSectionVisible;
 
 	for (size_t Index = 0; Index < Vertices.Length(); Index++)
 		NewMeshInfo->Vertices.Push(Vertices.Get(Index));
@@ -96,36 +96,12 @@ FVector FOpenLandMeshGrid::GetCellMidPoint(int32 CellId) const
 
 TArray<int32> FOpenLandMeshGrid::FindCellsAround(int32 CellId, int32 CellRadius) const
 {
-	const FOpenLandMeshGridCell Center = CellIdToCell(CellId);
 	TArray<int32> Cells;
-
-	for (int32 XChange=-CellRadius; XChange <= CellRadius; XChange ++)
+	ForEachCellAround(CellId, CellRadius, [&Cells](int32 AroundCellId)
 	{
-		for (int32 YChange=-CellRadius; YChange <= CellRadius; YChange ++)
-		{
-			if (XChange == 0 && YChange == 0)
-			{
-				continue;
-			}
-
-			if (FMath::Abs(XChange) == CellRadius && FMath::Abs(YChange) == CellRadius)
-			{
-				continue;
-			}
-			
-			const FOpenLandMeshGridCell NewCell = {
-				Center.X + XChange,
-				Center.Y + YChange
-			};
-
-			if (NewCell.X < 0 || NewCell.Y < 0 || NewCell.X >= TotalCells.X || NewCell.Y >= TotalCells.Y)
-			{
-				continue;
-			}
-
-			Cells.Push(CellToCellId(NewCell));
-		}
-	}
+		Cells.Push(AroundCellId);
+		return true;
+	});
 
 	return Cells;
 }
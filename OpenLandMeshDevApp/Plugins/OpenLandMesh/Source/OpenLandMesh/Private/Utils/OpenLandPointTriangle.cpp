@@ -10,9 +10,10 @@ FOpenLandPointTriangle::FOpenLandPointTriangle(FVector T0, FVector T1, FVector T
 	C = T2;
 }
 
-FVector FOpenLandPointTriangle::FindRandomPoint(float EdgeDistance) const
+FVector FOpenLandPointTriangle::FindRandomPoint(const FRandomStream& RandomStream, float EdgeDistance) const
 {
-	TArray<FVector> Points = {A, B, C};
+	// This is called a lot from worker threads. So, we keep these on the stack.
+	TArray<FVector, TInlineAllocator<3>> Points = {A, B, C};
 
 	if (EdgeDistance != 0.0f)
 	{
@@ -32,23 +33,23 @@ FVector FOpenLandPointTriangle::FindRandomPoint(float EdgeDistance) const
 		}
 	}
 	
-	TArray<FOpenLandPointLine> Lines = {
+	TArray<FOpenLandPointLine, TInlineAllocator<3>> Lines = {
 		{Points[0], Points[1]},
 		{Points[0], Points[2]},
 		{Points[1], Points[2]}
 	};
 
-	const int32 FirstLineIndex = FMath::RandRange(0, 2);
+	const int32 FirstLineIndex = RandomStream.RandRange(0, 2);
 	const FOpenLandPointLine FirstLine = Lines[FirstLineIndex];
 	Lines.RemoveAt(FirstLineIndex);
 
-	const int32 SecondLineIndex = FMath::RandRange(0, 1);
+	const int32 SecondLineIndex = RandomStream.RandRange(0, 1);
 	const FOpenLandPointLine SecondLine = Lines[SecondLineIndex];
 		
-	const FVector X = FirstLine.Interpolate(FMath::RandRange(0.0f, 1.0f));
-	const FVector Y = SecondLine.Interpolate(FMath::RandRange(0.0f, 1.0f));
+	const FVector X = FirstLine.Interpolate(RandomStream.FRand());
+	const FVector Y = SecondLine.Interpolate(RandomStream.FRand());
 	
-	return FOpenLandPointLine(X, Y).Interpolate(FMath::RandRange(0.0f, 1.0f));
+	return FOpenLandPointLine(X, Y).Interpolate(RandomStream.FRand());
 }
 
 float FOpenLandPointTriangle::FindArea() const
@@ -1,33 +1,127 @@
 ﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
 
 #include "Utils/OpenLandPointUtils.h"
+#include "API/OpenLandMeshHash.h"
+#include "Utils/OpenLandMeshStats.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Scatter Cache Hits"), STAT_OpenLandMesh_ScatterCacheHits, STATGROUP_OpenLandMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scatter Cache Entries"), STAT_OpenLandMesh_ScatterCacheEntries, STATGROUP_OpenLandMesh);
+
+// Scatter results can be big. So, we only keep the recent ones.
+static const int32 OpenLandMaxScatterResults = 32;
+static TMap<FString, TArray<FOpenLandInstancingRequestPoint>> ScatterResults;
+static TArray<FString> ScatterResultKeys;
 
 void FOpenLandPointUtils::ApplyPointRandomization(FOpenLandInstancingRequestPoint& RequestPoint,
-                                                  FOpenLandInstancingRules Rules)
+                                                  FOpenLandInstancingRules Rules, const FRandomStream& RandomStream)
 {
 	RequestPoint.RandomScale = {
-		FMath::RandRange(Rules.RandomScale3D.Min.X, Rules.RandomScale3D.Max.X),
-		FMath::RandRange(Rules.RandomScale3D.Min.Y, Rules.RandomScale3D.Max.Y),
-		FMath::RandRange(Rules.RandomScale3D.Min.Z, Rules.RandomScale3D.Max.Z)
+		RandomStream.FRandRange(Rules.RandomScale3D.Min.X, Rules.RandomScale3D.Max.X),
+		RandomStream.FRandRange(Rules.RandomScale3D.Min.Y, Rules.RandomScale3D.Max.Y),
+		RandomStream.FRandRange(Rules.RandomScale3D.Min.Z, Rules.RandomScale3D.Max.Z)
 	};
 
-	RequestPoint.RandomScale = RequestPoint.RandomScale * FMath::RandRange(Rules.RandomScaleUniform.Min, Rules.RandomScaleUniform.Max);
+	RequestPoint.RandomScale = RequestPoint.RandomScale * RandomStream.FRandRange(Rules.RandomScaleUniform.Min, Rules.RandomScaleUniform.Max);
 	
 	RequestPoint.RandomRotation = {
-    	FMath::RandRange(Rules.RandomRotation.Min.X, Rules.RandomRotation.Max.X),
-    	FMath::RandRange(Rules.RandomRotation.Min.Y, Rules.RandomRotation.Max.Y),
-    	FMath::RandRange(Rules.RandomRotation.Min.Z, Rules.RandomRotation.Max.Z)
+    	RandomStream.FRandRange(Rules.RandomRotation.Min.X, Rules.RandomRotation.Max.X),
+    	RandomStream.FRandRange(Rules.RandomRotation.Min.Y, Rules.RandomRotation.Max.Y),
+    	RandomStream.FRandRange(Rules.RandomRotation.Min.Z, Rules.RandomRotation.Max.Z)
     };
 	RequestPoint.bUseLocalRandomRotation = Rules.RandomRotation.bUseLocalRotation;
 
 	RequestPoint.RandomDisplacement = {
-		FMath::RandRange(Rules.RandomDisplacement.Min.X, Rules.RandomDisplacement.Max.X),
-		FMath::RandRange(Rules.RandomDisplacement.Min.Y, Rules.RandomDisplacement.Max.Y),
-		FMath::RandRange(Rules.RandomDisplacement.Min.Z, Rules.RandomDisplacement.Max.Z)
+		RandomStream.FRandRange(Rules.RandomDisplacement.Min.X, Rules.RandomDisplacement.Max.X),
+		RandomStream.FRandRange(Rules.RandomDisplacement.Min.Y, Rules.RandomDisplacement.Max.Y),
+		RandomStream.FRandRange(Rules.RandomDisplacement.Min.Z, Rules.RandomDisplacement.Max.Z)
 	};
 	RequestPoint.bUseLocalRandomDisplacement = Rules.RandomDisplacement.bUseLocalDisplacement;
 }
 
+int64 FOpenLandPointUtils::MakePointId(int32 RuleIndex, const FOpenLandMeshPoint& MeshPoint)
+{
+	// Rule: 12 bits, Source: 28 bits, Sample: 24 bits
+	constexpr int32 RuleBitCount = 12;
+	constexpr int32 SourceBitCount = 28;
+	constexpr int32 SampleBitCount = 24;
+
+	const bool bRuleFits = RuleIndex >= 0 && RuleIndex < (1 << RuleBitCount);
+	const bool bSourceFits = MeshPoint.SourceIndex >= 0 && MeshPoint.SourceIndex < (1 << SourceBitCount);
+	const bool bSampleFits = MeshPoint.SampleIndex >= 0 && MeshPoint.SampleIndex < (1 << SampleBitCount);
+	if (!bRuleFits || !bSourceFits || !bSampleFits)
+	{
+		// Truncating would give the same id to different points
+		UE_LOG(LogTemp, Warning, TEXT("Cannot make a point id for Rule: %d, Source: %d, Sample: %d"), RuleIndex, MeshPoint.SourceIndex, MeshPoint.SampleIndex)
+		return INDEX_NONE;
+	}
+
+	const uint64 RuleBits = static_cast<uint64>(RuleIndex) << (SourceBitCount + SampleBitCount);
+	const uint64 SourceBits = static_cast<uint64>(MeshPoint.SourceIndex) << SampleBitCount;
+	const uint64 SampleBits = static_cast<uint64>(MeshPoint.SampleIndex);
+	return static_cast<int64>(RuleBits | SourceBits | SampleBits);
+}
+
+int32 FOpenLandPointUtils::MakeRuleSeed(int32 ActorSeed, const FOpenLandInstancingRules& Rules, int32 RuleIndex)
+{
+	// Rules with the same seed still get different layouts
+	return static_cast<int32>(HashCombine(HashCombine(GetTypeHash(ActorSeed), GetTypeHash(Rules.Seed)), GetTypeHash(RuleIndex)));
+}
+
+int32 FOpenLandPointUtils::MakePointSeed(int32 RuleSeed, int64 PointId)
+{
+	return static_cast<int32>(HashCombine(GetTypeHash(RuleSeed), GetTypeHash(PointId)));
+}
+
+FString FOpenLandPointUtils::MakeScatterKey(const FString& MeshCacheKey, const FOpenLandInstancingRules& Rules, int32 RuleIndex, int32 RuleSeed)
+{
+	FString RulesText;
+	FOpenLandInstancingRules::StaticStruct()->ExportText(RulesText, &Rules, nullptr, nullptr, PPF_None, nullptr);
+
+	UOpenLandMeshHash* Hash = UOpenLandMeshHash::MakeHash(OLMHM_FAST128);
+	Hash->AddString(MeshCacheKey);
+	Hash->AddString(RulesText);
+	Hash->AddInteger(RuleIndex);
+	Hash->AddInteger(RuleSeed);
+	return Hash->Generate();
+}
+
+bool FOpenLandPointUtils::FindScatterResult(const FString& ScatterKey, TArray<FOpenLandInstancingRequestPoint>& Points)
+{
+	const TArray<FOpenLandInstancingRequestPoint>* CachedPoints = ScatterResults.Find(ScatterKey);
+	if (CachedPoints == nullptr)
+	{
+		return false;
+	}
+
+	INC_DWORD_STAT(STAT_OpenLandMesh_ScatterCacheHits);
+	Points = *CachedPoints;
+	return true;
+}
+
+void FOpenLandPointUtils::StoreScatterResult(const FString& ScatterKey, const TArray<FOpenLandInstancingRequestPoint>& Points)
+{
+	if (ScatterResults.Find(ScatterKey) == nullptr)
+	{
+		ScatterResultKeys.Push(ScatterKey);
+	}
+	ScatterResults.Add(ScatterKey, Points);
+
+	while (ScatterResultKeys.Num() > OpenLandMaxScatterResults)
+	{
+		ScatterResults.Remove(ScatterResultKeys[0]);
+		ScatterResultKeys.RemoveAt(0);
+	}
+
+	SET_DWORD_STAT(STAT_OpenLandMesh_ScatterCacheEntries, ScatterResults.Num());
+}
+
+void FOpenLandPointUtils::ClearScatterResults()
+{
+	ScatterResults.Empty();
+	ScatterResultKeys.Empty();
+	SET_DWORD_STAT(STAT_OpenLandMesh_ScatterCacheEntries, 0);
+}
+
 void FOpenLandPointUtils::CalculateTangentX(FOpenLandInstancingRequestPoint& RequestPoint,
 												FOpenLandInstancingRules Rules)
 {
@@ -5,47 +5,273 @@
 #include "Utils/OpenLandPointLine.h"
 #include "Utils/OpenLandPointTriangle.h"
 #include "Utils/OpenLandUpVectorSwitcher.h"
+#include "Async/ParallelFor.h"
+#include "Algo/BinarySearch.h"
+#include "HAL/IConsoleManager.h"
+
+// Triangles are cheap to sample. So, we give a range of them to each task.
+static const int32 OpenLandPoissonTrianglesPerTask = 128;
+// Attempts we allow per wanted point before giving up on a Poisson disk surface (same as Bridson's k)
+static const int32 OpenLandPoissonDiskAttemptsPerPoint = 30;
+// Above this, we track occupied cells of a triangle in a map instead of a dense array
+static const int32 OpenLandMaxDenseGridCells = 1 << 20;
+
+static void BenchmarkPointSampling(const TArray<FString>& Args)
+{
+	// A flat grid of 1m x 1m quads, so Density is the number of points per quad
+	const int32 QuadsPerSide = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 256;
+	const float Density = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 10.0f;
+	const float MinRadius = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 10.0f;
+
+	FSimpleMeshInfoPtr MeshInfo = FOpenLandMeshInfo::New();
+	for (int32 Y = 0; Y <= QuadsPerSide; Y++)
+	{
+		for (int32 X = 0; X <= QuadsPerSide; X++)
+		{
+			MeshInfo->Vertices.Push(FOpenLandMeshVertex(FVector(X * 100.0f, Y * 100.0f, 0.0f)));
+		}
+	}
+	for (int32 Y = 0; Y < QuadsPerSide; Y++)
+	{
+		for (int32 X = 0; X < QuadsPerSide; X++)
+		{
+			const int32 V0 = Y * (QuadsPerSide + 1) + X;
+			const int32 V1 = V0 + QuadsPerSide + 1;
+			MeshInfo->Triangles.Push({V0, V1, V0 + 1});
+			MeshInfo->Triangles.Push({V0 + 1, V1, V1 + 1});
+		}
+	}
+
+	const auto Report = [](const TCHAR* Name, int32 NumPoints, double StartedAt)
+	{
+		const double TimeTaken = FPlatformTime::Seconds() - StartedAt;
+		UE_LOG(LogTemp, Warning, TEXT("%s: %d points in %.2f ms (%.0f samples/s)"), Name, NumPoints, TimeTaken * 1000.0, NumPoints / FMath::Max(TimeTaken, 1e-9));
+	};
+
+	double StartedAt = FPlatformTime::Seconds();
+	Report(TEXT("Modified Poisson 2D"), FOpenLandPointsBuilder::BuildPointsModifiedPoisson2D(MeshInfo, Density, MinRadius).Num(), StartedAt);
+
+	StartedAt = FPlatformTime::Seconds();
+	Report(TEXT("Poisson Disk"), FOpenLandPointsBuilder::BuildPointsPoissonDisk(MeshInfo, Density, MinRadius).Num(), StartedAt);
+}
+
+static FAutoConsoleCommand OpenLandBenchmarkPointSamplingCommand(
+	TEXT("OpenLandMesh.BenchmarkPointSampling"),
+	TEXT("Samples a flat grid & logs samples per second. Args: [QuadsPerSide=256] [Density=10] [MinRadius=10]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPointSampling)
+);
 
-TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsModifiedPoisson2D(FSimpleMeshInfoPtr MeshInfo, float Density, float MinRadius)
+TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsModifiedPoisson2D(FSimpleMeshInfoPtr MeshInfo, float Density, float MinRadius, int32 Seed)
 {
+	const int32 NumTriangles = MeshInfo->Triangles.Length();
+	const int32 NumTasks = FMath::DivideAndRoundUp(NumTriangles, OpenLandPoissonTrianglesPerTask);
+
+	// Each task samples a contiguous range of triangles into its own list
+	TArray<TArray<FOpenLandMeshPoint>> TaskPoints;
+	TaskPoints.SetNum(NumTasks);
+
+	// Grid cell buffers are shared by the tasks. A task takes one when it starts & gives it back at the end.
+	// So, there's only one for each worker running this build.
+	FCriticalSection CellBuffersLock;
+	TArray<TUniquePtr<TArray<int32>>> FreeCellBuffers;
+
+	ParallelFor(NumTasks, [&MeshInfo, &TaskPoints, &CellBuffersLock, &FreeCellBuffers, NumTriangles, Density, MinRadius, Seed](int32 TaskIndex)
+	{
+		TArray<FOpenLandMeshPoint>& Points = TaskPoints[TaskIndex];
+		TUniquePtr<TArray<int32>> CellBuffer;
+		{
+			FScopeLock ScopeLock(&CellBuffersLock);
+			CellBuffer = FreeCellBuffers.Num() > 0 ? FreeCellBuffers.Pop(false) : MakeUnique<TArray<int32>>();
+		}
+		TArray<int32>& PointsInCellBuffer = *CellBuffer;
+
+		const int32 StartTriangleIndex = TaskIndex * OpenLandPoissonTrianglesPerTask;
+		const int32 EndTriangleIndex = FMath::Min(NumTriangles, StartTriangleIndex + OpenLandPoissonTrianglesPerTask);
+
+		for (int32 TriangleIndex = StartTriangleIndex; TriangleIndex < EndTriangleIndex; TriangleIndex++)
+		{
+			const FOpenLandMeshTriangle MeshTriangle = MeshInfo->Triangles.Get(TriangleIndex);
+			const FVector P0 = MeshInfo->Vertices.Get(MeshTriangle.T0).Position;
+			const FVector P1 = MeshInfo->Vertices.Get(MeshTriangle.T1).Position;
+			const FVector P2 = MeshInfo->Vertices.Get(MeshTriangle.T2).Position;
+			const FRandomStream RandomStream(MakeTriangleSeed(Seed, TriangleIndex));
+			
+			const float Area = FOpenLandPointTriangle::FindArea(P0, P1, P2);
+			const float PointCountFromDensity = Area/10000 * Density;
+			int32 PointCount;
+			if (PointCountFromDensity >= 1)
+			{
+				PointCount = FMath::RoundToInt(PointCountFromDensity);
+			} else
+			{
+				PointCount = RandomStream.FRand() <= PointCountFromDensity? 1 : 0;
+			}
+			
+			if (PointCount <= 0)
+			{
+				continue;
+			}
+			
+			TArray<FOpenLandMeshPoint> LocalPoints = BuildPointsOnTriangle(MeshInfo, TriangleIndex, PointCount, MinRadius, RandomStream, PointsInCellBuffer);
+			for(int32 SampleIndex=0; SampleIndex<LocalPoints.Num(); SampleIndex++)
+			{
+				LocalPoints[SampleIndex].SourceIndex = TriangleIndex;
+				LocalPoints[SampleIndex].SampleIndex = SampleIndex;
+			}
+			Points.Append(LocalPoints);
+		}
+
+		FScopeLock ScopeLock(&CellBuffersLock);
+		FreeCellBuffers.Push(MoveTemp(CellBuffer));
+	});
+
+	// Prefix sum of the counts gives each task its place in the result. Then we copy them in parallel.
+	TArray<int32> TaskOffsets;
+	TaskOffsets.SetNumUninitialized(NumTasks);
+	int32 NumPoints = 0;
+	for (int32 TaskIndex = 0; TaskIndex < NumTasks; TaskIndex++)
+	{
+		TaskOffsets[TaskIndex] = NumPoints;
+		NumPoints += TaskPoints[TaskIndex].Num();
+	}
+
 	TArray<FOpenLandMeshPoint> InstancingPoints;
+	InstancingPoints.SetNumUninitialized(NumPoints);
+	ParallelFor(NumTasks, [&InstancingPoints, &TaskPoints, &TaskOffsets](int32 TaskIndex)
+	{
+		const TArray<FOpenLandMeshPoint>& Points = TaskPoints[TaskIndex];
+		FMemory::Memcpy(InstancingPoints.GetData() + TaskOffsets[TaskIndex], Points.GetData(), Points.Num() * sizeof(FOpenLandMeshPoint));
+	});
 
-	// Finding Points
-	const FVector ZVector = {0, 0, 1};
-	
-	for (size_t TriangleIndex=0; TriangleIndex<MeshInfo->Triangles.Length(); TriangleIndex++)
+	return InstancingPoints;
+}
+
+TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsPoissonDisk(FSimpleMeshInfoPtr MeshInfo, float Density, float MinRadius, int32 Seed)
+{
+	const int32 NumTriangles = MeshInfo->Triangles.Length();
+	TArray<FOpenLandMeshPoint> PointList;
+	if (NumTriangles == 0)
+	{
+		return PointList;
+	}
+
+	// Cumulative areas let us pick a triangle by area with a binary search
+	TArray<double> CumulativeAreas;
+	CumulativeAreas.SetNumUninitialized(NumTriangles);
+	ParallelFor(NumTriangles, [&MeshInfo, &CumulativeAreas](int32 TriangleIndex)
 	{
 		const FOpenLandMeshTriangle MeshTriangle = MeshInfo->Triangles.Get(TriangleIndex);
-		const FVector P0 = MeshInfo->Vertices.Get(MeshTriangle.T0).Position;
+		CumulativeAreas[TriangleIndex] = FOpenLandPointTriangle::FindArea(
+			MeshInfo->Vertices.Get(MeshTriangle.T0).Position,
+			MeshInfo->Vertices.Get(MeshTriangle.T1).Position,
+			MeshInfo->Vertices.Get(MeshTriangle.T2).Position
+		);
+	});
+	for (int32 TriangleIndex = 1; TriangleIndex < NumTriangles; TriangleIndex++)
+	{
+		CumulativeAreas[TriangleIndex] += CumulativeAreas[TriangleIndex - 1];
+	}
+
+	const double TotalArea = CumulativeAreas.Last();
+	const int32 WantedPoints = FMath::FloorToInt(TotalArea/10000 * Density);
+	if (TotalArea <= 0 || WantedPoints <= 0)
+	{
+		return PointList;
+	}
+
+	// With cells of MinRadius, conflicting points can only be in the 27 cells around a point.
+	// Each cell keeps the last point added to it & points link to the previous one in the same cell.
+	const bool bCheckDistance = MinRadius > 0.0f;
+	const float MinRadiusSquared = MinRadius * MinRadius;
+	TMap<FIntVector, int32> CellHeads;
+	TArray<int32> NextInCell;
+	TArray<int32> SamplesInTriangle;
+	SamplesInTriangle.SetNumZeroed(NumTriangles);
+	CellHeads.Reserve(WantedPoints);
+	NextInCell.Reserve(WantedPoints);
+	PointList.Reserve(WantedPoints);
+
+	const auto ToCell = [MinRadius](const FVector& Position) -> FIntVector
+	{
+		return {
+			FMath::FloorToInt(Position.X / MinRadius),
+			FMath::FloorToInt(Position.Y / MinRadius),
+			FMath::FloorToInt(Position.Z / MinRadius)
+		};
+	};
+
+	const FRandomStream RandomStream(Seed);
+	const int64 MaxAttempts = static_cast<int64>(WantedPoints) * OpenLandPoissonDiskAttemptsPerPoint;
+	for (int64 Attempt = 0; Attempt < MaxAttempts && PointList.Num() < WantedPoints; Attempt++)
+	{
+		// FRand() only has 24 bits. That's not enough to reach small triangles of a mesh with millions of them.
+		const double HighBits = RandomStream.GetUnsignedInt();
+		const double LowBits = RandomStream.GetUnsignedInt();
+		const double AreaPick = (HighBits * 4294967296.0 + LowBits) / 18446744073709551616.0 * TotalArea;
+		const int32 TriangleIndex = FMath::Min(static_cast<int32>(Algo::UpperBound(CumulativeAreas, AreaPick)), NumTriangles - 1);
+		const FOpenLandMeshTriangle MeshTriangle = MeshInfo->Triangles.Get(TriangleIndex);
+		const FOpenLandMeshVertex T0 = MeshInfo->Vertices.Get(MeshTriangle.T0);
 		const FVector P1 = MeshInfo->Vertices.Get(MeshTriangle.T1).Position;
 		const FVector P2 = MeshInfo->Vertices.Get(MeshTriangle.T2).Position;
-		
-		const float Area = FOpenLandPointTriangle::FindArea(P0, P1, P2);
-		const float PointCountFromDensity = Area/10000 * Density;
-		int32 PointCount;
-		if (PointCountFromDensity >= 1)
-		{
-			PointCount = FMath::RoundToInt(PointCountFromDensity);
-		} else
-		{
-			PointCount = FMath::RandRange(0.0f, 1.0f) <= PointCountFromDensity? 1 : 0;
-		}
-		
-		if (PointCount <= 0)
+
+		// Uniform point on the triangle
+		const float SqrtR1 = FMath::Sqrt(RandomStream.FRand());
+		const float R2 = RandomStream.FRand();
+		const FVector NewPoint = T0.Position * (1.0f - SqrtR1) + P1 * (SqrtR1 * (1.0f - R2)) + P2 * (SqrtR1 * R2);
+
+		FIntVector NewCell = {0, 0, 0};
+		if (bCheckDistance)
 		{
-			continue;
+			NewCell = ToCell(NewPoint);
+			bool bFoundConflicts = false;
+			for (int32 X = -1; X <= 1 && !bFoundConflicts; X++)
+			{
+				for (int32 Y = -1; Y <= 1 && !bFoundConflicts; Y++)
+				{
+					for (int32 Z = -1; Z <= 1 && !bFoundConflicts; Z++)
+					{
+						const int32* Head = CellHeads.Find(NewCell + FIntVector(X, Y, Z));
+						for (int32 PointIndex = Head ? *Head : INDEX_NONE; PointIndex != INDEX_NONE; PointIndex = NextInCell[PointIndex])
+						{
+							if (FVector::DistSquared(PointList[PointIndex].Position, NewPoint) < MinRadiusSquared)
+							{
+								bFoundConflicts = true;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			if (bFoundConflicts)
+			{
+				continue;
+			}
 		}
-		
-		TArray<FOpenLandMeshPoint> LocalPoints = BuildPointsOnTriangle(MeshInfo, TriangleIndex, PointCount, MinRadius);
-		
-		// Add these points to the default list;
-		for(FOpenLandMeshPoint Point: LocalPoints)
+
+		const int32 NewPointIndex = PointList.Num();
+		if (bCheckDistance)
 		{
-			InstancingPoints.Push(Point);
+			int32& Head = CellHeads.FindOrAdd(NewCell, INDEX_NONE);
+			NextInCell.Push(Head);
+			Head = NewPointIndex;
 		}
+
+		FOpenLandMeshPoint Point;
+		Point.Position = NewPoint;
+		Point.Normal = T0.Normal;
+		Point.TangentX = T0.Tangent.TangentX;
+		Point.SourceIndex = TriangleIndex;
+		Point.SampleIndex = SamplesInTriangle[TriangleIndex]++;
+		PointList.Push(Point);
 	}
 
-	return InstancingPoints;
+	return PointList;
+}
+
+int32 FOpenLandPointsBuilder::MakeTriangleSeed(int32 Seed, int32 TriangleIndex)
+{
+	return static_cast<int32>(HashCombine(GetTypeHash(Seed), GetTypeHash(TriangleIndex)));
 }
 
 TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsUseOrigin(FSimpleMeshInfoPtr MeshInfo)
@@ -74,6 +300,7 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsPickVertices(FSimp
 		Point.Position = Vertex.Position;
 		Point.Normal = Vertex.Normal;
 		Point.TangentX = Vertex.Tangent.TangentX;
+		Point.SourceIndex = Index;
 		
 		PointsMap.Add(Vertex.Position, true);
 		PointList.Push(Point);
@@ -99,6 +326,7 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsPickCentroids(FSim
 		Point.Position = Centroid;
 		Point.Normal = T0.Normal;
 		Point.TangentX = T0.Tangent.TangentX;
+		Point.SourceIndex = TriangleIndex;
 
 		PointList.Push(Point);
 	}
@@ -127,6 +355,7 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsMoveToZAxis(FSimpl
 		MeshPoint.Position = Point;
 		MeshPoint.Normal = {0.0, 0.0, 1.0};
 		MeshPoint.TangentX = {1.0, 0.0, 0.0};
+		MeshPoint.SourceIndex = PointList.Num();
 
 		PointList.Push(MeshPoint);
 	}
@@ -155,6 +384,7 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsMoveToXAxis(FSimpl
 		MeshPoint.Position = Point;
 		MeshPoint.Normal = {0.0, 0.0, 1.0};
 		MeshPoint.TangentX = {1.0, 0.0, 0.0};
+		MeshPoint.SourceIndex = PointList.Num();
 
 		PointList.Push(MeshPoint);
 	}
@@ -183,6 +413,7 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsMoveToYAxis(FSimpl
 		MeshPoint.Position = Point;
 		MeshPoint.Normal = {0.0, 0.0, 1.0};
 		MeshPoint.TangentX = {1.0, 0.0, 0.0};
+		MeshPoint.SourceIndex = PointList.Num();
 
 		PointList.Push(MeshPoint);
 	}
@@ -190,7 +421,14 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsMoveToYAxis(FSimpl
 	return PointList;
 }
 
-TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimpleMeshInfoPtr MeshInfo, int32 TriangleIndex, int32 Count, float MinRadius)
+TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimpleMeshInfoPtr MeshInfo, int32 TriangleIndex, int32 Count, float MinRadius, const FRandomStream& RandomStream)
+{
+	TArray<int32> PointsInCellBuffer;
+	return BuildPointsOnTriangle(MeshInfo, TriangleIndex, Count, MinRadius, RandomStream, PointsInCellBuffer);
+}
+
+TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimpleMeshInfoPtr MeshInfo, int32 TriangleIndex, int32 Count, float MinRadius, const FRandomStream& RandomStream,
+                                                                         TArray<int32>& PointsInCellBuffer)
 {
 	const FVector ZVector = {0, 0, 1};
 	const FOpenLandMeshTriangle MeshTriangle = MeshInfo->Triangles.Get(TriangleIndex);
@@ -214,6 +452,7 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimple
 	// ----------------------------------------------------------------- //
 
 	TArray<FOpenLandMeshPoint> LocalPoints;
+	LocalPoints.Reserve(Count);
 	const float CellWidth = MinRadius / FMath::Sqrt(2);
 
 	// Calculate Points
@@ -223,7 +462,29 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimple
 	Grid.AddPoint(PointTriangle.C);
 	Grid.MakeBounds();
 
-	TMap<int32, int32> PointsInCell;
+	// Index of the point in each cell. Small triangles (the usual case) use a dense array.
+	const bool bUseDenseCells = Grid.GetTotalCellCount() <= OpenLandMaxDenseGridCells;
+	TArray<int32>& DensePointsInCell = PointsInCellBuffer;
+	TMap<int32, int32> SparsePointsInCell;
+	if (bUseDenseCells && DensePointsInCell.Num() < Grid.GetTotalCellCount())
+	{
+		// The buffer only grows & we clear the cells we used before returning.
+		// So, only the new cells need to be initialized.
+		const int32 OldNumCells = DensePointsInCell.Num();
+		DensePointsInCell.SetNumUninitialized(Grid.GetTotalCellCount(), false);
+		FMemory::Memset(DensePointsInCell.GetData() + OldNumCells, 0xff, (DensePointsInCell.Num() - OldNumCells) * sizeof(int32));
+	}
+
+	const auto FindPointInCell = [bUseDenseCells, &DensePointsInCell, &SparsePointsInCell](int32 CellId) -> int32
+	{
+		if (bUseDenseCells)
+		{
+			return DensePointsInCell[CellId];
+		}
+
+		const int32* PointIndex = SparsePointsInCell.Find(CellId);
+		return PointIndex == nullptr ? INDEX_NONE : *PointIndex;
+	};
 
 	// We need iterations more than "Count" to get those number of points
 	// That's because we can continue to the loop for various reasons
@@ -236,37 +497,28 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimple
 		}
 		
 		// Find a random point on the triangle
-		FVector NewPoint = PointTriangle.FindRandomPoint(MinRadius/2.0f);
+		FVector NewPoint = PointTriangle.FindRandomPoint(RandomStream, MinRadius/2.0f);
 		
 		// Find the cell of that point
 		int32 NewCellId = Grid.FindCellId(NewPoint);
 
 		// If there's a point on the cell continue
-		if (PointsInCell.Find(NewCellId) != nullptr)
+		if (FindPointInCell(NewCellId) != INDEX_NONE)
 		{
 			continue;
 		}
 		
-		// Get cells around the new point
-		TArray<int32> CellsAround = Grid.FindCellsAround(NewCellId, 2);
-		
-		// Check all the points on those cells for minradius conflicts
+		// Check all the points on cells around the new point for minradius conflicts
 		bool bFoundConflicts = false;
-		for(const int32 CellIndex: CellsAround)
+		Grid.ForEachCellAround(NewCellId, 2, [&](int32 CellIndex)
 		{
-			if (PointsInCell.Find(CellIndex) == nullptr)
-			{
-				continue;
-			}
-
-			FVector PointInCell = LocalPoints[PointsInCell[CellIndex]].Position;
-			float Distance = FVector::Distance(PointInCell, NewPoint);
-			if (Distance <= MinRadius)
+			const int32 PointIndex = FindPointInCell(CellIndex);
+			if (PointIndex != INDEX_NONE && FVector::DistSquared(LocalPoints[PointIndex].Position, NewPoint) <= MinRadius * MinRadius)
 			{
 				bFoundConflicts = true;
-				break;
 			}
-		}
+			return !bFoundConflicts;
+		});
 
 		// Continue, if there are conflicts
 		if (bFoundConflicts)
@@ -275,12 +527,27 @@ TArray<FOpenLandMeshPoint> FOpenLandPointsBuilder::BuildPointsOnTriangle(FSimple
 		}
 		
 		// If not add that point
-		PointsInCell.Add(Grid.FindCellId(NewPoint), LocalPoints.Num());
+		if (bUseDenseCells)
+		{
+			DensePointsInCell[NewCellId] = LocalPoints.Num();
+		} else
+		{
+			SparsePointsInCell.Add(NewCellId, LocalPoints.Num());
+		}
 		LocalPoints.Push({NewPoint, ZVector});
 	}
 	
 	// ----------------------------------------------------------------- //
 
+	// Only the cells we filled need to be cleared for the next triangle
+	if (bUseDenseCells)
+	{
+		for (const FOpenLandMeshPoint& Point: LocalPoints)
+		{
+			DensePointsInCell[Grid.FindCellId(Point.Position)] = INDEX_NONE;
+		}
+	}
+
 	// Bring Points to the Desired Place
 	const FOpenLandUpVectorSwitcher SwitchToOriginalPlane(ZVector, FaceNormal);
 	for(FOpenLandMeshPoint &Point: LocalPoints)
@@ -5,15 +5,17 @@
 #include "CoreMinimal.h"
 #include "OpenLandMeshActor.h"
 #include "Engine/StaticMeshActor.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
 #include "GameFramework/Actor.h"
 #include "Utils/OpenLandPointsBuilder.h"
 #include "OpenLandInstancingController.generated.h"
 
+// These are flags, so requests of the same owner within a frame can be merged into one payload
 enum EOpenLandSpawningRegistrationAction
 {
-	OSC_SET_POINTS,
-	OSC_UNREGISTER,
-	OSC_UPDATE_TRANSFORM
+	OSC_SET_POINTS = 1 << 0,
+	OSC_UNREGISTER = 1 << 1,
+	OSC_UPDATE_TRANSFORM = 1 << 2
 };
 
 USTRUCT()
@@ -21,6 +23,11 @@ struct FOpenLandInstancingRequestPoint
 {
 	GENERATED_BODY()
 
+	// Stable across re-applies as long as the point comes from the same rule, source & sample.
+	// See FOpenLandPointUtils::MakePointId()
+	UPROPERTY()
+	int64 PointId = 0;
+
 	UPROPERTY()
 	FVector Position;
 
@@ -53,19 +60,58 @@ struct FOpenLandInstancingRequestPoint
 
 	UPROPERTY();
 	bool bUseLocalRandomDisplacement = true;
+
+	bool HasSameTransform(const FOpenLandInstancingRequestPoint& Other) const
+	{
+		return Position == Other.Position && Normal == Other.Normal && TangentX == Other.TangentX &&
+			RandomScale == Other.RandomScale && RandomRotation == Other.RandomRotation &&
+			RandomDisplacement == Other.RandomDisplacement &&
+			bUseLocalRandomRotation == Other.bUseLocalRandomRotation &&
+			bUseLocalRandomDisplacement == Other.bUseLocalRandomDisplacement;
+	}
 };
 
 struct FOpenLandInstancingRequest
 {
-	FString OwnerId;
+	FGuid OwnerId;
 	TArray<FOpenLandInstancingRequestPoint> NewPoints;
 	FTransform ComponentTransform;
 };
 
 struct FOpenLandInstancingRequestPayload
 {
-	FString OwnerId;
-	EOpenLandSpawningRegistrationAction Action;
+	FGuid OwnerId;
+	// A combination of EOpenLandSpawningRegistrationAction
+	uint8 Actions = 0;
+	// Only used to process the nearest owners first
+	float DistanceSquared = 0;
+};
+
+// Part of the instance transform which only depends on the point. It's calculated once per point.
+// Then moving the owner only costs a few multiplications per instance.
+USTRUCT()
+struct FOpenLandInstancingPointTransform
+{
+	GENERATED_BODY()
+
+	UPROPERTY();
+	FQuat LocalRotation = FQuat::Identity;
+
+	UPROPERTY();
+	FVector Position = FVector::ZeroVector;
+
+	// For local displacements, this is already rotated with LocalRotation
+	UPROPERTY();
+	FVector Displacement = FVector::ZeroVector;
+
+	UPROPERTY();
+	bool bLocalDisplacement = true;
+
+	UPROPERTY();
+	FVector Scale = FVector::OneVector;
+
+	UPROPERTY();
+	bool bIsValid = false;
 };
 
 USTRUCT()
@@ -74,10 +120,82 @@ struct FOpenLandInstancedActorInfo
 	GENERATED_BODY()
 
 	UPROPERTY();
-	AActor* Actor;
+	AActor* Actor = nullptr;
 
 	UPROPERTY();
 	FOpenLandInstancingRequestPoint OriginalPoint;
+
+	UPROPERTY();
+	FOpenLandInstancingPointTransform PointTransform;
+
+	// Actors are spawned within the frame budget. Until then, Actor is nullptr.
+	UPROPERTY();
+	bool bPendingSpawn = false;
+};
+
+USTRUCT()
+struct FOpenLandInstancedStaticMeshInfo
+{
+	GENERATED_BODY()
+
+	UPROPERTY();
+	int32 MeshGroupIndex = INDEX_NONE;
+
+	// Index inside the HISM component. This changes when other instances of the same component are removed.
+	UPROPERTY();
+	int32 InstanceIndex = INDEX_NONE;
+
+	UPROPERTY();
+	FOpenLandInstancingRequestPoint OriginalPoint;
+
+	UPROPERTY();
+	FOpenLandInstancingPointTransform PointTransform;
+};
+
+USTRUCT()
+struct FOpenLandInstancedStaticMeshOwnerRef
+{
+	GENERATED_BODY()
+
+	UPROPERTY();
+	FGuid OwnerId;
+
+	// Index inside FOpenLandInstancedActorGroup::StaticMeshInstances of the owner
+	UPROPERTY();
+	int32 OwnerSlot = INDEX_NONE;
+};
+
+// All the instances of a static mesh with the same collision setting, across all owners
+USTRUCT()
+struct FOpenLandInstancedStaticMeshGroup
+{
+	GENERATED_BODY()
+
+	UPROPERTY();
+	UStaticMesh* StaticMesh = nullptr;
+
+	UPROPERTY();
+	bool bEnableCollisions = true;
+
+	UPROPERTY();
+	UHierarchicalInstancedStaticMeshComponent* Component = nullptr;
+
+	// World transforms of instances in the same order as the component.
+	// Changes are sent to the component in a batch at the end of the tick.
+	UPROPERTY();
+	TArray<FTransform> InstanceTransforms;
+
+	UPROPERTY();
+	TArray<FOpenLandInstancedStaticMeshOwnerRef> InstanceOwners;
+
+	int32 DirtyStartIndex = MAX_int32;
+	int32 DirtyEndIndex = 0;
+
+	void MarkDirty(int32 InstanceIndex)
+	{
+		DirtyStartIndex = FMath::Min(DirtyStartIndex, InstanceIndex);
+		DirtyEndIndex = FMath::Max(DirtyEndIndex, InstanceIndex + 1);
+	}
 };
 
 USTRUCT()
@@ -88,15 +206,35 @@ struct FOpenLandInstancedActorGroup
 	UPROPERTY();
 	TArray<FOpenLandInstancedActorInfo> SpawnedActors;
 
+	// Static meshes are not spawned as actors. They are instances of the shared HISM components.
+	UPROPERTY();
+	TArray<FOpenLandInstancedStaticMeshInfo> StaticMeshInstances;
+
 	UPROPERTY();
 	bool bAllowCleaning = true;
+
+	// Owner transform used for the current placement. Instances need to be placed again when it's different.
+	UPROPERTY();
+	FTransform PlacedTransform;
+
+	UPROPERTY();
+	bool bHasPlacedTransform = false;
+
+	// Pending actors are kept at the end of SpawnedActors, nearest to the camera first.
+	// Actors before this index are already spawned.
+	int32 NextPendingSpawn = 0;
+	int32 NumPendingSpawns = 0;
 };
 
-struct AOpenLandInstancingTransformedInfo
+// Work done by the last SetPoints() call
+struct FOpenLandInstancingApplyStats
 {
-	FVector Position;
-	FRotator Rotator;
-	FVector Scale;
+	int32 Added = 0;
+	int32 Moved = 0;
+	int32 Removed = 0;
+	int32 Unchanged = 0;
+
+	int32 NumOperations() const { return Added + Moved + Removed; }
 };
 
 UCLASS()
@@ -104,16 +242,38 @@ class OPENLANDMESH_API AOpenLandInstancingController : public AActor
 {
 	GENERATED_BODY()
 
-	static TMap<FString, FOpenLandInstancingRequest> RequestsRegistry;
+	static TMap<FGuid, FOpenLandInstancingRequest> RequestsRegistry;
 	static TArray<FOpenLandInstancingRequestPayload> RequestsToUpdate;
-	static AOpenLandInstancingController* Singleton;
-
-	float RemainingTimeToCleanUp = 0.0f;
-
+	// Index of the pending payload of each owner inside RequestsToUpdate
+	static TMap<FGuid, int32> PendingRequestIndices;
+
+	FOpenLandInstancingApplyStats LastApplyStats;
+	TSet<FGuid> OwnersWithPendingSpawns;
+	int32 NumPendingStaticMeshInstances = 0;
+	double FrameStartedAt = 0;
+	FVector CameraLocation = FVector::ZeroVector;
+	bool bHasCameraLocation = false;
+
+	static void QueueRequest(const FGuid& OwnerId, EOpenLandSpawningRegistrationAction Action);
+	static void RequeueRequests(const TArray<FOpenLandInstancingRequestPayload>& Requests, int32 StartIndex);
+	bool HasFrameBudget() const;
+	void UpdateCameraLocation();
+	bool FindOwnerTransform(const FGuid& OwnerId, FTransform& OwnerTransform) const;
+	void ProcessRequest(const FOpenLandInstancingRequestPayload& UpdatePayload);
+	void SpawnInstanceActor(FOpenLandInstancedActorInfo& ActorInfo, const FTransform& OwnerTransform);
+	void SpawnPendingActors();
 	void SetPoints(FOpenLandInstancingRequest& Registration);
-	void RemovePoints(FString OwnerId);
+	void RemovePoints(const FGuid& OwnerId);
 	void UpdatePointTransform(FOpenLandInstancingRequest& Registration);
-	static AOpenLandInstancingTransformedInfo ApplyTransformation(FOpenLandInstancingRequestPoint Point, FTransform Transform);
+	static FOpenLandInstancingPointTransform PrepareTransformation(const FOpenLandInstancingRequestPoint& Point);
+	static FTransform ApplyTransformation(const FOpenLandInstancingPointTransform& PointTransform, const FTransform& Transform);
+	int32 FindOrAddStaticMeshGroup(UStaticMesh* StaticMesh, bool bEnableCollisions);
+	void AddStaticMeshInstance(const FGuid& OwnerId, FOpenLandInstancedActorGroup& OwnerGroup, const FOpenLandInstancingRequestPoint& Point, const FTransform& OwnerTransform);
+	void SetStaticMeshInstanceTransform(const FOpenLandInstancedStaticMeshInfo& InstanceInfo, const FTransform& Transform);
+	void RemoveStaticMeshInstance(const FOpenLandInstancedStaticMeshInfo& InstanceInfo);
+	void RemoveStaticMeshInstances(FOpenLandInstancedActorGroup& OwnerGroup, const TArray<int32>& OwnerSlots);
+	void RemoveAllStaticMeshInstances(FOpenLandInstancedActorGroup& OwnerGroup);
+	void FlushStaticMeshGroups();
 	
 public:
 	// Sets default values for this actor's properties
@@ -123,24 +283,45 @@ public:
 	static void UpdateTransforms(AOpenLandMeshActor* Owner);
 	static void Unregister(AOpenLandMeshActor* Owner);
 
+	// Owners are identified with these ids across all the registries.
+	// Strings are only used for ids saved by earlier versions.
+	static FGuid MakeOwnerId();
+	static FGuid OwnerIdFromString(const FString& SavedId);
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
+	virtual void PostLoad() override;
+	virtual void PostRegisterAllComponents() override;
+	virtual void Destroyed() override;
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 	virtual bool ShouldTickIfViewportsOnly() const override;
 
 	UPROPERTY()
-	TMap<FString, FOpenLandInstancedActorGroup> InstancedGroupsMap;
+	TMap<FGuid, FOpenLandInstancedActorGroup> InstancedGroups;
 
 	UPROPERTY()
-	TMap<FString, AOpenLandMeshActor*> ChildMeshActors;
+	TMap<FGuid, AOpenLandMeshActor*> ChildMeshes;
 
+	// Saved with string ids by earlier versions. These are moved to the maps above on load.
+	UPROPERTY()
+	TMap<FString, FOpenLandInstancedActorGroup> InstancedGroupsMap_DEPRECATED;
+
+	UPROPERTY()
+	TMap<FString, AOpenLandMeshActor*> ChildMeshActors_DEPRECATED;
+
+	UPROPERTY()
+	TArray<FOpenLandInstancedStaticMeshGroup> StaticMeshGroups;
+
+	// Maximum time spent on instancing work in a single frame. Work is done for the nearest owners first.
+	// Set this to zero to do all the work in the frame it's requested.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="OpenLandMesh Instancing")
-	float InstanceCleaningInterval = 2;
-	
+	float FrameBudgetMs = 4.0f;
+
 	UFUNCTION(CallInEditor, BlueprintCallable, Category="OpenLandMesh Instancing")
 	void CleanUnlinkedInstances();
 	
@@ -156,6 +337,13 @@ public:
 	UFUNCTION(CallInEditor, BlueprintCallable, Category="OpenLandMesh Instancing")
 	void RemoveChildMeshActors();
 
+	// Static mesh instances are not included, since they are not actors
 	UFUNCTION(BlueprintCallable, Category="OpenLandMesh Instancing")
 	static TArray<AActor*> GetInstancesForOwner(AOpenLandMeshActor* OwnerMesh);
+
+	const FOpenLandInstancingApplyStats& GetLastApplyStats() const { return LastApplyStats; }
+
+	// Actors & static mesh instances still waiting for the frame budget
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh Instancing")
+	int32 GetNumPendingInstances() const;
 };
@@ -20,7 +20,8 @@ enum EOpenLandInstancingRuleSamplingAlgorithm
 	IRSA_ORIGIN=3 UMETA(DisplayName="Use Origin"),
 	IRSA_MOVE_TO_X_AXIS=4 UMETA(DisplayName="Move to X Axis"),
 	IRSA_MOVE_TO_Y_AXIS=5 UMETA(DisplayName="Move to Y Axis"),
-	IRSA_MOVE_TO_Z_AXIS=6 UMETA(DisplayName="Move to Z Axis")
+	IRSA_MOVE_TO_Z_AXIS=6 UMETA(DisplayName="Move to Z Axis"),
+	IRSA_POISSON_DISK=7 UMETA(DisplayName="Poisson Disk (Whole Mesh)")
 };
 
 UENUM(BlueprintType)
@@ -104,11 +105,15 @@ struct FOpenLandInstancingRules
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing")
 	TEnumAsByte<EOpenLandInstancingRuleSamplingAlgorithm> SamplingAlgorithm = IRSA_MODIFIED_POISSON_2D;
+
+	// Combined with the InstancingSeed of the actor. The same mesh, rules & seeds always give the same instances.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing")
+	int32 Seed = 0;
 	
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing", meta = (EditCondition = "SamplingAlgorithm==0"))
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing", meta = (EditCondition = "SamplingAlgorithm==0 || SamplingAlgorithm==7"))
 	float Density = 10;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing", meta = (EditCondition = "SamplingAlgorithm==0"))
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing", meta = (EditCondition = "SamplingAlgorithm==0 || SamplingAlgorithm==7"))
 	float MinimumDistance = 10;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing", meta = (EditCondition = "SamplingAlgorithm!=3"))
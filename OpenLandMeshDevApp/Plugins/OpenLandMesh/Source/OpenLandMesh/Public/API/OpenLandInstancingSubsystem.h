@@ -0,0 +1,42 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "OpenLandInstancingSubsystem.generated.h"
+
+class AOpenLandMeshActor;
+class AOpenLandInstancingController;
+
+/**
+ * Keeps track of the instancing controller & the OpenLandMesh actors of a world.
+ * Actors register & unregister themselves with their lifecycle events. So, we never need to scan the world for them.
+ */
+UCLASS()
+class OPENLANDMESH_API UOpenLandInstancingSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	AOpenLandInstancingController* Controller = nullptr;
+
+	TMap<FGuid, TWeakObjectPtr<AOpenLandMeshActor>> Owners;
+	// Owners deleted in the editor. The controller removes their instances on the next tick.
+	TArray<FGuid> RemovedOwnerIds;
+
+public:
+	virtual void Deinitialize() override;
+
+	void RegisterController(AOpenLandInstancingController* NewController);
+	void UnregisterController(AOpenLandInstancingController* OldController);
+	AOpenLandInstancingController* GetController() const { return Controller; }
+	AOpenLandInstancingController* GetOrSpawnController();
+
+	void RegisterOwner(AOpenLandMeshActor* Owner);
+	void UnregisterOwner(AOpenLandMeshActor* Owner, bool bRemoveInstances);
+	bool IsOwnerRegistered(const FGuid& OwnerId) const { return Owners.Contains(OwnerId); }
+	AOpenLandMeshActor* FindOwner(const FGuid& OwnerId) const;
+	TArray<AOpenLandMeshActor*> GetOwners() const;
+	TArray<FGuid> ConsumeRemovedOwnerIds();
+};
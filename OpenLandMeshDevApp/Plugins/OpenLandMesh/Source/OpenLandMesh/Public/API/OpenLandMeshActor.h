@@ -49,6 +49,13 @@ struct FLODInfo
 
 		return true;
 	}
+
+	// Until we modify it, the Target is the same mesh info other actors got from the cache.
+	// So, they can render it with the same GPU buffers.
+	bool CanShareRenderData() const
+	{
+		return !bIsModifyReady && !MeshBuildResult->CacheKey.IsEmpty();
+	}
 };
 
 struct FSwitchLODsStatus
@@ -69,7 +76,11 @@ class OPENLANDMESH_API AOpenLandMeshActor : public AActor
 	FOpenLandPolygonMeshModifyStatus ModifyStatus = {};
 
 	UPROPERTY(NonPIEDuplicateTransient);
-	FString ObjectId;
+	FGuid ObjectGuid;
+
+	// String id saved by earlier versions
+	UPROPERTY(NonPIEDuplicateTransient);
+	FString ObjectId_DEPRECATED;
 	
 	TArray<FLODInfoPtr> LODList;
 	FLODInfoPtr CurrentLOD = nullptr;
@@ -77,18 +88,36 @@ class OPENLANDMESH_API AOpenLandMeshActor : public AActor
 	int32 AsyncBuildingLODIndex = -1;
 
 	void RunAsyncModifyMeshProcess(float LastFrameTime);
+	FOpenLandPolygonMeshModifyOptions MakeAsyncModifyOptions(float LastFrameTime) const;
 	void RunSyncModifyMeshProcess();
 	FSwitchLODsStatus SwitchLODs();
 	void EnsureLODVisibility();
-	FString MakeCacheKey(int32 CurrentSubdivisions) const;
+	FString MakeCacheKey(const FOpenLandPolygonMeshBuildOptions& BuildMeshOptions) const;
 	void MakeModifyReady();
 	void FinishBuildMeshAsync();
 	bool CanRenderMesh() const;
+	void SetupCollisionMesh();
+	void OnMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+	// Returns nullptr while the source is prepared on a worker. SetupCollisionMesh() is called again once it's ready.
+	FSimpleMeshInfoPtr FindCollisionSource(bool& bIsDeformable);
+	void BuildCollisionMeshAsync();
+	void PickCollisionSourceAsync(const TArray<FOpenLandPolygonMeshBuildResultPtr>& Candidates);
+	void ResetCollisionWork();
+
+	// Mesh built just for collisions, when there's no render LOD with the CollisionSubDivisions
+	FOpenLandPolygonMeshBuildResultPtr CollisionBuildResult = nullptr;
+	bool bCollisionBuildInProgress = false;
+	// Collision LOD picked by the CollisionMaxError & the LOD targets it was picked from
+	FSimpleMeshInfoPtr PickedCollisionSource = nullptr;
+	TArray<FSimpleMeshInfoPtr> CollisionPickCandidates;
+	bool bCollisionPickInProgress = false;
+	// Results of collision work started before this changed are ignored
+	int32 CollisionWorkId = 0;
 
 public:
 	AOpenLandMeshActor();
 	~AOpenLandMeshActor();
-	FString GetObjectId() const { return ObjectId; }
+	const FGuid& GetObjectId() const { return ObjectGuid; }
 
 protected:
 	UPROPERTY(Transient)
@@ -96,6 +125,9 @@ protected:
 
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void PostRegisterAllComponents() override;
+	virtual void Destroyed() override;
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category="OpenLandMesh")
 	UOpenLandMeshPolygonMeshProxy* GetPolygonMesh();
@@ -113,9 +145,15 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 	virtual void OnConstruction(const FTransform& Transform) override;
+	virtual void PostLoad() override;
 	void SetMaterial(UMaterialInterface* Material);
 	virtual bool ShouldTickIfViewportsOnly() const override;
 
+	// These are used by the UOpenLandMeshAnimationSubsystem to hand out animation frames within the frame budget
+	bool CanRunAnimationFrame() const;
+	void RunAnimationFrame(float DeltaTime);
+	bool IsAnimationFrameInProgress() const { return ModifyStatus.bStarted; }
+
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 #endif
@@ -151,6 +189,11 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=OpenLandMesh)
 	bool bUseAsyncBuildMeshOnGame = false;
 
+	// When GetCacheKey() is empty, build results are cached with a hash of the mesh content & the build options.
+	// Actors with CPU vertex modifiers are not cached this way, since we cannot hash the modifier.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=OpenLandMesh)
+	bool bUseContentCacheKey = true;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=OpenLandMesh)
 	bool bEnableCollision = true;
 
@@ -181,11 +224,25 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh LODs")
 	int32 LODIndexForCollisions = -1;
 
+	// Subdivisions used to build the collision mesh. Set -1 to pick the coarsest LOD within CollisionMaxError.
+	// This is only used when LODIndexForCollisions is -1.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh LODs")
+	int32 CollisionSubDivisions = -1;
+
+	// Maximum distance (in cm) allowed between the finest LOD & the automatically picked collision LOD
+	// With bAnimate, we always use the current LOD instead since that's the only LOD we animate.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh LODs")
+	float CollisionMaxError = 10.0f;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing")
 	TArray<FOpenLandInstancingRules> InstancingGroups;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing")
 	bool bRunInstancingAfterBuildMesh = true;
+
+	// Change this to get a different layout of instances from the same rules
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="OpenLandMesh Instancing")
+	int32 InstancingSeed = 0;
 	
 	UFUNCTION(CallInEditor, BlueprintCallable, Category=OpenLandMesh)
 	void BuildMesh();
@@ -0,0 +1,103 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "OpenLandMeshAnimationSubsystem.generated.h"
+
+class AOpenLandMeshActor;
+
+USTRUCT(BlueprintType)
+struct FOpenLandMeshAnimationStatus
+{
+	GENERATED_BODY()
+
+	// Seconds the scheduler currently waits between two animation frames of this actor
+	UPROPERTY(BlueprintReadOnly, Category="OpenLandMesh Animation")
+	float UpdateInterval = 0;
+
+	// How long this actor has been waiting after it became due (because of the frame budget)
+	UPROPERTY(BlueprintReadOnly, Category="OpenLandMesh Animation")
+	float SecondsBehind = 0;
+
+	// Number of frames this actor was due, but skipped because of the frame budget
+	UPROPERTY(BlueprintReadOnly, Category="OpenLandMesh Animation")
+	int32 FramesBehind = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category="OpenLandMesh Animation")
+	float ScreenSize = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category="OpenLandMesh Animation")
+	float Priority = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category="OpenLandMesh Animation")
+	bool bRecentlyRendered = false;
+};
+
+struct FOpenLandMeshAnimatedActorInfo
+{
+	TWeakObjectPtr<AOpenLandMeshActor> Actor;
+	double LastUpdatedAt = 0;
+	FOpenLandMeshAnimationStatus Status = {};
+};
+
+/**
+ * Owns all the animated OpenLandMesh actors in a game world & hands out animation frames to them.
+ * Actors are prioritised by their screen size & whether they were rendered recently.
+ * Sync frames stop once the FrameBudgetMs is used. Async frames only dispatch work here, so they are limited by
+ * the number of frames running on workers instead. Either way, the cost does not grow with the actor count.
+ * Tunables are read from the [/Script/OpenLandMesh.OpenLandMeshAnimationSubsystem] section of the game config.
+ */
+UCLASS(Config=Game)
+class OPENLANDMESH_API UOpenLandMeshAnimationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+	TArray<FOpenLandMeshAnimatedActorInfo> AnimatedActors;
+
+	FOpenLandMeshAnimatedActorInfo* FindActorInfo(const AOpenLandMeshActor* Actor);
+	void UpdatePriority(FOpenLandMeshAnimatedActorInfo& Info, const FVector& CameraLocation, bool bHasCamera) const;
+
+public:
+	// Maximum time spent on running sync animation frames in a single game frame
+	UPROPERTY(Config, BlueprintReadWrite, Category="OpenLandMesh Animation")
+	float FrameBudgetMs = 2.0f;
+
+	// Maximum async animation frames running on workers at once. Zero means, the job system's concurrency.
+	UPROPERTY(Config, BlueprintReadWrite, Category="OpenLandMesh Animation")
+	int32 MaxFramesInFlight = 0;
+
+	// Actors covering at least this much of the screen (sphere radius / distance) animate every frame
+	UPROPERTY(Config, BlueprintReadWrite, Category="OpenLandMesh Animation")
+	float FullRateScreenSize = 0.1f;
+
+	// Update interval used for the smallest visible actors. Bigger ones are interpolated towards zero.
+	UPROPERTY(Config, BlueprintReadWrite, Category="OpenLandMesh Animation")
+	float DistantUpdateInterval = 0.1f;
+
+	// Update interval used for actors not rendered recently
+	UPROPERTY(Config, BlueprintReadWrite, Category="OpenLandMesh Animation")
+	float OffscreenUpdateInterval = 0.5f;
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	void RegisterActor(AOpenLandMeshActor* Actor);
+	void UnregisterActor(AOpenLandMeshActor* Actor);
+
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh Animation")
+	FOpenLandMeshAnimationStatus GetAnimationStatus(AOpenLandMeshActor* Actor);
+
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh Animation")
+	int32 NumAnimatedActors() const { return AnimatedActors.Num(); }
+
+	//~ Begin FTickableGameObject Interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual bool IsTickableInEditor() const override { return false; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//~ End FTickableGameObject Interface
+};
@@ -5,10 +5,22 @@
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
 #include "Misc/SecureHash.h"
+#include "Types/OpenLandMeshInfo.h"
 #include "OpenLandMeshHash.generated.h"
 
+UENUM(BlueprintType)
+enum EOpenLandMeshHashMode
+{
+	// Keeps the keys generated by earlier versions. Values are added as strings.
+	OLMHM_SHA1 = 0 UMETA(DisplayName="SHA-1 (Compatible)"),
+	OLMHM_FAST64 = 1 UMETA(DisplayName="Fast 64-bit"),
+	OLMHM_FAST128 = 2 UMETA(DisplayName="Fast 128-bit"),
+};
+
 /**
- * 
+ * Generates a hex key from a set of values.
+ * SHA-1 mode adds numbers as strings, so the keys match earlier versions.
+ * Fast modes use CityHash over the binary values & are meant for large inputs like mesh buffers.
  */
 UCLASS()
 class OPENLANDMESH_API UOpenLandMeshHash : public UObject
@@ -19,12 +31,43 @@ class OPENLANDMESH_API UOpenLandMeshHash : public UObject
 	FSHA1 Hash;
 	bool bIsNull = true;
 	bool bCompleted = false;
+	TEnumAsByte<EOpenLandMeshHashMode> Mode = OLMHM_SHA1;
+
+	// Small values are collected here & hashed in chunks in fast modes. Hashing each of them separately is slow.
+	TArray<uint8> PendingBytes;
+	uint64 FastHashLow = 0;
+	uint64 FastHashHigh = 0;
+
+	void UpdateFastHash(const uint8* Data, int64 Size);
+	void FlushPendingBytes();
 
 	public:
 
 	UOpenLandMeshHash();
 
 	bool IsNull() const;
+
+	// Binary updates. In SHA-1 mode, these are hashed as is too. So, they won't match string based keys.
+	UOpenLandMeshHash* AddBytes(const void* Data, int64 Size);
+
+	template <typename T>
+	UOpenLandMeshHash* AddValue(const T& Value)
+	{
+		return AddBytes(&Value, sizeof(T));
+	}
+
+	template <typename T>
+	UOpenLandMeshHash* AddArray(TArrayView<const T> Values)
+	{
+		return AddBytes(Values.GetData(), static_cast<int64>(Values.Num()) * sizeof(T));
+	}
+
+	// Adds positions, normals, UVs & triangles of the mesh without copying them
+	UOpenLandMeshHash* AddMeshInfo(const FOpenLandMeshInfo* MeshInfo);
+
+	// This must be called before adding any values
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
+	UOpenLandMeshHash* SetMode(TEnumAsByte<EOpenLandMeshHashMode> NewMode);
 	
 	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
 	UOpenLandMeshHash* AddString(FString Value);
@@ -38,9 +81,18 @@ class OPENLANDMESH_API UOpenLandMeshHash : public UObject
 	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
 	UOpenLandMeshHash* AddVector(FVector Value);
 
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
+	UOpenLandMeshHash* AddIntegerArray(const TArray<int32>& Values);
+
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
+	UOpenLandMeshHash* AddFloatArray(const TArray<float>& Values);
+
+	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
+	UOpenLandMeshHash* AddVectorArray(const TArray<FVector>& Values);
+
 	UFUNCTION(BlueprintCallable, Category="OpenLandMesh")
 	FString Generate();
 
 	UFUNCTION(BlueprintCallable, Category=OpenLandMesh)
-	static UOpenLandMeshHash* MakeHash();
+	static UOpenLandMeshHash* MakeHash(TEnumAsByte<EOpenLandMeshHashMode> HashMode = OLMHM_SHA1);
 };
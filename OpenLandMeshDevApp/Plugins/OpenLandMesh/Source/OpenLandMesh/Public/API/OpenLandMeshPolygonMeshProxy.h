@@ -11,13 +11,6 @@
 #include "UObject/Object.h"
 #include "OpenLandMeshPolygonMeshProxy.generated.h"
 
-struct FOpenLandBuildMeshResultCacheInfo {
-	FString CacheKey;
-	FOpenLandPolygonMeshBuildResultPtr MeshBuildResult;
-	FDateTime CachedAt;
-	FDateTime LastCacheHitAt;
-	TArray<std::function<void(FOpenLandPolygonMeshBuildResultPtr)>> AsyncMeshBuildCallbacks;
-};
 /**
  * 
  */
@@ -26,8 +19,7 @@ class OPENLANDMESH_API UOpenLandMeshPolygonMeshProxy : public UObject
 {
 	GENERATED_BODY()
 
-	FOpenLandPolygonMesh* PolygonMesh;
-	static TMap<FString, FOpenLandBuildMeshResultCacheInfo> CachedBuildMesh;
+	FOpenLandPolygonMeshPtr PolygonMesh;
 
 public:
 	UOpenLandMeshPolygonMeshProxy();
@@ -36,6 +28,9 @@ public:
 	FOpenLandPolygonMeshBuildResultPtr BuildMesh(UObject* WorldContext, FOpenLandPolygonMeshBuildOptions Options, FString CacheKey="") const;
 	void BuildMeshAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildOptions Options,
 	                    std::function<void(FOpenLandPolygonMeshBuildResultPtr)> Callback, FString CacheKey="") const;
+	// Results built without a cache key come without the Target. This creates it without a modify call.
+	void BuildTargetAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult, FOpenLandPolygonMeshBuildOptions Options,
+	                      std::function<void()> Callback) const;
 	void ModifyVertices(::UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
 	                    FOpenLandPolygonMeshModifyOptions Options) const;
 	// Here we do vertex modifications outside of the game thread
@@ -48,6 +43,8 @@ public:
 	void RegisterVertexModifier(function<FVertexModifierResult(FVertexModifierPayload)> Callback);
 	FGpuComputeMaterialStatus RegisterGpuVertexModifier(FComputeMaterial VertexModifier);
 	int32 CalculateVerticesForSubdivision(int32 Subdivision) const;
+	// A cache key made from the content of the mesh & the options. This is empty if the mesh has a CPU vertex modifier.
+	FString MakeContentCacheKey(FOpenLandPolygonMeshBuildOptions Options) const;
 	UOpenLandMeshPolygonMeshProxy* AddTriFace(const FOpenLandMeshVertex A, const FOpenLandMeshVertex B, const FOpenLandMeshVertex C);
 	UOpenLandMeshPolygonMeshProxy* AddQuadFace(const FOpenLandMeshVertex A, const FOpenLandMeshVertex B, const FOpenLandMeshVertex C, const FOpenLandMeshVertex D);
 	static FVector2D RegularPolygonPositionToUV(FVector Position, float Radius);
@@ -86,4 +83,11 @@ public:
 	
 	UFUNCTION(BlueprintCallable, Category=OpenLandMesh)
 	static void ClearCache();
+
+	// Memory allowed for the in-memory build cache. Entries pinned by live LODs may keep it above this for a while.
+	UFUNCTION(BlueprintCallable, Category=OpenLandMesh)
+	static void SetCacheBudget(int32 MegaBytes);
+
+	UFUNCTION(BlueprintCallable, Category=OpenLandMesh)
+	static int32 GetCacheBudget();
 };
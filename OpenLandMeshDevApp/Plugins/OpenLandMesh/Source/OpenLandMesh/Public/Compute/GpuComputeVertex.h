@@ -26,7 +26,7 @@ struct FGpuComputeVertexOutput
 struct FGpuComputeVertexDataTextureItem
 {
 	FString Name;
-	TSharedPtr<FDataTexture> DataTexture;
+	TSharedPtr<FDataTexture, ESPMode::ThreadSafe> DataTexture;
 };
 
 class OPENLANDMESH_API FGpuComputeVertex
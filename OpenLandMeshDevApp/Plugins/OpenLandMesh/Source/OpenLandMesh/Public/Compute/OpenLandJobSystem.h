@@ -0,0 +1,70 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+
+// Lanes are served in this order. A job in a lower lane starts when there's nothing queued above it,
+// or when the lane has been skipped too many times. So, lower lanes never starve.
+enum class EOpenLandThreadingLane : uint8
+{
+	// Modify (animation) work of meshes the player is looking at
+	VisibleAnimation = 0,
+	// Async LOD builds
+	LODBuild = 1,
+	// Speculative work like building meshes into the cache before they are needed
+	Prewarm = 2,
+
+	Num = 3
+};
+
+struct FOpenLandJobLaneStats
+{
+	int32 QueueDepth = 0;
+	int32 Running = 0;
+	uint64 Completed = 0;
+	// Time spent in the queue before a worker picked up the job
+	float LastWaitTimeMs = 0;
+	float AverageWaitTimeMs = 0;
+	float MaxWaitTimeMs = 0;
+};
+
+/**
+ * A plugin level job queue on top of the task graph.
+ * All the background work of OpenLandMesh goes through here, so we never run more than MaxConcurrentJobs
+ * at once no matter how many meshes are there. That leaves the rest of the background workers for the engine.
+ * Use FOpenLandThreading::RunOnLane to submit jobs.
+ */
+class OPENLANDMESH_API FOpenLandJobSystem
+{
+	struct FJob
+	{
+		TFunction<void()> Function;
+		double QueuedAt = 0;
+	};
+
+	static FCriticalSection Lock;
+	static TQueue<FJob> Queues[static_cast<int32>(EOpenLandThreadingLane::Num)];
+	static FOpenLandJobLaneStats LaneStats[static_cast<int32>(EOpenLandThreadingLane::Num)];
+	// Jobs dispatched from higher lanes while this lane had queued jobs
+	static int32 SkippedDispatches[static_cast<int32>(EOpenLandThreadingLane::Num)];
+	static int32 NumRunning;
+	static int32 MaxConcurrentJobs;
+
+	static void TryDispatch();
+	static void UpdateStats(int32 LaneIndex);
+
+public:
+	static void Submit(EOpenLandThreadingLane Lane, TFunction<void()> InFunction);
+
+	// Zero means, use the number of background workers minus one (but at least one)
+	static void SetMaxConcurrentJobs(int32 NewMaxConcurrentJobs);
+	static int32 GetMaxConcurrentJobs();
+
+	static FOpenLandJobLaneStats GetLaneStats(EOpenLandThreadingLane Lane);
+
+	// True when the calling thread is running one of our jobs.
+	// Such code should not block on other jobs, since they may need the same bounded set of workers.
+	static bool IsInJob();
+};
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include "Compute/OpenLandJobSystem.h"
+
 class OPENLANDMESH_API FOpenLandThreading
 {
 public:
@@ -10,4 +12,10 @@ public:
 	static FGraphEventRef RunOnAnyThread(TFunction<void()> InFunction);
 
 	static FGraphEventRef RunOnAnyBackgroundThread(TFunction<void()> InFunction);
+
+	// Runs the function on a background worker via the plugin's job system.
+	// Use this for all the mesh work, so the number of concurrent jobs stays bounded.
+	static void RunOnLane(EOpenLandThreadingLane Lane, TFunction<void()> InFunction);
+
+	static FOpenLandJobLaneStats GetLaneStats(EOpenLandThreadingLane Lane);
 };
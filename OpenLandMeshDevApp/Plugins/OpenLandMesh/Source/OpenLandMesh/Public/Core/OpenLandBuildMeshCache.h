@@ -0,0 +1,89 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <functional>
+
+#include "Async/Future.h"
+#include "Core/OpenLandPolygonMesh.h"
+
+typedef std::function<void(FOpenLandPolygonMeshBuildResultPtr)> FOpenLandBuildMeshCallback;
+typedef TFunction<void(FOpenLandBuildMeshCallback)> FOpenLandBuildMeshAsyncBuilder;
+
+// An async request attached to a build, along with the builder it brought
+struct FOpenLandBuildMeshWaiter
+{
+	FOpenLandBuildMeshCallback Callback;
+	FOpenLandBuildMeshAsyncBuilder Builder;
+};
+
+// A build of a single cache key which is still running.
+// The builder keeps a reference to this, so it can complete the build even after the cache entry is gone (eg:- after Clear()).
+struct FOpenLandBuildMeshInFlight
+{
+	TPromise<FOpenLandPolygonMeshBuildResultPtr> Promise;
+	// Synchronous requests from other threads wait on this
+	TSharedFuture<FOpenLandPolygonMeshBuildResultPtr> Future;
+	// Async requests attached to this build. Their callbacks are called on the game thread.
+	// For async builds, the first one is running its builder. If that fails, the next one takes over.
+	// This & bCompleted are guarded by the cache lock.
+	TArray<FOpenLandBuildMeshWaiter> Waiters;
+	bool bCompleted = false;
+};
+
+typedef TSharedPtr<FOpenLandBuildMeshInFlight, ESPMode::ThreadSafe> FOpenLandBuildMeshInFlightPtr;
+
+struct FOpenLandBuildMeshResultCacheInfo {
+	FString CacheKey;
+	// This is nullptr while the build is in flight. Once set, it always has the Target.
+	FOpenLandPolygonMeshBuildResultPtr MeshBuildResult;
+	FOpenLandBuildMeshInFlightPtr InFlight;
+	FDateTime CachedAt;
+	FDateTime LastCacheHitAt;
+	// Approximate memory held by this entry. This is counted towards the cache budget.
+	int64 SizeInBytes = 0;
+
+	int64 CalculateSizeInBytes() const;
+	// Entries still being built or shared with live LODs are never evicted
+	bool IsPinned() const;
+};
+
+// Build results shared by all the polygon mesh proxies, keyed by their cache keys.
+// This can be used from any thread. There's at most one build in flight for a key.
+// Other requests for the same key attach to that build & get woken up when it completes.
+class OPENLANDMESH_API FOpenLandBuildMeshCache
+{
+	static FCriticalSection CacheLock;
+	static TMap<FString, FOpenLandBuildMeshResultCacheInfo> CachedBuildMesh;
+	static int64 CacheBudgetBytes;
+	static int64 CachedBytes;
+
+	// Returns the entry for the key. Creates it (with a new in flight build) if needed & sets bCreated.
+	// CacheLock must be held.
+	static FOpenLandBuildMeshResultCacheInfo& FindOrAddEntry(const FString& CacheKey, bool& bCreated);
+	static void StartBuild(const FString& CacheKey, FOpenLandBuildMeshInFlightPtr InFlight, FOpenLandBuildMeshAsyncBuilder Builder);
+	static void CompleteBuild(const FString& CacheKey, FOpenLandBuildMeshInFlightPtr InFlight, FOpenLandPolygonMeshBuildResultPtr Result);
+	// Hands the build over to the next waiting request. If there's none, the entry is dropped.
+	static void FailBuild(const FString& CacheKey, FOpenLandBuildMeshInFlightPtr InFlight);
+	static void UpdateCacheEntrySize(FOpenLandBuildMeshResultCacheInfo* CacheInfo);
+	// Removes least recently used entries until the cache fits into the budget. CacheLock must be held.
+	static void EvictCacheEntries();
+
+public:
+	// Builder runs on the calling thread when there's no entry for the key. It must return a result with the Target.
+	// If a build for the key is in flight, this waits for it. But the game thread & our job lanes build again instead
+	// of waiting, because the in flight build may need the game thread or a free worker to complete.
+	static FOpenLandPolygonMeshBuildResultPtr FindOrBuild(const FString& CacheKey, TFunction<FOpenLandPolygonMeshBuildResultPtr()> Builder);
+
+	// Builder runs on the calling thread when there's no entry for the key. It gets a completion function,
+	// which must be called (from any thread) with a result which has the Target. Call it with nullptr if the builder
+	// can't finish (eg:- its world context is gone). Then the builder of the next attached request takes over.
+	// Callback is called on the game thread.
+	static void FindOrBuildAsync(const FString& CacheKey, FOpenLandBuildMeshAsyncBuilder Builder, FOpenLandBuildMeshCallback Callback);
+
+	static void Clear();
+	static void SetBudget(int64 Bytes);
+	static int64 GetBudget();
+};
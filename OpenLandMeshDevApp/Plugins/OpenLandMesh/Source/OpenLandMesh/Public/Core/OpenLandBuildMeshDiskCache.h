@@ -0,0 +1,34 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/OpenLandPolygonMesh.h"
+
+// Keeps build results in "Saved/OpenLandMesh/BuildCache", so they survive editor restarts, PIE sessions & game launches.
+// Each file holds the Original & Target mesh infos of a single cache key, zlib compressed.
+// Data textures are not stored. They are recreated from the Original vertices after loading.
+// Files are mapped into memory when loading. So, we only pay for the decompression.
+class OPENLANDMESH_API FOpenLandBuildMeshDiskCache
+{
+	static bool bEnabled;
+
+	static FString GetCacheDir();
+	static FString GetCacheFilePath(const FString& CacheKey);
+	static bool Decode(const FString& CacheKey, const uint8* FileData, int64 FileSize, FOpenLandPolygonMeshBuildResultPtr Result);
+	static TArray<uint8> Encode(const FString& CacheKey, FOpenLandPolygonMeshBuildResultPtr Result);
+
+public:
+	// Bump this whenever the file layout or the output of FOpenLandPolygonMesh::BuildMesh changes.
+	// Files with a different version are ignored & overwritten.
+	static const uint32 Version;
+
+	static void SetEnabled(bool bEnable) { bEnabled = bEnable; }
+	static bool IsEnabled() { return bEnabled; }
+
+	// Returns nullptr if there's no valid file for the key. This is safe to call outside of the game thread.
+	static FOpenLandPolygonMeshBuildResultPtr Load(const FString& CacheKey, int32 ForcedTextureWidth);
+	// Encoding & writing happens in the Prewarm lane. Result must have a Target & nobody should modify it afterwards.
+	static void SaveAsync(FOpenLandPolygonMeshBuildResultPtr Result);
+	static void Clear();
+};
@@ -0,0 +1,50 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include <functional>
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+#include "Types/OpenLandCollisionMesh.h"
+#include "OpenLandCollisionCookSource.generated.h"
+
+class UBodySetup;
+
+/**
+ * Owns a cooked UBodySetup which is shared by all the components with the same (non deformable) collision mesh.
+ * The body setup is cooked once using this object as the collision data provider.
+ * So, a forest of identical trees only pays for a single cook.
+ */
+UCLASS()
+class OPENLANDMESH_API UOpenLandCollisionCookSource : public UObject, public IInterface_CollisionDataProvider
+{
+	GENERATED_BODY()
+
+	static TMap<uint64, TWeakObjectPtr<UOpenLandCollisionCookSource>> Registry;
+
+	FOpenLandCollisionMeshPtr CollisionMesh;
+	uint64 CacheKey = 0;
+	bool bCooked = false;
+	TArray<std::function<void(UBodySetup*)>> WaitingCallbacks;
+
+	void FinishPhysicsAsyncCook(bool bSuccess);
+
+public:
+	UPROPERTY()
+	UBodySetup* BodySetup;
+
+	virtual void BeginDestroy() override;
+
+	//~ Begin Interface_CollisionDataProvider Interface
+	virtual bool GetPhysicsTriMeshData(struct FTriMeshCollisionData* CollisionData, bool InUseAllTriData) override;
+	virtual bool ContainsPhysicsTriMeshData(bool InUseAllTriData) const override;
+	virtual bool WantsNegXTriMesh() override { return false; }
+	//~ End Interface_CollisionDataProvider Interface
+
+	// Callback gets the shared body setup once it's cooked (nullptr if cooking failed).
+	// If it's already cooked, the callback is called right away.
+	static void RequestBodySetup(FOpenLandCollisionMeshPtr CollisionMesh, bool bUseComplexAsSimpleCollision, bool bUseAsyncCollisionCooking,
+	                             std::function<void(UBodySetup*)> Callback);
+};
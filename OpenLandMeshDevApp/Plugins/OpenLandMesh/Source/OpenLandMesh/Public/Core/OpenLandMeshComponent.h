@@ -7,6 +7,7 @@
 #include "CoreMinimal.h"
 #include "Components/MeshComponent.h"
 #include "Types/OpenLandMeshInfo.h"
+#include "Types/OpenLandCollisionMesh.h"
 #include "Interfaces/Interface_CollisionDataProvider.h"
 #include "PhysicsEngine/ConvexElem.h"
 
@@ -18,6 +19,21 @@ struct FOpenLandMeshComponentUpdateRange
 	int32 Count = -1;
 };
 
+// Per component state of a section. Mesh infos can be shared across components, so this is kept here.
+struct FOpenLandMeshComponentSectionState
+{
+	bool bSectionVisible = true;
+	bool bEnableCollision = true;
+	// GPU buffers are shared with other components rendering the same mesh info
+	bool bShareRenderData = false;
+};
+
+struct FOpenLandMeshComponentSectionUpdate
+{
+	int32 SectionIndex = 0;
+	FOpenLandMeshComponentUpdateRange UpdateRange = {};
+};
+
 UCLASS(hidecategories = (Object, LOD), meta = (BlueprintSpawnableComponent), ClassGroup = Rendering)
 class OPENLANDMESH_API UOpenLandMeshComponent : public UMeshComponent, public IInterface_CollisionDataProvider
 {
@@ -27,8 +43,34 @@ private:
 	// properties
 	FBoxSphereBounds LocalBounds;
 	void UpdateLocalBounds();
+	void UpdateLocalBoundsIfChanged();
 	UPROPERTY()
 	TArray<UBodySetup*> AsyncBodySetupQueue;
+	// Section updates waiting to be sent to the render thread at the end of the frame.
+	// Multiple updates to the same section within a frame are merged into one.
+	TMap<int32, FOpenLandMeshComponentUpdateRange> PendingSectionUpdates;
+	// Positions passed to the trimesh. Same layout as GetPhysicsTriMeshData.
+	// We keep them around, so we only need to gather positions of changed sections.
+	TArray<FVector> CollisionPositions;
+	TSet<int32> CollisionDirtySections;
+	float TimeSinceCollisionUpdate = 0;
+	bool bCollisionUpdateInProgress = false;
+	// When this is set, it's used for collisions instead of the sections
+	FOpenLandCollisionMeshPtr CollisionMesh;
+	bool bCollisionMeshDirty = false;
+	int32 CollisionMeshBuildId = 0;
+	int32 SharedBodySetupRequestId = 0;
+	// Changes whenever sections are added, replaced or removed. Positions gathered for an older layout are dropped.
+	int32 SectionLayoutId = 0;
+	// Cooked collision shared with other components having the same collision mesh
+	UPROPERTY(Transient)
+	UBodySetup* SharedBodySetup;
+	TArray<FOpenLandCollisionMeshPtr> SectionCollisionMeshes;
+	// Sections whose collision meshes are being welded on a worker
+	TSet<FSimpleMeshInfoPtr> SectionCollisionMeshBuilds;
+	TArray<FOpenLandMeshComponentSectionState> SectionStates;
+	double CollisionCookStartedAt = 0;
+	float LastCollisionCookTimeMs = 0;
 
 	// methods
 	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
@@ -36,8 +78,19 @@ private:
 	void CreateSimpleMeshBodySetup();
 	void FinishPhysicsAsyncCook(bool bSuccess, UBodySetup* FinishedBodySetup);
 	void UpdateCollisionMesh();
+	void FinishCollisionMeshUpdate(TArray<FVector> NewCollisionPositions);
+	void UpdateCollisionMeshPositions();
+	void ReportCollisionCook();
+	// Builds the collision mesh on the calling thread if needed. Only use this where we must have it right away (eg:- cooking).
+	FOpenLandCollisionMeshPtr GetSectionCollisionMesh(int32 SectionIndex);
+	// Returns nullptr & starts building the collision mesh on a worker if it's not there yet.
+	// The section gets marked as collision dirty once it's ready.
+	FOpenLandCollisionMeshPtr FindSectionCollisionMesh(int32 SectionIndex);
+	bool SetupSharedCollisions(bool bUseAsyncCollisionCooking);
+	void ReleasePendingSectionUpdates();
 
 public:
+	UOpenLandMeshComponent(const FObjectInitializer& ObjectInitializer);
 
 	// properties
 	TArray<FSimpleMeshInfoPtr> MeshSections;
@@ -68,6 +121,13 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Procedural Mesh")
 	bool bUseComplexAsSimpleCollision = true;
 
+	/**
+	 *	How many times per second collision positions are updated while the mesh is animating.
+	 *	Set this to zero to update them every frame.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Procedural Mesh")
+	float CollisionUpdateRate = 10.0f;
+
 	/** Collision data */
 	UPROPERTY(Instanced)
 	class UBodySetup* SimpleMeshBodySetup;
@@ -76,6 +136,13 @@ public:
 	UPROPERTY()
 	TArray<FKConvexElem> CollisionConvexElems;
 
+	//~ Begin UActorComponent Interface.
+	virtual void OnUnregister() override;
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void SendRenderDynamicData_Concurrent() override;
+	virtual void DestroyRenderState_Concurrent() override;
+	//~ End UActorComponent Interface.
+
 	//~ Begin UPrimitiveComponent Interface.
 	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
 	virtual class UBodySetup* GetBodySetup() override;
@@ -93,14 +160,29 @@ public:
 	// --- END INTERNAL METHODS & PROPERTIES ---
 
 	// methods
-	void CreateMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo);
-	void ReplaceMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo);
+	// With bShareRenderData, the GPU buffers are shared with other components using the same mesh info.
+	// Such a mesh info must not be modified. Updating a shared section gives it its own buffers again.
+	void CreateMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo, bool bShareRenderData=false);
+	void ReplaceMeshSection(int32 SectionIndex, FSimpleMeshInfoPtr MeshInfo, bool bShareRenderData=false);
 	void UpdateMeshSection(int32 SectionIndex, FOpenLandMeshComponentUpdateRange UpdateRange);
+	// Queues updates for the given sections. All the updates queued within a frame are sent to the
+	// render thread with a single command & collisions are refreshed once.
+	void UpdateMeshSections(TArrayView<const FOpenLandMeshComponentSectionUpdate> Updates);
 	void RemoveAllSections();
 
 	int32 NumMeshSections();
-	void UpdateMeshSectionVisibility(int32 SectionIndex);
+	void SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility);
+	bool IsMeshSectionVisible(int32 SectionIndex) const;
+	void SetMeshSectionCollisionEnabled(int32 SectionIndex, bool bNewEnableCollision);
+	bool IsMeshSectionCollisionEnabled(int32 SectionIndex) const;
+	bool IsMeshSectionRenderDataShared(int32 SectionIndex) const;
 
 	void SetupCollisions(bool bUseAsyncCollisionCooking);
+
+	// Use a separate (usually coarser) mesh for collisions instead of the sections with bEnableCollision.
+	// It's welded on a worker thread & then cooked. Pass nullptr to go back to section based collisions.
+	void SetCollisionMesh(FSimpleMeshInfoPtr CollisionSource, bool bDeformable, bool bUseAsyncCollisionCooking);
+	int32 GetCollisionTriangleCount() const;
+	float GetLastCollisionCookTimeMs() const { return LastCollisionCookTimeMs; }
 	void InvalidateRendering();
 };
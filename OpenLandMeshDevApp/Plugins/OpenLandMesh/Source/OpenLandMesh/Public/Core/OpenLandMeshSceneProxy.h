@@ -11,28 +11,52 @@
 #include "Materials/MaterialRelevance.h"
 #include "PhysicsEngine/BodySetup.h"
 
-class OPENLANDMESH_API FOpenLandMeshProxySection
+class FOpenLandMeshSectionRenderData;
+typedef TSharedPtr<FOpenLandMeshSectionRenderData, ESPMode::ThreadSafe> FOpenLandMeshSectionRenderDataPtr;
+
+// GPU buffers of a mesh section.
+// Components rendering the same immutable mesh info share a single instance of this.
+class OPENLANDMESH_API FOpenLandMeshSectionRenderData
 {
+	void ReleaseResources();
+
 public:
-	/** Material applied to this section */
-	UMaterialInterface* Material;
 	/** Vertex buffer for this section */
 	FStaticMeshVertexBuffers VertexBuffers;
 	/** Index buffer for this section */
 	FDynamicMeshIndexBuffer32 IndexBuffer;
 	/** Vertex factory for this section */
 	FLocalVertexFactory VertexFactory;
+
+	FOpenLandMeshSectionRenderData(ERHIFeatureLevel::Type InFeatureLevel, const FOpenLandMeshInfo* MeshInfo);
+
+	// Resources are released on the render thread, once the last proxy section is gone.
+	static FOpenLandMeshSectionRenderDataPtr Create(ERHIFeatureLevel::Type InFeatureLevel, const FOpenLandMeshInfo* MeshInfo);
+	// Returns the render data already created for this mesh info, if it's still alive.
+	// The mesh info must not be modified after this.
+	static FOpenLandMeshSectionRenderDataPtr FindOrCreateShared(ERHIFeatureLevel::Type InFeatureLevel, FSimpleMeshInfoPtr MeshInfo);
+};
+
+class OPENLANDMESH_API FOpenLandMeshProxySection
+{
+public:
+	/** Material applied to this section */
+	UMaterialInterface* Material;
+	/** Buffers of this section. These may be shared with other proxies. */
+	FOpenLandMeshSectionRenderDataPtr RenderData;
 	/** Whether this section is currently visible */
 	bool bSectionVisible;
+	/** Whether RenderData is shared. Then, it cannot be updated. */
+	bool bSharedRenderData;
 
 #if RHI_RAYTRACING
 	FRayTracingGeometry RayTracingGeometry;
 #endif
 
-	FOpenLandMeshProxySection(ERHIFeatureLevel::Type InFeatureLevel)
+	FOpenLandMeshProxySection()
 		: Material(nullptr)
-		  , VertexFactory(InFeatureLevel, "FOpenLandMeshProxySection")
 		  , bSectionVisible(true)
+		  , bSharedRenderData(false)
 	{
 	}
 };
@@ -5,6 +5,7 @@
 
 
 #include "Compute/GpuComputeVertex.h"
+#include "Compute/OpenLandJobSystem.h"
 #include "Types/OpenLandArray.h"
 #include "Types/OpenLandMeshInfo.h"
 #include "OpenLandPolygonMesh.generated.h"
@@ -45,6 +46,8 @@ struct FOpenLandPolygonMeshBuildOptions
 	// If this is non-zero, the result data texture
 	// will contain a texture width as mentioned below
 	int32 ForcedTextureWidth = 0;
+	// The job system lane used when building asynchronously
+	EOpenLandThreadingLane Lane = EOpenLandThreadingLane::LODBuild;
 };
 
 struct FOpenLandPolygonMeshModifyOptions
@@ -53,6 +56,8 @@ struct FOpenLandPolygonMeshModifyOptions
 	float CuspAngle = 0;
 	float DesiredFrameRate = 110;
 	float LastFrameTime = 0;
+	// The job system lane used for the CPU vertex modifier workers
+	EOpenLandThreadingLane Lane = EOpenLandThreadingLane::VisibleAnimation;
 };
 
 struct FOpenLandPolygonMeshBuildResult
@@ -64,9 +69,9 @@ struct FOpenLandPolygonMeshBuildResult
 	TArray<FGpuComputeVertexDataTextureItem> DataTextures;
 	FString CacheKey;
 
-	TSharedPtr<FOpenLandPolygonMeshBuildResult> ShallowClone()
+	TSharedPtr<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe> ShallowClone()
 	{
-		TSharedPtr<FOpenLandPolygonMeshBuildResult> NewOne = MakeShared<FOpenLandPolygonMeshBuildResult>();
+		TSharedPtr<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe> NewOne = MakeShared<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe>();
 		NewOne->Original = Original;
 		NewOne->Target = Target;
 		NewOne->SubDivisions = SubDivisions;
@@ -83,7 +88,8 @@ struct FOpenLandPolygonMeshBuildResult
 // Unreal may need to create the array data many times
 // In those cases, Unreal might try to delete the texture
 // So, using a pointer will fix that issue
-typedef TSharedPtr<FOpenLandPolygonMeshBuildResult> FOpenLandPolygonMeshBuildResultPtr;
+// Results are shared between threads by the build cache. So, this is thread safe.
+typedef TSharedPtr<FOpenLandPolygonMeshBuildResult, ESPMode::ThreadSafe> FOpenLandPolygonMeshBuildResultPtr;
 
 struct FOpenLandPolygonMeshModifyStatus
 {
@@ -113,12 +119,10 @@ struct FOpenLandPolygonMeshModifyInfo
 	FOpenLandPolygonMeshModifyStatus Status = {};
 };
 
-class OPENLANDMESH_API FOpenLandPolygonMesh
+// Async tasks hold a strong reference to the polygon mesh they are working on.
+// So, the mesh is freed by whoever releases the last reference, without waiting for tasks to complete.
+class OPENLANDMESH_API FOpenLandPolygonMesh : public TSharedFromThis<FOpenLandPolygonMesh, ESPMode::ThreadSafe>
 {
-	// For the delete delete scheduler
-	static bool bIsDeleteSchedulerRunning;
-	static TArray<FOpenLandPolygonMesh*> PolygonMeshesToDelete;
-
 	FOpenLandMeshInfo SourceMeshInfo;
 	function<FVertexModifierResult(FVertexModifierPayload)> VertexModifier = nullptr;
 	TArray<bool> AsyncCompletions;
@@ -130,14 +134,17 @@ class OPENLANDMESH_API FOpenLandPolygonMesh
 	FOpenLandPolygonMeshModifyInfo ModifyInfo = {};
 	int32 GpuLastRowsPerFrame = 0;
 	float GpuLastFrameTime = 0;
+	// Hash of the SourceMeshInfo. It's only recalculated after adding faces.
+	uint64 SourceHash = 0;
+	bool bSourceHashDirty = true;
 
 	static void ApplyNormalSmoothing(FOpenLandMeshInfo* MeshInfo, float CuspAngle);
 	static FOpenLandMeshInfo SubDivide(FOpenLandMeshInfo SourceMeshInfo, int Depth);
 	static void AddFace(FOpenLandMeshInfo* MeshInfo, TOpenLandArray<FOpenLandMeshVertex> Vertices);
 	static void BuildFaceTangents(FOpenLandMeshVertex& T0, FOpenLandMeshVertex& T1, FOpenLandMeshVertex& T2);
-	static void ApplyVertexModifiers(function<FVertexModifierResult(FVertexModifierPayload)> VertexModifier, FOpenLandMeshInfo* Original, FOpenLandMeshInfo* Target, int RangeStart, int RangeEnd,
+	// Returns the bounding box of the modified range. Workers run this in parallel, so it must not touch Target->BoundingBox.
+	static FBox ApplyVertexModifiers(function<FVertexModifierResult(FVertexModifierPayload)> VertexModifier, FOpenLandMeshInfo* Original, FOpenLandMeshInfo* Target, int RangeStart, int RangeEnd,
 	                          float RealTimeSeconds);
-	static void BuildDataTextures(FOpenLandPolygonMeshBuildResultPtr Result, int32 ForcedTextureWidth);
 	void EnsureGpuComputeEngine(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult);
 	void ApplyGpuVertexModifers(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult,
 	                            TArray<FComputeMaterialParameter> AdditionalMaterialParameters);
@@ -172,8 +179,20 @@ public:
 	void Transform(FTransform Transformer);
 	bool IsThereAnyAsyncTask() const;
 	int32 CalculateVerticesForSubdivision(int32 Subdivision) const;
+	// Creates the Target of a result coming from BuildMeshAsync. Vertex modifiers run at time zero, like in BuildMesh.
+	// GPU modifiers run on the game thread. CPU modifiers & normal smoothing run in the Options.Lane.
+	// Callback is called on the game thread.
+	void BuildTargetAsync(UObject* WorldContext, FOpenLandPolygonMeshBuildResultPtr MeshBuildResult, FOpenLandPolygonMeshBuildOptions Options,
+	                      std::function<void()> Callback);
+	static void BuildDataTextures(FOpenLandPolygonMeshBuildResultPtr Result, int32 ForcedTextureWidth);
 
-	// Methods for delete schedular
-	static void RunDeleteScheduler();
-	static void DeletePolygonMesh(FOpenLandPolygonMesh* PolygonMesh);
+	// Hash of everything which affects the output of BuildMesh: the source mesh, the transformer, the options & the GPU modifier.
+	// CPU vertex modifiers are arbitrary code & we cannot hash them. So, this returns false if there's one.
+	bool CalculateContentHash(const FOpenLandPolygonMeshBuildOptions& Options, uint64& OutHash);
+
+	// Max distance from the vertices of the Fine mesh to the triangles of the Coarse mesh they were subdivided from.
+	// Both meshes must come from the same polygon mesh. We use this to pick a collision LOD.
+	static float CalculateSubDivisionError(FOpenLandMeshInfo* Fine, int32 FineSubDivisions, FOpenLandMeshInfo* Coarse, int32 CoarseSubDivisions);
 };
+
+typedef TSharedPtr<FOpenLandPolygonMesh, ESPMode::ThreadSafe> FOpenLandPolygonMeshPtr;
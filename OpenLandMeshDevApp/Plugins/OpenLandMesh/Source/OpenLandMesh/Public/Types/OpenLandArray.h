@@ -31,6 +31,10 @@ public:
 
 	T& GetRef(size_t Index);
 
+	// Raw access for bulk copies (eg:- serialization). Writing through this skips the lock checks.
+	T* GetData();
+	const T* GetData() const;
+
 	void Set(size_t Index, T Value);
 
 	size_t Length() const;
@@ -0,0 +1,35 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+#include "Types/OpenLandMeshInfo.h"
+
+class FOpenLandCollisionMesh;
+typedef TSharedPtr<FOpenLandCollisionMesh, ESPMode::ThreadSafe> FOpenLandCollisionMeshPtr;
+
+// A positions only version of a mesh info used for complex collisions.
+// Render vertices are duplicated per face (for normals & UVs). Here they are welded, so the cooker gets a much smaller mesh.
+class OPENLANDMESH_API FOpenLandCollisionMesh
+{
+public:
+	// The mesh info this is built from
+	FSimpleMeshInfoPtr Source;
+	TArray<FVector> Positions;
+	TArray<FTriIndices> Indices;
+	// For each welded position, a vertex of the Source which has the same position.
+	// This is used to update positions when the Source gets animated.
+	TArray<int32> SourceVertices;
+	// Set this when the source is animated. Then the cooked mesh can be updated without re-cooking.
+	bool bDeformable = false;
+	// Hash of Positions & Indices. Collision meshes with the same hash can share the cooked data.
+	uint64 ContentHash = 0;
+
+	int32 NumTriangles() const { return Indices.Num(); }
+
+	// Copy positions of the Source into Positions using the SourceVertices map
+	void UpdatePositions(TArray<FVector>& OutPositions) const;
+
+	static FOpenLandCollisionMeshPtr Build(FSimpleMeshInfoPtr Source, bool bDeformable);
+};
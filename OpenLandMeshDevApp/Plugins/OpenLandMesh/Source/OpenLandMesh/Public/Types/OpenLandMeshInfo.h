@@ -11,17 +11,23 @@ typedef TSharedPtr<FOpenLandMeshInfo, ESPMode::ThreadSafe> FSimpleMeshInfoPtr;
 
 class OPENLANDMESH_API FOpenLandMeshInfo
 {
-	bool bLocked = false;
+	// Both the render thread & collision updates can hold a lock at the same time. So, we count them.
+	// The count & the vertices lock are changed together under the LockGuard.
+	volatile int32 LockCount = 0;
+	FCriticalSection LockGuard;
 
 public:
 	TOpenLandArray<FOpenLandMeshVertex> Vertices;
 	TOpenLandArray<FOpenLandMeshTriangle> Triangles;
 	FBox BoundingBox;
-	bool bEnableCollision = true;
-	bool bSectionVisible = true;
 
 	FOpenLandMeshInfo();
 
+	// Copies the mesh data & the lock state. Each mesh info has its own LockGuard.
+	FOpenLandMeshInfo(const FOpenLandMeshInfo& Other);
+
+	FOpenLandMeshInfo& operator=(const FOpenLandMeshInfo& Other);
+
 	~FOpenLandMeshInfo();
 
 	void Release();
@@ -30,5 +30,39 @@ public:
 	FOpenLandMeshGridCell CellIdToCell(int32 CellId) const;
 	int32 CellToCellId(FOpenLandMeshGridCell Cell) const;
 	FVector GetCellMidPoint(int32 CellId) const;
+	int32 GetTotalCellCount() const { return TotalCells.X * TotalCells.Y; }
 	TArray<int32> FindCellsAround(int32 CellId, int32 CellRadius) const;
+
+	// Same cells as FindCellsAround, but without allocating. This is used in the inner loop of point sampling.
+	// Return false from the Function to stop early.
+	template<typename FunctionType>
+	void ForEachCellAround(int32 CellId, int32 CellRadius, FunctionType Function) const
+	{
+		const FOpenLandMeshGridCell Center = CellIdToCell(CellId);
+		const int32 MinXChange = FMath::Max(-CellRadius, -Center.X);
+		const int32 MaxXChange = FMath::Min(CellRadius, TotalCells.X - 1 - Center.X);
+		const int32 MinYChange = FMath::Max(-CellRadius, -Center.Y);
+		const int32 MaxYChange = FMath::Min(CellRadius, TotalCells.Y - 1 - Center.Y);
+
+		for (int32 YChange=MinYChange; YChange <= MaxYChange; YChange ++)
+		{
+			for (int32 XChange=MinXChange; XChange <= MaxXChange; XChange ++)
+			{
+				if (XChange == 0 && YChange == 0)
+				{
+					continue;
+				}
+
+				if (FMath::Abs(XChange) == CellRadius && FMath::Abs(YChange) == CellRadius)
+				{
+					continue;
+				}
+
+				if (!Function(CellId + YChange * TotalCells.X + XChange))
+				{
+					return;
+				}
+			}
+		}
+	}
 };
@@ -0,0 +1,9 @@
+﻿// Copyright (c) 2021 Arunoda Susiripala. All Rights Reserved.
+
+#pragma once
+
+#include "Stats/Stats.h"
+
+// All the runtime counters of the plugin goes under this group.
+// Use "stat OpenLandMesh" in the console to see them.
+DECLARE_STATS_GROUP(TEXT("OpenLandMesh"), STATGROUP_OpenLandMesh, STATCAT_Advanced);
@@ -12,7 +12,7 @@ class OPENLANDMESH_API FOpenLandPointTriangle
 
 	FOpenLandPointTriangle(FVector T0, FVector T1, FVector T2);
 	FVector GetCentroid() const;
-	FVector FindRandomPoint(float EdgeDistance = 0.0f) const;
+	FVector FindRandomPoint(const FRandomStream& RandomStream, float EdgeDistance = 0.0f) const;
 	float FindArea() const;
 	static float FindArea(FVector T0, FVector T1, FVector T2);
 	bool IsPointInside(FVector Point) const;
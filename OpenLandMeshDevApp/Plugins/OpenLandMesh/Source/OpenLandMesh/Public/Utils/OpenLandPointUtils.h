@@ -7,6 +7,18 @@ class FOpenLandPointUtils
 {
 	
 public:
-	static void ApplyPointRandomization(FOpenLandInstancingRequestPoint& RequestPoint, FOpenLandInstancingRules Rules);
+	static void ApplyPointRandomization(FOpenLandInstancingRequestPoint& RequestPoint, FOpenLandInstancingRules Rules, const FRandomStream& RandomStream);
 	static void CalculateTangentX(FOpenLandInstancingRequestPoint& RequestPoint, FOpenLandInstancingRules Rules);
+	// Returns INDEX_NONE if the indices don't fit into the id. Those points should be skipped.
+	static int64 MakePointId(int32 RuleIndex, const FOpenLandMeshPoint& MeshPoint);
+	static int32 MakeRuleSeed(int32 ActorSeed, const FOpenLandInstancingRules& Rules, int32 RuleIndex);
+	// Each point has its own random stream. So, its randomization doesn't change when other points come & go.
+	static int32 MakePointSeed(int32 RuleSeed, int64 PointId);
+
+	// Scatter results of unmodified meshes are kept by their mesh cache key, rules & seed.
+	// Then actors sharing them (or re-applying) skip sampling & randomization.
+	static FString MakeScatterKey(const FString& MeshCacheKey, const FOpenLandInstancingRules& Rules, int32 RuleIndex, int32 RuleSeed);
+	static bool FindScatterResult(const FString& ScatterKey, TArray<FOpenLandInstancingRequestPoint>& Points);
+	static void StoreScatterResult(const FString& ScatterKey, const TArray<FOpenLandInstancingRequestPoint>& Points);
+	static void ClearScatterResults();
 };
@@ -8,18 +8,32 @@ struct FOpenLandMeshPoint
 	FVector Position;
 	FVector Normal;
 	FVector TangentX;
+	// Triangle or vertex the point came from & its index among the points of that source.
+	// Together, they identify the point across rebuilds.
+	int32 SourceIndex = 0;
+	int32 SampleIndex = 0;
 };
 
 class OPENLANDMESH_API FOpenLandPointsBuilder
 {
 
 public:
-	static TArray<FOpenLandMeshPoint> BuildPointsModifiedPoisson2D(FSimpleMeshInfoPtr MeshInfo, float Density, float MinRadius);
+	// Triangles are sampled in parallel, each with a random stream made from the Seed & the triangle index.
+	// So, the same seed gives the same points no matter how many threads we use.
+	static TArray<FOpenLandMeshPoint> BuildPointsModifiedPoisson2D(FSimpleMeshInfoPtr MeshInfo, float Density, float MinRadius, int32 Seed = 0);
+	// Samples the whole surface with a single spatial hash. So, the MinRadius is kept across triangle edges too.
+	// Triangles are picked by area & we stop after a fixed number of failed attempts per wanted point.
+	static TArray<FOpenLandMeshPoint> BuildPointsPoissonDisk(FSimpleMeshInfoPtr MeshInfo, float Density, float MinRadius, int32 Seed = 0);
 	static TArray<FOpenLandMeshPoint> BuildPointsUseOrigin(FSimpleMeshInfoPtr MeshInfo);
 	static TArray<FOpenLandMeshPoint> BuildPointsPickVertices(FSimpleMeshInfoPtr MeshInfo);
 	static TArray<FOpenLandMeshPoint> BuildPointsPickCentroids(FSimpleMeshInfoPtr MeshInfo);
 	static TArray<FOpenLandMeshPoint> BuildPointsMoveToZAxis(FSimpleMeshInfoPtr MeshInfo);
 	static TArray<FOpenLandMeshPoint> BuildPointsMoveToXAxis(FSimpleMeshInfoPtr MeshInfo);
 	static TArray<FOpenLandMeshPoint> BuildPointsMoveToYAxis(FSimpleMeshInfoPtr MeshInfo);
-	static TArray<FOpenLandMeshPoint> BuildPointsOnTriangle(FSimpleMeshInfoPtr MeshInfo, int32 TriangleIndex, int32 Count, float MinRadius);
+	static TArray<FOpenLandMeshPoint> BuildPointsOnTriangle(FSimpleMeshInfoPtr MeshInfo, int32 TriangleIndex, int32 Count, float MinRadius, const FRandomStream& RandomStream);
+	// Same as above, but the grid cells are kept in the given array. Pass the same one for many triangles to avoid allocations.
+	// Every item of the array must be INDEX_NONE (an empty array is fine). It's left that way when this returns.
+	static TArray<FOpenLandMeshPoint> BuildPointsOnTriangle(FSimpleMeshInfoPtr MeshInfo, int32 TriangleIndex, int32 Count, float MinRadius, const FRandomStream& RandomStream,
+	                                                        TArray<int32>& PointsInCellBuffer);
+	static int32 MakeTriangleSeed(int32 Seed, int32 TriangleIndex);
 };